@@ -0,0 +1,42 @@
+# Fails the build when an application object references a heap allocator.
+#
+# The periodic paths run for months, all application storage is static or on the stack. Library
+# internals (newlib strtod, mktime) are not checked, only the objects in libapp.a.
+#
+#   cmake -DNM=<nm> -DLIB=<libapp.a> -P check_no_heap.cmake
+
+cmake_minimum_required(VERSION 3.20.0)
+
+set(forbidden
+    malloc calloc realloc free
+    _malloc_r _calloc_r _realloc_r _free_r
+    k_malloc k_calloc k_realloc k_aligned_alloc k_free
+    k_heap_alloc k_heap_aligned_alloc
+)
+
+execute_process(
+  COMMAND ${NM} -u ${LIB}
+  OUTPUT_VARIABLE undefined
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${NM} -u ${LIB} failed (${result})")
+endif()
+
+string(REPLACE "\n" ";" lines "${undefined}")
+set(object "")
+set(offenders "")
+foreach(line IN LISTS lines)
+  if(line MATCHES "^(.+):$")
+    set(object "${CMAKE_MATCH_1}")
+  elseif(line MATCHES "^[ \t]*U[ \t]+([A-Za-z_0-9]+)$")
+    if(CMAKE_MATCH_1 IN_LIST forbidden)
+      list(APPEND offenders "${object}: ${CMAKE_MATCH_1}")
+    endif()
+  endif()
+endforeach()
+
+if(offenders)
+  list(JOIN offenders "\n  " report)
+  message(FATAL_ERROR "Heap allocation in application code:\n  ${report}")
+endif()
@@ -0,0 +1,587 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Register-level emulator for the BME68x, attached to an I2C emulation controller.
+ *
+ * The emulator keeps a 256 byte register image with a fixed set of calibration coefficients and
+ * produces field data from a scripted profile. The profile is given in physical units; the raw
+ * ADC words are found by inverting the Bosch compensation formulas, so the values returned by the
+ * Sensor API match the profile within the ADC resolution. It reports the BME688 variant, whose
+ * gas resistance formula inverts in closed form.
+ *
+ * Conversion timing follows bme68x_get_meas_dur() plus the programmed heater duration, based on
+ * the kernel uptime. Field registers read before a conversion has finished report no new data.
+ */
+
+#include <string.h>
+
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <drivers/bme68x_emul.h>
+
+#include "bme68x_defs.h"
+
+LOG_MODULE_REGISTER(bme68x_emul, CONFIG_BME68X_LOG_LEVEL);
+
+#define DT_DRV_COMPAT bosch_bme68x
+
+#define BME68X_EMUL_N_FIELDS     3
+#define BME68X_EMUL_REG_COUNT    256
+#define BME68X_EMUL_STAT_NEW     BME68X_NEW_DATA_MSK
+#define BME68X_EMUL_STAT_MEASURE UINT8_C(0x20)
+
+/* Field status bits carried in the LSB of the gas ADC words. */
+#define BME68X_EMUL_GAS_VALID UINT8_C(0x20)
+#define BME68X_EMUL_HEAT_STAB UINT8_C(0x10)
+
+/* Calibration coefficients of a typical part, in Sensor API units. */
+struct bme68x_emul_calib {
+	uint16_t t1;
+	int16_t t2;
+	int8_t t3;
+	uint16_t p1;
+	int16_t p2;
+	int8_t p3;
+	int16_t p4;
+	int16_t p5;
+	int8_t p6;
+	int8_t p7;
+	int16_t p8;
+	int16_t p9;
+	uint8_t p10;
+	uint16_t h1;
+	uint16_t h2;
+	int8_t h3;
+	int8_t h4;
+	int8_t h5;
+	uint8_t h6;
+	int8_t h7;
+	int8_t gh1;
+	int16_t gh2;
+	int8_t gh3;
+	int8_t res_heat_val;
+	uint8_t res_heat_range;
+};
+
+static const struct bme68x_emul_calib default_calib = {
+	.t1 = 26046,
+	.t2 = 26270,
+	.t3 = 3,
+	.p1 = 36612,
+	.p2 = -10493,
+	.p3 = 88,
+	.p4 = 7236,
+	.p5 = -55,
+	.p6 = 30,
+	.p7 = 43,
+	.p8 = -1745,
+	.p9 = -4213,
+	.p10 = 30,
+	.h1 = 789,
+	.h2 = 1016,
+	.h3 = 0,
+	.h4 = 45,
+	.h5 = 20,
+	.h6 = 120,
+	.h7 = -100,
+	.gh1 = -30,
+	.gh2 = -5969,
+	.gh3 = 18,
+	.res_heat_val = 44,
+	.res_heat_range = 1,
+};
+
+/* Used while no profile is loaded: 25 C, 1013.25 hPa, 45 %RH, 50 kOhm. */
+static const struct bme68x_emul_sample default_sample = {
+	.temperature_mc = 25000,
+	.pressure_pa = 101325,
+	.humidity_mpct = 45000,
+	.gas_ohm = 50000,
+};
+
+struct bme68x_emul_cfg {
+	uint16_t addr;
+};
+
+struct bme68x_emul_data {
+	uint8_t reg[BME68X_EMUL_REG_COUNT];
+
+	const struct bme68x_emul_sample *profile;
+	size_t profile_len;
+	size_t profile_pos;
+	bool profile_loop;
+
+	/* Conversion bookkeeping, times in microseconds of uptime. */
+	uint64_t conv_start_us;
+	uint32_t conv_step_us;
+	uint8_t conv_done;
+	uint8_t meas_index;
+
+	struct bme68x_emul_stats stats;
+};
+
+static uint64_t uptime_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/* Map an index of the Sensor API coefficient array to its register address. */
+static uint8_t coeff_reg(int idx)
+{
+	if (idx < BME68X_LEN_COEFF1) {
+		return BME68X_REG_COEFF1 + idx;
+	}
+	idx -= BME68X_LEN_COEFF1;
+	if (idx < BME68X_LEN_COEFF2) {
+		return BME68X_REG_COEFF2 + idx;
+	}
+	return BME68X_REG_COEFF3 + (idx - BME68X_LEN_COEFF2);
+}
+
+static void put_coeff(uint8_t *reg, int idx, uint8_t val)
+{
+	reg[coeff_reg(idx)] = val;
+}
+
+static void put_coeff16(uint8_t *reg, int idx_lsb, int idx_msb, uint16_t val)
+{
+	put_coeff(reg, idx_lsb, (uint8_t)(val & 0xff));
+	put_coeff(reg, idx_msb, (uint8_t)(val >> 8));
+}
+
+/* Build the power-on register image. */
+static void reg_reset(struct bme68x_emul_data *data)
+{
+	const struct bme68x_emul_calib *c = &default_calib;
+	uint8_t *reg = data->reg;
+
+	memset(reg, 0, sizeof(data->reg));
+
+	reg[BME68X_REG_CHIP_ID] = BME68X_CHIP_ID;
+	reg[BME68X_REG_VARIANT_ID] = BME68X_VARIANT_GAS_HIGH;
+
+	put_coeff16(reg, BME68X_IDX_T1_LSB, BME68X_IDX_T1_MSB, c->t1);
+	put_coeff16(reg, BME68X_IDX_T2_LSB, BME68X_IDX_T2_MSB, (uint16_t)c->t2);
+	put_coeff(reg, BME68X_IDX_T3, (uint8_t)c->t3);
+
+	put_coeff16(reg, BME68X_IDX_P1_LSB, BME68X_IDX_P1_MSB, c->p1);
+	put_coeff16(reg, BME68X_IDX_P2_LSB, BME68X_IDX_P2_MSB, (uint16_t)c->p2);
+	put_coeff(reg, BME68X_IDX_P3, (uint8_t)c->p3);
+	put_coeff16(reg, BME68X_IDX_P4_LSB, BME68X_IDX_P4_MSB, (uint16_t)c->p4);
+	put_coeff16(reg, BME68X_IDX_P5_LSB, BME68X_IDX_P5_MSB, (uint16_t)c->p5);
+	put_coeff(reg, BME68X_IDX_P6, (uint8_t)c->p6);
+	put_coeff(reg, BME68X_IDX_P7, (uint8_t)c->p7);
+	put_coeff16(reg, BME68X_IDX_P8_LSB, BME68X_IDX_P8_MSB, (uint16_t)c->p8);
+	put_coeff16(reg, BME68X_IDX_P9_LSB, BME68X_IDX_P9_MSB, (uint16_t)c->p9);
+	put_coeff(reg, BME68X_IDX_P10, c->p10);
+
+	/* H1 and H2 share the nibbles of one register. */
+	put_coeff(reg, BME68X_IDX_H2_MSB, (uint8_t)(c->h2 >> 4));
+	put_coeff(reg, BME68X_IDX_H1_LSB,
+		  (uint8_t)(((c->h2 & 0x0f) << 4) | (c->h1 & BME68X_BIT_H1_DATA_MSK)));
+	put_coeff(reg, BME68X_IDX_H1_MSB, (uint8_t)(c->h1 >> 4));
+	put_coeff(reg, BME68X_IDX_H3, (uint8_t)c->h3);
+	put_coeff(reg, BME68X_IDX_H4, (uint8_t)c->h4);
+	put_coeff(reg, BME68X_IDX_H5, (uint8_t)c->h5);
+	put_coeff(reg, BME68X_IDX_H6, c->h6);
+	put_coeff(reg, BME68X_IDX_H7, (uint8_t)c->h7);
+
+	put_coeff(reg, BME68X_IDX_GH1, (uint8_t)c->gh1);
+	put_coeff16(reg, BME68X_IDX_GH2_LSB, BME68X_IDX_GH2_MSB, (uint16_t)c->gh2);
+	put_coeff(reg, BME68X_IDX_GH3, (uint8_t)c->gh3);
+
+	put_coeff(reg, BME68X_IDX_RES_HEAT_VAL, (uint8_t)c->res_heat_val);
+	put_coeff(reg, BME68X_IDX_RES_HEAT_RANGE, (uint8_t)(c->res_heat_range << 4));
+	put_coeff(reg, BME68X_IDX_RANGE_SW_ERR, 0);
+
+	data->conv_step_us = 0;
+	data->conv_done = 0;
+}
+
+/* Forward compensation, identical to the floating point path of the Sensor API. */
+static double comp_t_fine(uint32_t adc)
+{
+	const struct bme68x_emul_calib *c = &default_calib;
+	double var1 = ((adc / 16384.0) - (c->t1 / 1024.0)) * c->t2;
+	double d = (adc / 131072.0) - (c->t1 / 8192.0);
+
+	return var1 + d * d * (c->t3 * 16.0);
+}
+
+static double comp_pressure(uint32_t adc, double t_fine)
+{
+	const struct bme68x_emul_calib *c = &default_calib;
+	double var1 = (t_fine / 2.0) - 64000.0;
+	double var2 = var1 * var1 * (c->p6 / 131072.0);
+	double var3;
+	double pres;
+
+	var2 = var2 + (var1 * c->p5 * 2.0);
+	var2 = (var2 / 4.0) + (c->p4 * 65536.0);
+	var1 = (((c->p3 * var1 * var1) / 16384.0) + (c->p2 * var1)) / 524288.0;
+	var1 = (1.0 + (var1 / 32768.0)) * c->p1;
+	pres = 1048576.0 - adc;
+	pres = ((pres - (var2 / 4096.0)) * 6250.0) / var1;
+	var1 = (c->p9 * pres * pres) / 2147483648.0;
+	var2 = pres * (c->p8 / 32768.0);
+	var3 = (pres / 256.0) * (pres / 256.0) * (pres / 256.0) * (c->p10 / 131072.0);
+
+	return pres + (var1 + var2 + var3 + (c->p7 * 128.0)) / 16.0;
+}
+
+static double comp_humidity(uint32_t adc, double t_fine)
+{
+	const struct bme68x_emul_calib *c = &default_calib;
+	double temp_comp = t_fine / 5120.0;
+	double var1 = adc - ((c->h1 * 16.0) + ((c->h3 / 2.0) * temp_comp));
+	double var2 = var1 * ((c->h2 / 262144.0) * (1.0 + ((c->h4 / 16384.0) * temp_comp) +
+						    ((c->h5 / 1048576.0) * temp_comp * temp_comp)));
+	double var3 = c->h6 / 16384.0;
+	double var4 = c->h7 / 2097152.0;
+
+	return var2 + ((var3 + (var4 * temp_comp)) * var2 * var2);
+}
+
+/* Bisection over a monotonic compensation function. */
+static uint32_t invert_adc(double target, uint32_t max, bool increasing, double t_fine,
+			   double (*fn)(uint32_t adc, double t_fine))
+{
+	uint32_t lo = 0;
+	uint32_t hi = max;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		double val = fn(mid, t_fine);
+
+		if ((val < target) == increasing) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+static double comp_t_fine_adapter(uint32_t adc, double unused)
+{
+	ARG_UNUSED(unused);
+	return comp_t_fine(adc) / 5120.0;
+}
+
+/* Gas resistance of the high variant: R = 1e6 * (262144 >> range) / (4096 + 3 * (adc - 512)). */
+static void invert_gas(uint32_t ohm, uint16_t *adc, uint8_t *range)
+{
+	for (uint8_t r = 0; r < 16; r++) {
+		double num = 1000000.0 * (double)(UINT32_C(262144) >> r);
+		double code = 512.0 + ((num / (double)ohm) - 4096.0) / 3.0;
+
+		if (code >= 0.0 && code <= 1023.0) {
+			*adc = (uint16_t)(code + 0.5);
+			*range = r;
+			return;
+		}
+	}
+	*adc = 1023;
+	*range = 15;
+}
+
+static const struct bme68x_emul_sample *next_sample(struct bme68x_emul_data *data)
+{
+	const struct bme68x_emul_sample *sample;
+
+	if (data->profile == NULL || data->profile_len == 0) {
+		return &default_sample;
+	}
+
+	sample = &data->profile[data->profile_pos];
+	if (data->profile_pos + 1 < data->profile_len) {
+		data->profile_pos++;
+	} else if (data->profile_loop) {
+		data->profile_pos = 0;
+	}
+	return sample;
+}
+
+/* Write one conversion result into field @p field. */
+static void fill_field(struct bme68x_emul_data *data, uint8_t field, uint8_t gas_index)
+{
+	const struct bme68x_emul_sample *s = next_sample(data);
+	uint8_t *f = &data->reg[BME68X_REG_FIELD0 + field * BME68X_LEN_FIELD_OFFSET];
+	bool run_gas = (data->reg[BME68X_REG_CTRL_GAS_1] & BME68X_RUN_GAS_MSK) != 0;
+	uint32_t t_adc = invert_adc(s->temperature_mc / 1000.0, BIT(20) - 1, true, 0.0,
+				    comp_t_fine_adapter);
+	double t_fine = comp_t_fine(t_adc);
+	uint32_t p_adc = invert_adc((double)s->pressure_pa, BIT(20) - 1, false, t_fine,
+				    comp_pressure);
+	uint32_t h_adc = invert_adc(s->humidity_mpct / 1000.0, UINT16_MAX, true, t_fine,
+				    comp_humidity);
+	uint16_t g_adc = 0;
+	uint8_t g_range = 0;
+	uint8_t g_flags = 0;
+
+	if (run_gas && s->gas_ohm != 0) {
+		invert_gas(s->gas_ohm, &g_adc, &g_range);
+		g_flags = BME68X_EMUL_GAS_VALID | BME68X_EMUL_HEAT_STAB;
+	}
+
+	f[0] = BME68X_EMUL_STAT_NEW | (gas_index & BME68X_GAS_INDEX_MSK);
+	f[1] = data->meas_index++;
+	f[2] = (uint8_t)(p_adc >> 12);
+	f[3] = (uint8_t)(p_adc >> 4);
+	f[4] = (uint8_t)((p_adc & 0x0f) << 4);
+	f[5] = (uint8_t)(t_adc >> 12);
+	f[6] = (uint8_t)(t_adc >> 4);
+	f[7] = (uint8_t)((t_adc & 0x0f) << 4);
+	f[8] = (uint8_t)(h_adc >> 8);
+	f[9] = (uint8_t)h_adc;
+	/* Both gas ADC words are populated, the Sensor API picks one by variant id. */
+	f[13] = f[15] = (uint8_t)(g_adc >> 2);
+	f[14] = f[16] = (uint8_t)(((g_adc & 0x03) << 6) | g_flags | g_range);
+
+	data->stats.conversions++;
+	data->stats.last_conversion_us = data->conv_step_us;
+}
+
+/* Decode the gas_wait / shared heater duration encoding into microseconds. */
+static uint32_t decode_wait_us(uint8_t val, uint32_t unit_us)
+{
+	static const uint8_t factor[] = {1, 4, 16, 64};
+
+	return (uint32_t)(val & 0x3f) * factor[val >> 6] * unit_us;
+}
+
+/* Duration of one conversion step for the current register settings. */
+static uint32_t step_duration_us(const struct bme68x_emul_data *data, uint8_t mode)
+{
+	static const uint8_t os_cycles[] = {0, 1, 2, 4, 8, 16, 16, 16};
+	uint8_t ctrl_meas = data->reg[BME68X_REG_CTRL_MEAS];
+	uint8_t ctrl_gas_1 = data->reg[BME68X_REG_CTRL_GAS_1];
+	bool run_gas = (ctrl_gas_1 & BME68X_RUN_GAS_MSK) != 0;
+	uint8_t nb_conv = ctrl_gas_1 & BME68X_GAS_INDEX_MSK;
+	uint32_t cycles = os_cycles[(ctrl_meas >> 5) & 0x07] + os_cycles[(ctrl_meas >> 2) & 0x07] +
+			  os_cycles[data->reg[BME68X_REG_CTRL_HUM] & 0x07];
+	uint32_t dur = cycles * 1963U + 477U * 4U + 477U * 5U;
+
+	if (mode == BME68X_PARALLEL_MODE) {
+		/* gas_wait_x is a multiplier of the TPH cycle plus the shared heater time */
+		uint32_t shared = decode_wait_us(data->reg[BME68X_REG_SHD_HEATR_DUR], 477U);
+		uint8_t mult = data->reg[BME68X_REG_GAS_WAIT0];
+
+		return MAX(mult, 1U) * (dur + shared);
+	}
+
+	dur += 1000U;
+	if (run_gas) {
+		dur += decode_wait_us(data->reg[BME68X_REG_GAS_WAIT0 + MIN(nb_conv, 9)], 1000U);
+	}
+	return dur;
+}
+
+/* Bring the field registers up to date with the elapsed uptime. */
+static void update_conversions(struct bme68x_emul_data *data)
+{
+	uint8_t mode = data->reg[BME68X_REG_CTRL_MEAS] & BME68X_MODE_MSK;
+	uint64_t now = uptime_us();
+
+	if (mode == BME68X_SLEEP_MODE || data->conv_step_us == 0) {
+		return;
+	}
+
+	if (mode == BME68X_FORCED_MODE) {
+		if (now - data->conv_start_us >= data->conv_step_us) {
+			fill_field(data, 0, data->reg[BME68X_REG_CTRL_GAS_1] & 0x0f);
+			/* Forced mode falls back to sleep after one conversion */
+			data->reg[BME68X_REG_CTRL_MEAS] &= ~BME68X_MODE_MSK;
+			data->conv_step_us = 0;
+		}
+		return;
+	}
+
+	/* Parallel mode cycles through the heater profile and the three fields */
+	uint8_t nb_conv = MAX(data->reg[BME68X_REG_CTRL_GAS_1] & 0x0f, 1);
+	uint64_t due = (now - data->conv_start_us) / data->conv_step_us;
+
+	while (data->conv_done < due) {
+		fill_field(data, data->conv_done % BME68X_EMUL_N_FIELDS,
+			   data->conv_done % nb_conv);
+		data->conv_done++;
+		if (data->conv_done == UINT8_MAX) {
+			/* rebase to keep the counter small on long runs */
+			data->conv_start_us += (uint64_t)data->conv_done * data->conv_step_us;
+			due -= data->conv_done;
+			data->conv_done = 0;
+		}
+	}
+}
+
+static void reg_write(struct bme68x_emul_data *data, uint8_t reg, uint8_t val)
+{
+	if (reg == BME68X_REG_SOFT_RESET) {
+		if (val == BME68X_SOFT_RESET_CMD) {
+			reg_reset(data);
+		}
+		return;
+	}
+
+	if (reg == BME68X_REG_CHIP_ID || reg == BME68X_REG_VARIANT_ID) {
+		/* read only */
+		return;
+	}
+
+	data->reg[reg] = val;
+
+	if (reg == BME68X_REG_CTRL_MEAS) {
+		uint8_t mode = val & BME68X_MODE_MSK;
+
+		if (mode == BME68X_SLEEP_MODE) {
+			data->conv_step_us = 0;
+			return;
+		}
+
+		/* A new measurement clears the new-data flags of all fields */
+		for (int i = 0; i < BME68X_EMUL_N_FIELDS; i++) {
+			data->reg[BME68X_REG_FIELD0 + i * BME68X_LEN_FIELD_OFFSET] &=
+				~BME68X_EMUL_STAT_NEW;
+		}
+		data->conv_start_us = uptime_us();
+		data->conv_step_us = step_duration_us(data, mode);
+		data->conv_done = 0;
+	}
+}
+
+static uint8_t reg_read(struct bme68x_emul_data *data, uint8_t reg)
+{
+	uint8_t field_end = BME68X_REG_FIELD0 + BME68X_EMUL_N_FIELDS * BME68X_LEN_FIELD_OFFSET;
+	uint8_t val;
+
+	if (reg < BME68X_REG_FIELD0 || reg >= field_end) {
+		return data->reg[reg];
+	}
+
+	uint8_t offset = (reg - BME68X_REG_FIELD0) % BME68X_LEN_FIELD_OFFSET;
+	uint8_t *status = &data->reg[reg - offset];
+
+	val = data->reg[reg];
+	if (offset == 0) {
+		if (!(val & BME68X_EMUL_STAT_NEW)) {
+			data->stats.stale_reads++;
+			if (data->conv_step_us != 0) {
+				val |= BME68X_EMUL_STAT_MEASURE;
+			}
+		}
+	} else if (offset == BME68X_LEN_FIELD - 1) {
+		/* Reading the last byte of a field acknowledges it */
+		*status &= ~BME68X_EMUL_STAT_NEW;
+	}
+	return val;
+}
+
+static int bme68x_emul_transfer_i2c(const struct emul *target, struct i2c_msg *msgs, int num_msgs,
+				    int addr)
+{
+	struct bme68x_emul_data *data = target->data;
+	const struct bme68x_emul_cfg *cfg = target->cfg;
+
+	if (addr != cfg->addr) {
+		LOG_ERR("Address mismatch, expected 0x%02x, got 0x%02x", cfg->addr, addr);
+		return -EIO;
+	}
+
+	if (num_msgs < 1 || (msgs[0].flags & I2C_MSG_READ) || msgs[0].len < 1) {
+		LOG_ERR("Unexpected transfer, %d msgs", num_msgs);
+		return -EIO;
+	}
+
+	data->stats.transfers++;
+	update_conversions(data);
+
+	if (num_msgs == 1) {
+		/* Sensor API burst write: interleaved address/data pairs */
+		if ((msgs[0].len % 2) != 0) {
+			LOG_ERR("Odd write length %u", msgs[0].len);
+			return -EIO;
+		}
+		for (uint32_t i = 0; i < msgs[0].len; i += 2) {
+			reg_write(data, msgs[0].buf[i], msgs[0].buf[i + 1]);
+			data->stats.bytes_written++;
+		}
+		return 0;
+	}
+
+	if (num_msgs != 2 || !(msgs[1].flags & I2C_MSG_READ) || msgs[0].len != 1) {
+		LOG_ERR("Unexpected read transfer, %d msgs", num_msgs);
+		return -EIO;
+	}
+
+	uint8_t reg = msgs[0].buf[0];
+
+	for (uint32_t i = 0; i < msgs[1].len; i++) {
+		msgs[1].buf[i] = reg_read(data, (uint8_t)(reg + i));
+	}
+	data->stats.bytes_read += msgs[1].len;
+	return 0;
+}
+
+int bme68x_emul_set_profile(const struct emul *target, const struct bme68x_emul_sample *samples,
+			    size_t count, bool loop)
+{
+	struct bme68x_emul_data *data = target->data;
+
+	if (samples == NULL || count == 0) {
+		return -EINVAL;
+	}
+
+	data->profile = samples;
+	data->profile_len = count;
+	data->profile_pos = 0;
+	data->profile_loop = loop;
+	return 0;
+}
+
+void bme68x_emul_get_stats(const struct emul *target, struct bme68x_emul_stats *stats)
+{
+	const struct bme68x_emul_data *data = target->data;
+
+	*stats = data->stats;
+}
+
+void bme68x_emul_reset_stats(const struct emul *target)
+{
+	struct bme68x_emul_data *data = target->data;
+
+	memset(&data->stats, 0, sizeof(data->stats));
+}
+
+static int bme68x_emul_init(const struct emul *target, const struct device *parent)
+{
+	struct bme68x_emul_data *data = target->data;
+
+	ARG_UNUSED(parent);
+
+	reg_reset(data);
+	data->profile = NULL;
+	data->profile_len = 0;
+	data->profile_pos = 0;
+	data->meas_index = 0;
+	memset(&data->stats, 0, sizeof(data->stats));
+	return 0;
+}
+
+static struct i2c_emul_api bme68x_emul_api_i2c = {
+	.transfer = bme68x_emul_transfer_i2c,
+};
+
+#define BME68X_EMUL(n)                                                                             \
+	static struct bme68x_emul_data bme68x_emul_data_##n;                                       \
+	static const struct bme68x_emul_cfg bme68x_emul_cfg_##n = {                                \
+		.addr = DT_INST_REG_ADDR(n),                                                       \
+	};                                                                                         \
+	EMUL_DT_INST_DEFINE(n, bme68x_emul_init, &bme68x_emul_data_##n, &bme68x_emul_cfg_##n,     \
+			    &bme68x_emul_api_i2c, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(BME68X_EMUL)
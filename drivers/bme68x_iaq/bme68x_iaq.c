@@ -14,6 +14,8 @@
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/logging/log.h>
 
+#include <periph_usage.h>
+
 #include "bme68x_iaq.h"
 #include "bsec_datatypes.h"
 
@@ -66,6 +68,12 @@ static const bsec_sensor_configuration_t bsec_requested_virtual_sensors[BSEC_N_O
 #endif // CONFIG_BME68X_IAQ_EN
 };
 
+/* Work handed to the BSEC thread by the attribute calls, BSEC is not thread safe */
+enum bsec_request {
+	BSEC_REQUEST_SUBSCRIPTION,
+	BSEC_REQUEST_SAVE_STATE,
+};
+
 /* Definitions used to store and retrieve BSEC state from the settings API */
 #define SETTINGS_NAME_BSEC  "bsec"
 #define SETTINGS_KEY_STATE  "state"
@@ -80,6 +88,9 @@ static K_TIMER_DEFINE(bsec_save_state_timer, NULL, NULL);
 /* I2C spec for BME68x sensor */
 static struct i2c_dt_spec bme68x_i2c_spec;
 
+/* The TWIM is only resumed for each register access */
+PERIPH_USAGE_DEFINE(bus_usage, "bme68x i2c");
+
 /* Semaphore to make sure output data isn't read while being updated */
 static K_SEM_DEFINE(output_sem, 1, 1);
 
@@ -130,13 +141,27 @@ static int8_t bus_write(uint8_t reg_addr, const uint8_t *reg_data_ptr, uint32_t
 	buf[0] = reg_addr;
 	memcpy(&buf[1], reg_data_ptr, len);
 
-	return i2c_write_dt(&bme68x_i2c_spec, buf, ARRAY_SIZE(buf));
+	int ret = periph_usage_get(&bus_usage, bme68x_i2c_spec.bus);
+
+	if (ret < 0) {
+		return ret;
+	}
+	ret = i2c_write_dt(&bme68x_i2c_spec, buf, ARRAY_SIZE(buf));
+	periph_usage_put(&bus_usage, bme68x_i2c_spec.bus);
+	return ret;
 }
 
 /* I2C bus read forwarder for bme68x driver */
 static int8_t bus_read(uint8_t reg_addr, uint8_t *reg_data_ptr, uint32_t len, void *intf_ptr)
 {
-	return i2c_write_read_dt(&bme68x_i2c_spec, &reg_addr, 1, reg_data_ptr, len);
+	int ret = periph_usage_get(&bus_usage, bme68x_i2c_spec.bus);
+
+	if (ret < 0) {
+		return ret;
+	}
+	ret = i2c_write_read_dt(&bme68x_i2c_spec, &reg_addr, 1, reg_data_ptr, len);
+	periph_usage_put(&bus_usage, bme68x_i2c_spec.bus);
+	return ret;
 }
 
 /* delay function for bme68x driver */
@@ -351,7 +376,11 @@ static void fetch_and_process_output(const struct device *dev, bsec_bme_settings
 		if (n_inputs == 0) {
 			continue;
 		}
+		uint32_t start = k_cycle_get_32();
+
 		ret = bsec_do_steps(inputs, n_inputs, outputs, &n_outputs);
+		data->step_cycles = k_cycle_get_32() - start;
+		data->step_cycles_max = MAX(data->step_cycles_max, data->step_cycles);
 		if (ret != BSEC_OK) {
 			LOG_ERR("bsec_do_steps err: %d", ret);
 			continue;
@@ -360,18 +389,51 @@ static void fetch_and_process_output(const struct device *dev, bsec_bme_settings
 	}
 }
 
+/* Subscribe the outputs at the configured rates, or all of them at the ULP rate */
+static void update_subscription(const struct device *dev)
+{
+	struct bme68x_iaq_data *data = dev->data;
+	bsec_sensor_configuration_t requested[ARRAY_SIZE(bsec_requested_virtual_sensors)];
+
+	memcpy(requested, bsec_requested_virtual_sensors, sizeof(requested));
+	if (data->ulp) {
+		for (size_t i = 0; i < ARRAY_SIZE(requested); i++) {
+			requested[i].sample_rate = BSEC_SAMPLE_RATE_ULP;
+		}
+	}
+
+	data->n_required_sensor_settings = BSEC_MAX_PHYSICAL_SENSOR;
+	int ret = bsec_update_subscription(requested, ARRAY_SIZE(requested),
+					   data->required_sensor_settings,
+					   &data->n_required_sensor_settings);
+	if (ret != BSEC_OK) {
+		LOG_ERR("bsec_update_subscription err: %d", ret);
+	}
+}
+
 /* Manage all recurrings tasks for the sensor:
  * - update device settings according to BSEC
  * - fetch measurement values
  * - update BSEC state
  * - periodically save BSEC state to flash
+ * - subscription changes and state saves requested through the attributes
  */
 static void bsec_thread_fn(const struct device *dev)
 {
 	int ret;
 	bsec_bme_settings_t sensor_settings = {0};
+	struct bme68x_iaq_data *data = dev->data;
 
 	while (true) {
+		if (atomic_test_and_clear_bit(&data->requests, BSEC_REQUEST_SUBSCRIPTION)) {
+			update_subscription(dev);
+			/* Ask BSEC for the new schedule right away */
+			sensor_settings.next_call = 0;
+		}
+		if (atomic_test_and_clear_bit(&data->requests, BSEC_REQUEST_SAVE_STATE)) {
+			state_save(dev);
+		}
+
 		uint64_t timestamp_ns = k_ticks_to_ns_floor64(k_uptime_ticks());
 
 		if (timestamp_ns < sensor_settings.next_call) {
@@ -460,9 +522,7 @@ static int bme68x_bsec_init(const struct device *dev)
 		LOG_DBG("Setting BSEC state successful.");
 	}
 
-	bsec_update_subscription(bsec_requested_virtual_sensors,
-				 ARRAY_SIZE(bsec_requested_virtual_sensors),
-				 data->required_sensor_settings, &data->n_required_sensor_settings);
+	update_subscription(dev);
 
 	k_thread_create(&data->thread, thread_stack, CONFIG_BME68X_IAQ_THREAD_STACK_SIZE,
 			(k_thread_entry_t)bsec_thread_fn, (void *)dev, NULL, NULL,
@@ -495,6 +555,46 @@ static int bme68x_trigger_set(const struct device *dev, const struct sensor_trig
 	return 0;
 }
 
+static int bme68x_attr_set(const struct device *dev, enum sensor_channel chan,
+			   enum sensor_attribute attr, const struct sensor_value *val)
+{
+	struct bme68x_iaq_data *data = dev->data;
+
+	if (attr == SENSOR_ATTR_SAMPLING_FREQUENCY) {
+		bool ulp = sensor_value_to_double(val) < BSEC_SAMPLE_RATE_LP;
+
+		if (ulp == data->ulp) {
+			return 0;
+		}
+		data->ulp = ulp;
+		atomic_set_bit(&data->requests, BSEC_REQUEST_SUBSCRIPTION);
+	} else if ((int)attr == SENSOR_ATTR_BSEC_SAVE_STATE) {
+		atomic_set_bit(&data->requests, BSEC_REQUEST_SAVE_STATE);
+	} else {
+		return -ENOTSUP;
+	}
+
+	/* The thread may sleep until the next ULP sample, 300 s */
+	k_wakeup(&data->thread);
+	return 0;
+}
+
+static int bme68x_attr_get(const struct device *dev, enum sensor_channel chan,
+			   enum sensor_attribute attr, struct sensor_value *val)
+{
+	struct bme68x_iaq_data *data = dev->data;
+
+	if ((int)attr == SENSOR_ATTR_BSEC_STEP_US) {
+		val->val1 = k_cyc_to_us_floor32(data->step_cycles);
+	} else if ((int)attr == SENSOR_ATTR_BSEC_STEP_MAX_US) {
+		val->val1 = k_cyc_to_us_floor32(data->step_cycles_max);
+	} else {
+		return -ENOTSUP;
+	}
+	val->val2 = 0;
+	return 0;
+}
+
 static int bme68x_sample_fetch(const struct device *dev, enum sensor_channel chan)
 {
 	/* fetching is a requirement for the API */
@@ -536,6 +636,8 @@ static int bme68x_channel_get(const struct device *dev, enum sensor_channel chan
 static const struct sensor_driver_api bme68x_driver_api = {
 	.sample_fetch = &bme68x_sample_fetch,
 	.channel_get = &bme68x_channel_get,
+	.attr_set = bme68x_attr_set,
+	.attr_get = bme68x_attr_get,
 	.trigger_set = bme68x_trigger_set,
 };
 
@@ -56,6 +56,16 @@ struct bme68x_iaq_data {
 
 	bool initialized;
 
+	/* Requests to the BSEC thread, bits of enum bsec_request in bme68x_iaq.c */
+	atomic_t requests;
+
+	/* Ultra low power subscription requested */
+	bool ulp;
+
+	/* Duration of the last and the longest bsec_do_steps(), hardware cycles */
+	uint32_t step_cycles;
+	uint32_t step_cycles_max;
+
 	struct bme68x_dev dev;
 };
 
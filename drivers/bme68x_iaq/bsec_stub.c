@@ -0,0 +1,330 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Stand-in for the BSEC library on targets the blob is not shipped for.
+ *
+ * It implements the calls of bme68x_iaq.c with the BSEC contract but none of its algorithms:
+ * bsec_sensor_control() schedules forced mode samples at the subscribed rates, the gas heater only
+ * for the samples an air quality output is due for, and bsec_do_steps() passes the compensated
+ * sensor values through. The air quality outputs follow the gas resistance on a fixed scale, so a
+ * test can check the gas path end to end:
+ *
+ *   IAQ = (505 kOhm - R) / 1 kOhm, clamped to 0 ... 500, accuracy 0
+ *   eCO2 = 500 ppm + IAQ * 10 ppm
+ *   bVOC = 0.5 ppm + IAQ / 100 ppm
+ *
+ * The state blob only carries a magic and the number of processed samples.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include "bme68x.h"
+#include "bsec_interface.h"
+
+/* Heater of the gas samples, short enough for the field polling of bme68x_get_data() */
+#define STUB_HEATER_TEMP_C 320
+#define STUB_HEATER_MS     20
+
+#define STUB_STATE_MAGIC 0x42535453 /* "STSB" */
+#define STUB_STATE_LEN   8
+
+#define NS_PER_S 1000000000LL
+
+/* One subscribed output */
+struct stub_output {
+	uint8_t sensor_id;
+	/* Period in ns, 0 while not subscribed */
+	int64_t period_ns;
+	int64_t next_ns;
+};
+
+static struct stub_output stub_outputs[BSEC_NUMBER_OUTPUTS];
+static uint8_t stub_n_outputs;
+static uint32_t stub_samples;
+
+static bool output_needs_gas(uint8_t sensor_id)
+{
+	return sensor_id == BSEC_OUTPUT_IAQ || sensor_id == BSEC_OUTPUT_STATIC_IAQ ||
+	       sensor_id == BSEC_OUTPUT_CO2_EQUIVALENT ||
+	       sensor_id == BSEC_OUTPUT_BREATH_VOC_EQUIVALENT || sensor_id == BSEC_OUTPUT_RAW_GAS;
+}
+
+/* Physical input an output is computed from */
+static uint8_t output_input(uint8_t sensor_id)
+{
+	switch (sensor_id) {
+	case BSEC_OUTPUT_RAW_TEMPERATURE:
+	case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE:
+		return BSEC_INPUT_TEMPERATURE;
+	case BSEC_OUTPUT_RAW_PRESSURE:
+		return BSEC_INPUT_PRESSURE;
+	case BSEC_OUTPUT_RAW_HUMIDITY:
+	case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY:
+		return BSEC_INPUT_HUMIDITY;
+	default:
+		return output_needs_gas(sensor_id) ? BSEC_INPUT_GASRESISTOR : 0;
+	}
+}
+
+static struct stub_output *find_output(uint8_t sensor_id)
+{
+	for (uint8_t i = 0; i < stub_n_outputs; i++) {
+		if (stub_outputs[i].sensor_id == sensor_id) {
+			return &stub_outputs[i];
+		}
+	}
+	return NULL;
+}
+
+bsec_library_return_t bsec_init(void)
+{
+	memset(stub_outputs, 0, sizeof(stub_outputs));
+	stub_n_outputs = 0;
+	stub_samples = 0;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_version(bsec_version_t *bsec_version_p)
+{
+	memset(bsec_version_p, 0, sizeof(*bsec_version_p));
+	return BSEC_OK;
+}
+
+bsec_library_return_t
+bsec_update_subscription(const bsec_sensor_configuration_t *const requested_virtual_sensors,
+			 const uint8_t n_requested_virtual_sensors,
+			 bsec_sensor_configuration_t *required_sensor_settings,
+			 uint8_t *n_required_sensor_settings)
+{
+	static const uint8_t inputs[] = {BSEC_INPUT_PRESSURE, BSEC_INPUT_HUMIDITY,
+					 BSEC_INPUT_TEMPERATURE, BSEC_INPUT_GASRESISTOR,
+					 BSEC_INPUT_HEATSOURCE};
+	float fastest = BSEC_SAMPLE_RATE_DISABLED;
+
+	if (*n_required_sensor_settings < ARRAY_SIZE(inputs)) {
+		return BSEC_E_SU_GATECOUNTEXCEEDSARRAY;
+	}
+
+	for (uint8_t i = 0; i < n_requested_virtual_sensors; i++) {
+		const bsec_sensor_configuration_t *req = &requested_virtual_sensors[i];
+		struct stub_output *out = find_output(req->sensor_id);
+
+		if (output_input(req->sensor_id) == 0) {
+			return BSEC_W_SU_UNKNOWNOUTPUTGATE;
+		}
+		if (req->sample_rate <= 0.0f) {
+			return BSEC_E_SU_WRONGDATARATE;
+		}
+		if (out == NULL) {
+			if (stub_n_outputs == ARRAY_SIZE(stub_outputs)) {
+				return BSEC_E_SU_GATECOUNTEXCEEDSARRAY;
+			}
+			out = &stub_outputs[stub_n_outputs++];
+			out->sensor_id = req->sensor_id;
+		}
+
+		if (req->sample_rate == BSEC_SAMPLE_RATE_DISABLED) {
+			out->period_ns = 0;
+			continue;
+		}
+		/* A new rate starts with a sample at the next bsec_sensor_control() */
+		out->period_ns = (int64_t)(NS_PER_S / req->sample_rate);
+		out->next_ns = 0;
+		fastest = MIN(fastest, req->sample_rate);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(inputs); i++) {
+		required_sensor_settings[i].sensor_id = inputs[i];
+		required_sensor_settings[i].sample_rate = fastest;
+	}
+	*n_required_sensor_settings = ARRAY_SIZE(inputs);
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_sensor_control(const int64_t time_stamp,
+					  bsec_bme_settings_t *sensor_settings)
+{
+	bool due = false;
+	bool gas = false;
+	int64_t next = INT64_MAX;
+
+	for (uint8_t i = 0; i < stub_n_outputs; i++) {
+		struct stub_output *out = &stub_outputs[i];
+
+		if (out->period_ns == 0) {
+			continue;
+		}
+		if (time_stamp >= out->next_ns) {
+			due = true;
+			gas = gas || output_needs_gas(out->sensor_id);
+			/* Stay on the grid of the first sample, skip the missed ones */
+			if (out->next_ns == 0) {
+				out->next_ns = time_stamp;
+			}
+			while (out->next_ns <= time_stamp) {
+				out->next_ns += out->period_ns;
+			}
+		}
+		next = MIN(next, out->next_ns);
+	}
+
+	memset(sensor_settings, 0, sizeof(*sensor_settings));
+	/* Nothing subscribed, check back in a second */
+	sensor_settings->next_call = (next == INT64_MAX) ? time_stamp + NS_PER_S : next;
+	if (!due) {
+		sensor_settings->op_mode = BME68X_SLEEP_MODE;
+		return BSEC_OK;
+	}
+
+	sensor_settings->op_mode = BME68X_FORCED_MODE;
+	sensor_settings->trigger_measurement = 1;
+	sensor_settings->temperature_oversampling = BME68X_OS_1X;
+	sensor_settings->pressure_oversampling = BME68X_OS_1X;
+	sensor_settings->humidity_oversampling = BME68X_OS_1X;
+	sensor_settings->process_data =
+		BSEC_PROCESS_TEMPERATURE | BSEC_PROCESS_PRESSURE | BSEC_PROCESS_HUMIDITY;
+	if (gas) {
+		sensor_settings->run_gas = 1;
+		sensor_settings->heater_temperature = STUB_HEATER_TEMP_C;
+		sensor_settings->heater_duration = STUB_HEATER_MS;
+		sensor_settings->process_data |= BSEC_PROCESS_GAS;
+	}
+	return BSEC_OK;
+}
+
+/* Air quality index of a gas resistance, see the file comment */
+static float stub_iaq(float gas_ohm)
+{
+	return CLAMP((505000.0f - gas_ohm) / 1000.0f, 0.0f, 500.0f);
+}
+
+static float output_signal(uint8_t sensor_id, float input, float heatsource)
+{
+	switch (sensor_id) {
+	case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE:
+		return input - heatsource;
+	case BSEC_OUTPUT_IAQ:
+	case BSEC_OUTPUT_STATIC_IAQ:
+		return stub_iaq(input);
+	case BSEC_OUTPUT_CO2_EQUIVALENT:
+		return 500.0f + stub_iaq(input) * 10.0f;
+	case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
+		return 0.5f + stub_iaq(input) / 100.0f;
+	default:
+		return input;
+	}
+}
+
+bsec_library_return_t bsec_do_steps(const bsec_input_t *const inputs, const uint8_t n_inputs,
+				    bsec_output_t *outputs, uint8_t *n_outputs)
+{
+	float heatsource = 0.0f;
+	uint8_t n = 0;
+
+	for (uint8_t i = 0; i < n_inputs; i++) {
+		if (inputs[i].sensor_id == BSEC_INPUT_HEATSOURCE) {
+			heatsource = inputs[i].signal;
+		}
+	}
+
+	for (uint8_t i = 0; i < stub_n_outputs; i++) {
+		const struct stub_output *out = &stub_outputs[i];
+		uint8_t input_id = output_input(out->sensor_id);
+
+		if (out->period_ns == 0) {
+			continue;
+		}
+		for (uint8_t j = 0; j < n_inputs; j++) {
+			if (inputs[j].sensor_id != input_id) {
+				continue;
+			}
+			if (n == *n_outputs) {
+				return BSEC_W_DOSTEPS_EXCESSOUTPUTS;
+			}
+			outputs[n] = (bsec_output_t){
+				.time_stamp = inputs[j].time_stamp,
+				.signal = output_signal(out->sensor_id, inputs[j].signal,
+							heatsource),
+				.signal_dimensions = 1,
+				.sensor_id = out->sensor_id,
+			};
+			n++;
+			break;
+		}
+	}
+
+	*n_outputs = n;
+	stub_samples++;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_reset_output(uint8_t sensor_id)
+{
+	ARG_UNUSED(sensor_id);
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_configuration(const uint8_t *const serialized_settings,
+					     const uint32_t n_serialized_settings,
+					     uint8_t *work_buffer,
+					     const uint32_t n_work_buffer_size)
+{
+	ARG_UNUSED(serialized_settings);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer_size);
+	return n_serialized_settings == 0 ? BSEC_E_CONFIG_EMPTY : BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_state(const uint8_t *const serialized_state,
+				     const uint32_t n_serialized_state, uint8_t *work_buffer,
+				     const uint32_t n_work_buffer_size)
+{
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer_size);
+
+	if (n_serialized_state < STUB_STATE_LEN) {
+		return BSEC_E_CONFIG_EMPTY;
+	}
+	if (sys_get_le32(serialized_state) != STUB_STATE_MAGIC) {
+		return BSEC_E_CONFIG_VERSIONMISMATCH;
+	}
+	stub_samples = sys_get_le32(serialized_state + 4);
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_configuration(const uint8_t config_id,
+					     uint8_t *serialized_settings,
+					     const uint32_t n_serialized_settings_max,
+					     uint8_t *work_buffer, const uint32_t n_work_buffer,
+					     uint32_t *n_serialized_settings)
+{
+	ARG_UNUSED(config_id);
+	ARG_UNUSED(serialized_settings);
+	ARG_UNUSED(n_serialized_settings_max);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer);
+	*n_serialized_settings = 0;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_state(const uint8_t state_set_id, uint8_t *serialized_state,
+				     const uint32_t n_serialized_state_max, uint8_t *work_buffer,
+				     const uint32_t n_work_buffer, uint32_t *n_serialized_state)
+{
+	ARG_UNUSED(state_set_id);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer);
+
+	if (n_serialized_state_max < STUB_STATE_LEN) {
+		return BSEC_E_CONFIG_INSUFFICIENTBUFFER;
+	}
+	sys_put_le32(STUB_STATE_MAGIC, serialized_state);
+	sys_put_le32(stub_samples, serialized_state + 4);
+	*n_serialized_state = STUB_STATE_LEN;
+	return BSEC_OK;
+}
@@ -1,5 +1,5 @@
 #!/bin/sh
 
 nrfjprog --version
-nrfjprog -f nrf52 --chiperase --reset --verify --program ./build/zephyr/zephyr.hex
-# nrfjprog --program /Users/bradkim06/hhs/docker/work/gas_ces/build/zephyr/zephyr.hex --chiperase --verify -f NRF52
+nrfjprog -f nrf52 --chiperase --reset --verify --program ./build/zephyr/merged.hex
+# nrfjprog --program /Users/bradkim06/hhs/docker/work/gas_ces/build/zephyr/merged.hex --chiperase --verify -f NRF52
@@ -0,0 +1,92 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _BME68X_EMUL_H_
+#define _BME68X_EMUL_H_
+
+/**
+ * @file bme68x_emul.h
+ *
+ * @brief Backend API for the bme68x register-level emulator.
+ *
+ * The emulator sits on an I2C emulation controller and answers the same register accesses the
+ * Bosch BME68x Sensor API performs, so the BSEC integration in drivers/bme68x_iaq can run
+ * without the physical sensor.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/drivers/emul.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/** One step of a scripted environment profile, in physical units. */
+struct bme68x_emul_sample {
+	/** Ambient temperature in milli degrees Celsius. */
+	int32_t temperature_mc;
+	/** Barometric pressure in Pa. */
+	uint32_t pressure_pa;
+	/** Relative humidity in milli percent. */
+	uint32_t humidity_mpct;
+	/** Gas resistance in Ohm, 0 reports an invalid gas measurement. */
+	uint32_t gas_ohm;
+};
+
+/** Bus and conversion counters, used for timing and throughput assertions. */
+struct bme68x_emul_stats {
+	/** Number of I2C transfers handled. */
+	uint32_t transfers;
+	/** Register bytes written by the host, address bytes excluded. */
+	uint32_t bytes_written;
+	/** Register bytes read by the host. */
+	uint32_t bytes_read;
+	/** Completed TPH(+gas) conversions. */
+	uint32_t conversions;
+	/** Field reads that returned no new data because the conversion was still running. */
+	uint32_t stale_reads;
+	/** Duration of the last conversion in microseconds. */
+	uint32_t last_conversion_us;
+};
+
+/**
+ * @brief Load a scripted profile into the emulator.
+ *
+ * Every completed conversion consumes the next sample. When the end of the profile is reached the
+ * emulator either restarts at the first sample (@p loop) or keeps reporting the last one.
+ * The samples are referenced, not copied, and must stay valid while the profile is in use.
+ *
+ * @param target Emulator instance.
+ * @param samples Array of profile samples.
+ * @param count Number of entries in @p samples, must be non-zero.
+ * @param loop Restart at the first sample after the last one.
+ *
+ * @return 0 on success, -EINVAL on an empty profile.
+ */
+int bme68x_emul_set_profile(const struct emul *target, const struct bme68x_emul_sample *samples,
+			    size_t count, bool loop);
+
+/**
+ * @brief Copy the emulator counters.
+ *
+ * @param target Emulator instance.
+ * @param stats Destination for the counters.
+ */
+void bme68x_emul_get_stats(const struct emul *target, struct bme68x_emul_stats *stats);
+
+/**
+ * @brief Reset the emulator counters to zero.
+ *
+ * @param target Emulator instance.
+ */
+void bme68x_emul_reset_stats(const struct emul *target);
+
+#ifdef __cplusplus
+}
+#endif // __cplusplus
+
+#endif /* _BME68X_EMUL_H_ */
@@ -19,6 +19,21 @@ extern "C" {
 
 #define SENSOR_CHAN_IAQ (SENSOR_CHAN_PRIV_START + 1)
 
+/**
+ * @brief Save the BSEC state to flash now, the value is ignored.
+ *
+ * SENSOR_ATTR_SAMPLING_FREQUENCY switches between the configured sample rate and the BSEC ultra
+ * low power mode (0.0033 Hz, one sample every 300 s): rates below the 1/3 Hz of the low power
+ * mode select it. Both take effect in the BSEC thread.
+ */
+#define SENSOR_ATTR_BSEC_SAVE_STATE (SENSOR_ATTR_PRIV_START + 1)
+
+/** @brief Duration of the last bsec_do_steps() in µs, read only. */
+#define SENSOR_ATTR_BSEC_STEP_US (SENSOR_ATTR_PRIV_START + 2)
+
+/** @brief Longest bsec_do_steps() since boot in µs, read only. */
+#define SENSOR_ATTR_BSEC_STEP_MAX_US (SENSOR_ATTR_PRIV_START + 3)
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
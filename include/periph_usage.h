@@ -0,0 +1,100 @@
+/**
+ * @file include/periph_usage.h - active time of runtime managed peripherals
+ *
+ * @brief Reference counted pm_device_runtime_get() and pm_device_runtime_put() that also count
+ * how long a peripheral was held.
+ *
+ * Each user defines a record with PERIPH_USAGE_DEFINE() and wraps every transaction in
+ * periph_usage_get() and periph_usage_put(). The records sit in an iterable section, so the
+ * BME68x driver counts its bus the same way without a link to the application, and
+ * src/periph_usage.c reports all of them per hour (CONFIG_APP_PERIPH_USAGE). A peripheral outside
+ * the device model, like the RTC of the LED patterns, passes no device and is only counted.
+ *
+ * Time comes from k_cycle_get_32(), the 32768 Hz RTC1 on the nRF52. A transaction shorter than a
+ * cycle counts as 0 or 30.5 us depending on where it falls, which averages out over many.
+ */
+#ifndef __APP_PERIPH_USAGE_H__
+#define __APP_PERIPH_USAGE_H__
+
+#include <stdint.h>
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/iterable_sections.h>
+
+/** Active time of one user of a peripheral. */
+struct periph_usage {
+	/** Name in the report. */
+	const char *name;
+	struct k_spinlock lock;
+	/** Nested periph_usage_get() calls. */
+	uint32_t refs;
+	/** Cycle of the first periph_usage_get(). */
+	uint32_t since;
+	/** Held time since the last report, cycles. */
+	uint64_t active_cycles;
+	/** Transactions since the last report. */
+	uint32_t count;
+};
+
+/**
+ * @brief Define a usage record.
+ *
+ * @param _var Variable name.
+ * @param _name Name in the report.
+ */
+#define PERIPH_USAGE_DEFINE(_var, _name)                                                           \
+	STRUCT_SECTION_ITERABLE(periph_usage, _var) = {.name = _name}
+
+/**
+ * @brief Resume a peripheral for a transaction.
+ *
+ * @param usage Record of the caller.
+ * @param dev Device, or NULL when only the time is counted.
+ * @return 0 on success, or the error of pm_device_runtime_get(), then nothing is counted.
+ */
+static inline int periph_usage_get(struct periph_usage *usage, const struct device *dev)
+{
+	if (dev != NULL) {
+		int err = pm_device_runtime_get(dev);
+
+		if (err < 0) {
+			return err;
+		}
+	}
+
+	k_spinlock_key_t key = k_spin_lock(&usage->lock);
+
+	if (usage->refs++ == 0) {
+		usage->since = k_cycle_get_32();
+		usage->count++;
+	}
+	k_spin_unlock(&usage->lock, key);
+	return 0;
+}
+
+/**
+ * @brief End a transaction started with periph_usage_get().
+ *
+ * The peripheral is suspended once no user holds it anymore.
+ *
+ * @param usage Record of the caller.
+ * @param dev Device passed to periph_usage_get().
+ */
+static inline void periph_usage_put(struct periph_usage *usage, const struct device *dev)
+{
+	k_spinlock_key_t key = k_spin_lock(&usage->lock);
+
+	if (usage->refs > 0 && --usage->refs == 0) {
+		usage->active_cycles += k_cycle_get_32() - usage->since;
+	}
+	k_spin_unlock(&usage->lock, key);
+
+	if (dev != NULL) {
+		(void)pm_device_runtime_put(dev);
+	}
+}
+
+#endif // __APP_PERIPH_USAGE_H__
@@ -0,0 +1,44 @@
+/**
+ * @file src/app_work.c - shared low priority work queue
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+
+#include "app_work.h"
+#include "supervisor.h"
+#include "tick_align.h"
+
+struct k_work_q app_work_q;
+
+static K_THREAD_STACK_DEFINE(app_work_stack, CONFIG_APP_WORK_QUEUE_STACK_SIZE);
+
+/* Heartbeat of the queue, on the wakeup grid with the Bluetooth publish */
+static struct tick_align_job heartbeat_tick = TICK_ALIGN_JOB_INIT(10000, 1000, TICK_ALIGN_GRID_MS);
+
+static void heartbeat_fn(struct k_work *work)
+{
+	supervisor_checkin(SUPERVISOR_APP_WORK);
+	k_work_reschedule_for_queue(
+		&app_work_q, k_work_delayable_from_work(work),
+		K_TIMEOUT_ABS_MS(tick_align_next(&heartbeat_tick, k_uptime_get())));
+}
+
+static K_WORK_DELAYABLE_DEFINE(heartbeat_work, heartbeat_fn);
+
+static int app_work_init(void)
+{
+	const struct k_work_queue_config cfg = {
+		.name = "app_workq",
+		.no_yield = false,
+	};
+
+	k_work_queue_start(&app_work_q, app_work_stack, K_THREAD_STACK_SIZEOF(app_work_stack),
+			   CONFIG_APP_WORK_QUEUE_PRIORITY, &cfg);
+	k_work_schedule_for_queue(&app_work_q, &heartbeat_work, K_NO_WAIT);
+	return 0;
+}
+
+/* Before the APPLICATION level init functions that schedule their first item */
+SYS_INIT(app_work_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
@@ -0,0 +1,19 @@
+#ifndef __APP_WORK_H__
+#define __APP_WORK_H__
+
+#include <zephyr/kernel.h>
+
+/**
+ * @file src/app_work.h
+ *
+ * @brief Low priority work queue shared by the periodic housekeeping of the application.
+ *
+ * Battery measurement, the supervisor heartbeat and one-shot start up work run as k_work_delayable
+ * items on this queue instead of owning a thread each. Items run one after another, so they must
+ * not block for long: a wait belongs in the delay of the next schedule, not in a k_sleep().
+ */
+
+/** The shared queue, started at POST_KERNEL. */
+extern struct k_work_q app_work_q;
+
+#endif // __APP_WORK_H__
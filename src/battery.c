@@ -2,13 +2,14 @@
  * @file src/battery.c - Battery monitoring and management application code
  *
  * @brief This program provides functionality for battery monitoring and management.
- * It reads the battery voltage using an ADC and calculates battery levels and status.
- * It maintains a moving average for battery voltage and checks for low battery warnings.
+ * It reads the battery voltage using an ADC, powering the divider only around each sample unless
+ * the raw capture holds it, and
+ * feeds it with the loads running at that moment to the fuel gauge for the state of charge and
+ * the time to empty. It also checks for low battery warnings.
  *
  * @author bradkim06@gmail.com
  */
 #include <stdio.h>
-#include <stdlib.h>
 
 #include <zephyr/drivers/adc.h>
 #include <zephyr/drivers/gpio.h>
@@ -16,9 +17,22 @@
 #include <zephyr/init.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/logging/log_ctrl.h>
+#include <zephyr/sys/atomic.h>
 
+#include <periph_usage.h>
+
+#include "app_work.h"
 #include "battery.h"
+#include "bluetooth.h"
+#include "bme680_app.h"
+#include "fuel_gauge.h"
+#include "gas.h"
 #include "hhs_math.h"
+#include "led.h"
+#include "power_policy.h"
+#include "supervisor.h"
+#include "tick_align.h"
 #include "hhs_util.h"
 
 LOG_MODULE_REGISTER(BATTERY, CONFIG_APP_LOG_LEVEL);
@@ -31,30 +45,75 @@ K_SEM_DEFINE(batt_data_sem, 1, 1);
 
 static struct battery_value batt_percent;
 
+static uint32_t batt_time_to_empty_min = UINT32_MAX;
+
+static uint32_t batt_avg_ua;
+
 static bool battery_ok;
 
-/** A discharge curve specific to the power source. */
+/** Open circuit voltage curve of the cell.
+ *
+ * The fuel gauge adds the IR drop of the running loads back to each sample, so this is the rest
+ * voltage of a small LIPO cell and not a curve under load. The previous curve was eyeballed under
+ * full load (4.0 V full, 3.3 V at 6 %) and read low once the drop is removed.
+ */
 static const struct level_point levels[] = {
-	/* "Curve" here eyeballed from captured data for the [Adafruit
-	 * 3.7v 2000 mAh](https://www.adafruit.com/product/2011) LIPO
-	 * under full load that started with a charge of 3.96 V and
-	 * dropped about linearly to 3.58 V over 15 hours.  It then
-	 * dropped rapidly to 3.10 V over one hour, at which point it
-	 * stopped transmitting.
-	 *
-	 * Based on eyeball comparisons we'll say that 15/16 of life
-	 * goes between 3.95 and 3.55 V, and 1/16 goes between 3.55 V
-	 * and 3.1 V.
-	 */
-
-	// dtp-102535 800mAh Batt
-	// {10000, 4000},
 	// tw-403030 300mAh Batt
-	{10000, 4000},
-	{625, 3300},
-	{0, 3100},
+	{10000, 4180},
+	{9000, 4060},
+	{8000, 3980},
+	{7000, 3920},
+	{6000, 3870},
+	{5000, 3820},
+	{4000, 3790},
+	{3000, 3770},
+	{2000, 3740},
+	{1000, 3690},
+	{500, 3610},
+	{0, 3300},
+};
+
+/* Advertising current of the model at the default 250 ~ 500 ms interval */
+#define ADV_UA             25
+#define ADV_UA_INTERVAL_MS 375
+
+/** Cell and energy model of the board, see struct fuel_gauge_params. Follows the power tier. */
+static struct fuel_gauge_params fuel_params = {
+	.capacity_mah = CONFIG_APP_FUEL_GAUGE_CAPACITY_MAH,
+	.resistance_mohm = CONFIG_APP_FUEL_GAUGE_RESISTANCE_MOHM,
+	.base_ua = CONFIG_APP_FUEL_GAUGE_BASE_UA,
+	/* Connectable advertising every 250 ~ 500 ms at 0 dBm */
+	.adv_ua = ADV_UA,
+	/* Peripheral preferred connection interval and a notification every 10 s */
+	.conn_ua = 50,
+	/* BME680 datasheet: 0.09 mA with the gas (IAQ) sample every 300 s, which both BSEC modes
+	 * of the driver use; 9 ~ 13 mA while heating
+	 */
+	.heater_ua = IS_ENABLED(CONFIG_BME68X) ? 90 : 0,
+	.heater_peak_ua = 12000,
+	/* SAADC scanning (0.7 mA) and 7.5 ~ 15 ms connection events with full packets */
+	.capture_ua = 2500,
+	.ocv_gain = 1.0f / 64.0f,
+	.ocv_gain_loaded = 1.0f / 256.0f,
+	.reseed_pptt = 2000,
 };
 
+/* Heartbeat window of a task, in its periods */
+#define SUPERVISOR_WINDOW_PERIODS 5
+
+/* BSEC heartbeat window in ultra low power mode, three samples */
+#define BSEC_ULP_WINDOW_MS 900000
+
+static struct power_policy power_policy;
+
+/* The cell recovers from a heater pulse within a few seconds */
+#define HEATER_RECOVERY_MS 3000
+
+/* k_uptime_get_32() | 1 of the last BME680 sample, the heater ran just before it; 0 for none */
+static atomic_t heater_uptime_ms;
+
+static struct fuel_gauge fuel_gauge;
+
 struct io_channel_config {
 	uint8_t channel;
 };
@@ -101,6 +160,14 @@ static struct divider_data divider_data = {
 	.adc = DEVICE_DT_GET(DT_IO_CHANNELS_CTLR(VBATT)),
 };
 
+PERIPH_USAGE_DEFINE(battery_adc_usage, "battery adc");
+
+/* Holders of the divider power, the measurement and battery_divider_hold() */
+static K_MUTEX_DEFINE(divider_lock);
+static int divider_holds;
+/* Holds of battery_divider_hold() only, for the load tag */
+static atomic_t divider_ext_holds;
+
 /**
  * @brief Setup the divider functionality.
  *
@@ -138,7 +205,7 @@ static int divider_setup(void)
 	}
 
 	*asp = (struct adc_sequence){
-		.channels = BIT(0),
+		.channels = BIT(BATTERY_ADC_CHANNEL_ID),
 		.buffer = &ddp->raw,
 		.buffer_size = sizeof(ddp->raw),
 		.oversampling = 8,
@@ -146,8 +213,8 @@ static int divider_setup(void)
 	};
 
 #ifdef CONFIG_ADC_NRFX_SAADC
-#define BATTERY_ADC_GAIN ADC_GAIN_1
 	*accp = (struct adc_channel_cfg){
+		.channel_id = BATTERY_ADC_CHANNEL_ID,
 		.gain = BATTERY_ADC_GAIN,
 		.reference = ADC_REF_INTERNAL,
 		.acquisition_time = ADC_ACQ_TIME(ADC_ACQ_TIME_MICROSECONDS, 40),
@@ -170,6 +237,75 @@ static int divider_setup(void)
 	return rc;
 }
 
+#if defined(CONFIG_BME68X)
+/* BME680 listener, called from the sensor trigger */
+static void heater_ran(const struct bme680_env *env)
+{
+	ARG_UNUSED(env);
+	atomic_set(&heater_uptime_ms, k_uptime_get_32() | 1);
+}
+#endif // CONFIG_BME68X
+
+/* Loads running while the battery is sampled, bitmask of enum fuel_gauge_load */
+static uint32_t battery_loads(void)
+{
+	uint32_t loads = 0;
+	uint32_t heater = atomic_get(&heater_uptime_ms);
+
+	if (bt_connected()) {
+		loads |= FUEL_GAUGE_LOAD_RADIO;
+	}
+	if (heater != 0 && k_uptime_get_32() - heater < HEATER_RECOVERY_MS) {
+		loads |= FUEL_GAUGE_LOAD_HEATER;
+	}
+	if (atomic_get(&divider_ext_holds) > 0) {
+		loads |= FUEL_GAUGE_LOAD_CAPTURE;
+	}
+	return loads;
+}
+
+/**
+ * @brief Apply the settings of a power tier.
+ *
+ * Every setting of the row is applied, so a tier is the same whichever tier it was entered from.
+ * The energy model of the fuel gauge follows the advertising interval. The duty mode keeps its own
+ * gas heartbeat window, BSEC ultra low power mode and idle blink.
+ */
+static void apply_power_tier(enum power_tier tier)
+{
+	const struct power_tier_row *row = &power_tiers[tier];
+	bool duty = IS_ENABLED(CONFIG_APP_DUTY_MODE);
+
+	gas_set_period(row->gas_period_ms);
+	if (!duty) {
+		supervisor_set_window(SUPERVISOR_GAS,
+				      SUPERVISOR_WINDOW_PERIODS * row->gas_period_ms);
+	}
+
+	bt_set_adv_interval(row->adv_min_ms, row->adv_max_ms);
+	fuel_params.adv_ua = ADV_UA * ADV_UA_INTERVAL_MS * 2 / (row->adv_min_ms + row->adv_max_ms);
+
+#if defined(CONFIG_BME68X)
+	bme680_set_ulp(row->bsec_ulp || duty);
+	supervisor_set_window(SUPERVISOR_BSEC,
+			      (row->bsec_ulp || duty) ? BSEC_ULP_WINDOW_MS : 0);
+#endif // CONFIG_BME68X
+
+	led_signal_set(LED_SIGNAL_IDLE, row->led == POWER_LED_ALL && !duty);
+	led_set_enabled(row->led != POWER_LED_OFF);
+
+	if (row->flush) {
+#if defined(CONFIG_BME68X)
+		bme680_save_state();
+#endif // CONFIG_BME68X
+		/* Pending messages out now, then synchronous until the brown-out */
+		LOG_PANIC();
+	}
+}
+
+static void battery_measurement_work_fn(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(battery_measurement_work, battery_measurement_work_fn);
+
 /**
  * @brief Setup the battery management.
  *
@@ -183,13 +319,22 @@ static int battery_setup(void)
 	int rc = divider_setup();
 
 	battery_ok = (rc == 0);
+	power_policy_init(&power_policy);
+#if defined(CONFIG_BME68X)
+	bme680_add_env_listener(heater_ran);
+#endif // CONFIG_BME68X
 	LOG_DBG("Battery setup: %d(%s) %d(%s)", rc, (rc ? "err" : "none err"), battery_ok,
 		(battery_ok ? "ok" : "fail"));
 
+	/* First measurement right away, the queue runs it once the kernel starts threads */
+	k_work_schedule_for_queue(&app_work_q, &battery_measurement_work, K_NO_WAIT);
+
 	return rc;
 }
 
 /** Enable or disable measurement of the battery voltage.
+ *
+ * Takes or releases one hold of the divider power, it is switched only by the first and the last.
  *
  * @param enable true to enable, false to disable
  *
@@ -197,20 +342,33 @@ static int battery_setup(void)
  */
 static int battery_measure_enable(bool enable)
 {
-	int rc = -ENOENT;
+	const struct gpio_dt_spec *gcp = &divider_config.power_gpios;
+	int rc = 0;
 
-	if (battery_ok) {
-		const struct gpio_dt_spec *gcp = &divider_config.power_gpios;
+	if (!battery_ok) {
+		return -ENOENT;
+	}
 
-		rc = 0;
+	k_mutex_lock(&divider_lock, K_FOREVER);
+	if (enable ? divider_holds++ == 0 : (divider_holds > 0 && --divider_holds == 0)) {
 		if (gcp->port) {
+			/* Settles in BATTERY_DIVIDER_SETTLE_MS, the caller waits */
 			rc = gpio_pin_set_dt(gcp, enable);
-
-			if (enable) {
-				/* Sleep for enable delay */
-				k_sleep(K_MSEC(200));
-			}
 		}
+		if (rc != 0 && enable) {
+			divider_holds--;
+		}
+	}
+	k_mutex_unlock(&divider_lock);
+	return rc;
+}
+
+int battery_divider_hold(bool hold)
+{
+	int rc = battery_measure_enable(hold);
+
+	if (rc == 0) {
+		atomic_add(&divider_ext_holds, hold ? 1 : -1);
 	}
 	return rc;
 }
@@ -229,7 +387,12 @@ static int battery_sample(void)
 		const struct divider_config *dcp = &divider_config;
 		struct adc_sequence *sp = &ddp->adc_seq;
 
+		rc = periph_usage_get(&battery_adc_usage, ddp->adc);
+		if (rc < 0) {
+			return rc;
+		}
 		rc = adc_read(ddp->adc, sp);
+		periph_usage_put(&battery_adc_usage, ddp->adc);
 		sp->calibrate = false;
 		if (rc == 0) {
 			int32_t val = ddp->raw;
@@ -247,107 +410,117 @@ static int battery_sample(void)
 		}
 	}
 
-	return (rc < 0) ? 0 : rc;
+	return rc;
 }
 
 /**
  * @brief Measure battery status and update battery level information.
  *
- * This function measures the battery status, calculates the battery level in pptt, and updates the
- * battery level information. It also checks if the battery level is below a low battery threshold
- * and logs a warning if necessary.
+ * Takes one sample of the powered divider and switches it off again, then corrects the sample
+ * for the IR drop of the running loads and feeds it to the fuel gauge. The state of charge in
+ * pptt and the time to empty are published, and a low battery is signalled on the LED. A failed
+ * sample leaves the fuel gauge and the published values as they are.
  *
- * @return True if the battery level is below the low battery threshold, false otherwise.
+ * @return True if the battery level is below the low battery threshold, false otherwise or if the
+ * sample failed.
  */
-static bool measure_battery_status(moving_average_t *battery_status)
+static bool measure_battery_status(void)
 {
-	// Get current battery voltage
+	uint32_t loads = battery_loads();
+	// Get current battery voltage, the divider is off until the next measurement
 	int current_battery_mV = battery_sample();
-	// Calculate moving average
-	int average_battery_mV = calculate_moving_average(battery_status, current_battery_mV);
-	// Calculate power-to-time-to-charge ratio
-	unsigned int pptt = calculate_level_pptt(average_battery_mV, levels);
+	battery_measure_enable(false);
+
+	if (current_battery_mV < 0) {
+		LOG_WRN("Battery sample failed: %d", current_battery_mV);
+		return false;
+	}
+
+	// Open circuit voltage, the drop of the loads added back
+	int ocv_mV = fuel_gauge_ocv_mv(&fuel_params, current_battery_mV, loads);
+	unsigned int pptt = fuel_gauge_update(&fuel_gauge, &fuel_params,
+					      calculate_level_pptt(ocv_mV, levels), loads,
+					      k_uptime_get());
+	uint32_t tte_min = fuel_gauge_time_to_empty_min(&fuel_gauge, &fuel_params);
+
+	if (IS_ENABLED(CONFIG_APP_POWER_POLICY) && power_policy_update(&power_policy, pptt, tte_min)) {
+		LOG_WRN("power tier %s at %u pptt, %u min", power_tiers[power_policy.tier].name, pptt,
+			tte_min);
+		apply_power_tier(power_policy.tier);
+	}
 
 	// Take the battery semaphore to ensure exclusive access to the global battery pptt value
 	k_sem_take(&batt_data_sem, K_FOREVER);
 	batt_percent.val1 = pptt / 100;        // Update the first digit of the pptt value
 	batt_percent.val2 = (pptt % 100) / 10; // Update the second digit of the pptt value
+	batt_time_to_empty_min = tte_min;
+	batt_avg_ua = fuel_gauge.avg_ua;
 	k_sem_give(&batt_data_sem);            // Release the battery semaphore
 
 	// Check if the pptt is below the low battery threshold and set the low battery status
 	// accordingly
 	bool is_low_battery = (pptt < LOW_BATT_THRESHOLD) ? true : false;
 
-	// length of the log message
-	const char *log_format = "curr : %dmV avg : %d mV; %u pptt, ";
-	const int log_len =
-		snprintf(NULL, 0, log_format, current_battery_mV, average_battery_mV, pptt);
-
-	// Allocate memory for log_message. The allocated memory size is log_len + 1.
-	char *log_message = malloc(log_len + 1);
-
-	if (!log_message) {
-		LOG_ERR("Failed to allocate battery log message");
-		return is_low_battery;
-	}
-
-	// Use snprintf to compose the formatted log message into log_message.
-	snprintf(log_message, log_len + 1, log_format, current_battery_mV, average_battery_mV,
-		 pptt);
+	// Yellow double blink while the battery is low
+	led_signal_set(LED_SIGNAL_LOW_BATTERY, is_low_battery);
 
 	// Log the appropriate message based on the low battery status
-	CODE_IF_ELSE(is_low_battery, LOG_INF("low batt warning %s", log_message),
-		     LOG_DBG("stable batt %s", log_message));
-	free(log_message);
+	CODE_IF_ELSE(is_low_battery,
+		     LOG_INF("low batt warning curr : %dmV ocv : %d mV load 0x%x; %u pptt, %u min",
+			     current_battery_mV, ocv_mV, loads, pptt, tte_min),
+		     LOG_DBG("stable batt curr : %dmV ocv : %d mV load 0x%x; %u pptt, %u min",
+			     current_battery_mV, ocv_mV, loads, pptt, tte_min));
 
 	return is_low_battery; // Return the low battery status
 }
 
+/* Define measurement period in seconds */
+#define MEASUREMENT_PERIOD_SEC 60
+
+/* measurement period on the wakeup grid, may move by 5 seconds */
+static struct tick_align_job battery_tick =
+	TICK_ALIGN_JOB_INIT(MEASUREMENT_PERIOD_SEC * MSEC_PER_SEC, 5000, TICK_ALIGN_GRID_MS);
+
 /**
- * @brief Battery measurement thread function.
+ * @brief Battery measurement work function.
  *
- * This function is the entry point for the battery measurement thread. It initializes the
- * battery measurement and then periodically calls the "measure_battery_status" function to measure
- * battery status. The battery status is maintained with a moving average, and low battery
- * warnings are logged as needed.
+ * Runs on the shared application work queue in two steps. The first powers the divider and
+ * comes back once it settled, the second calls "measure_battery_status", which samples and
+ * switches the divider off again, and schedules the next measurement. A failure to power the
+ * divider is logged and retried at the next measurement. The divider draws
+ * Vbat / 1.68 MOhm (about 2.3 uA) while it is powered, so it is only on for the settling time.
  *
- * thread period current consumption test result
+ * measurement period current consumption test result
  * 10Sec = 3uA
  * 30Sec = 2uA
  * 60Sec = 1uA (Recommend)
  */
-static void battery_measurement_thread(void)
+static void battery_measurement_work_fn(struct k_work *work)
 {
-/* Define filter size for moving average */
-#define FILTER_SIZE 15
-
-	/* Allocate memory for moving average */
-	/* battery percent moving average filter */
-	moving_average_t *battery_status = allocate_moving_average(FILTER_SIZE);
-	if (battery_status == NULL) {
-		return;
-	}
-
-	/* Enable battery measurement */
-	int measurement_status = battery_measure_enable(true);
-
-	/* Check for errors */
-	if (measurement_status != 0) {
-		/* Log error and return */
-		LOG_ERR("Failed to initialize battery measurement: %d", measurement_status);
-		free_moving_average(&battery_status);
-		return;
-	}
-
-	/* Define thread period in seconds */
-#define THREAD_PERIOD_SEC 60
-	/* Loop for continuous measurement */
-	while (1) {
+	static bool settling;
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+
+	if (!settling) {
+		/* Enable battery measurement */
+		int measurement_status = battery_measure_enable(true);
+
+		/* Wait for the divider to settle, an error retries at the next period */
+		if (measurement_status == 0) {
+			settling = true;
+			k_work_reschedule_for_queue(&app_work_q, dwork,
+						    K_MSEC(BATTERY_DIVIDER_SETTLE_MS));
+			return;
+		}
+		LOG_ERR("Failed to enable battery measurement: %d", measurement_status);
+	} else {
 		/* Call function for measuring battery */
-		measure_battery_status(battery_status);
-
-		k_sleep(K_SECONDS(THREAD_PERIOD_SEC));
+		settling = false;
+		measure_battery_status();
 	}
+
+	k_work_reschedule_for_queue(
+		&app_work_q, dwork,
+		K_TIMEOUT_ABS_MS(tick_align_next(&battery_tick, k_uptime_get())));
 }
 
 struct battery_value get_battery_percent(void)
@@ -359,8 +532,27 @@ struct battery_value get_battery_percent(void)
 	return copy;
 }
 
+uint32_t get_battery_time_to_empty(void)
+{
+	k_sem_take(&batt_data_sem, K_FOREVER);
+	uint32_t minutes = batt_time_to_empty_min;
+	k_sem_give(&batt_data_sem);
+
+	return minutes;
+}
+
+uint32_t get_battery_avg_current(void)
+{
+	k_sem_take(&batt_data_sem, K_FOREVER);
+	uint32_t ua = batt_avg_ua;
+	k_sem_give(&batt_data_sem);
+
+	return ua;
+}
+
+const char *get_battery_power_tier(void)
+{
+	return power_tiers[power_policy.tier].name;
+}
+
 SYS_INIT(battery_setup, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
-#define STACKSIZE 1024
-#define PRIORITY  5
-K_THREAD_DEFINE(battmon_id, STACKSIZE, battery_measurement_thread, NULL, NULL, NULL, PRIORITY, 0,
-		0);
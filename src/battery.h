@@ -1,8 +1,18 @@
 #ifndef __APP_BATTERY_H__
 #define __APP_BATTERY_H__
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #define LOW_BATT_THRESHOLD 2000
 
+/* SAADC channel slot and gain used for the vbatt divider */
+#define BATTERY_ADC_CHANNEL_ID 0
+#define BATTERY_ADC_GAIN       ADC_GAIN_1
+
+/* Settling time of the divider after it is powered */
+#define BATTERY_DIVIDER_SETTLE_MS 200
+
 struct battery_value {
 	/** Integer part of the value. Range 0~100*/
 	unsigned int val1;
@@ -20,4 +30,40 @@ struct battery_value {
  */
 struct battery_value get_battery_percent(void);
 
+/**
+ * @brief Get the estimated time until the battery is empty.
+ *
+ * From the fuel gauge: charge left at the average current of the energy model over about the last
+ * half hour.
+ *
+ * @return Minutes, or UINT32_MAX before the first measurement.
+ */
+uint32_t get_battery_time_to_empty(void);
+
+/**
+ * @brief Get the average current of the energy model, over about the last half hour.
+ *
+ * @return µA, 0 before the first measurement.
+ */
+uint32_t get_battery_avg_current(void);
+
+/**
+ * @brief Keep the battery divider powered for another user of its ADC channel.
+ *
+ * Reference counted with the periodic measurement, the divider is off once nobody holds it.
+ * Sampling may start BATTERY_DIVIDER_SETTLE_MS after the first hold. Battery samples taken while
+ * a hold is active are tagged FUEL_GAUGE_LOAD_CAPTURE.
+ *
+ * @param hold True to take a hold, false to release one.
+ * @return 0 on success, -ENOENT without a working divider, or the GPIO error.
+ */
+int battery_divider_hold(bool hold);
+
+/**
+ * @brief Get the name of the power tier in effect.
+ *
+ * @return Name, the normal tier without CONFIG_APP_POWER_POLICY.
+ */
+const char *get_battery_power_tier(void);
+
 #endif // __APP_BATTERY_H__
@@ -27,13 +27,24 @@
 #include <zephyr/drivers/sensor.h>
 
 #include <zephyr/init.h>
+#if defined(CONFIG_SHELL_BT_NUS)
+#include <shell/shell_bt_nus.h>
+#endif
 
 #include "version.h"
+#include "app_work.h"
 #include "battery.h"
 #include "bluetooth.h"
 #include "gas.h"
 #include "hhs_util.h"
 #include "bme680_app.h"
+#include "capture.h"
+#include "data_log.h"
+#include "delta_dfu.h"
+#include "log_ring.h"
+#include "stack_monitor.h"
+#include "supervisor.h"
+#include "tick_align.h"
 
 /* Registers the HHS_BT module with the specified log level. */
 LOG_MODULE_REGISTER(HHS_BT, CONFIG_APP_LOG_LEVEL);
@@ -54,6 +65,26 @@ static bool bt_notify_enable = false;
 /* Variable for not transmitting if the MTU size is not negotiated. */
 static uint16_t mtu_size = 27;
 
+/* Advertising interval in 0.625 ms units, 250 ~ 500 ms until the power policy changes it */
+static uint16_t adv_interval_min = 400;
+static uint16_t adv_interval_max = 800;
+
+/* Interval changed while connected, restart the advertising after the disconnection */
+static bool adv_restart_pending;
+
+/* Advertising wanted, off between the bursts of the duty mode */
+static bool adv_enabled = true;
+
+static void adv_restart_work_fn(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(adv_restart_work, adv_restart_work_fn);
+
+#if defined(CONFIG_APP_DATA_LOG)
+static void log_dump_start(uint32_t count);
+#endif
+#if defined(CONFIG_APP_LOG_RING)
+static void diag_dump_start(void);
+#endif
+
 /**
  * @brief Callback function for Gas Sensor CCC (Client Characteristic Configuration) changes.
  *
@@ -112,29 +143,21 @@ static ssize_t write_ble(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 	// Declare a pointer to a character.
 	char *p = NULL;
 
-	// Define a constant string for the O2 calibration command.
-	const char *PREFIX_O2_CALIB = "O2=";
-	const char *PREFIX_NO2_CALIB = "NO2=";
+	// Calibration commands are "<gas channel name>=<reference>", e.g. "O2=20.9".
+	const char *eq = memchr(buf, '=', len);
+	int gas_channel = eq ? gas_channel_find(buf, eq - (const char *)buf) : -ENOENT;
 	const char *PREFIX_BT_NAME = "BT=";
-        // Check if the buffer contains the O2 calibration command.
-        if (strncmp(buf, PREFIX_O2_CALIB, strlen(PREFIX_O2_CALIB)) == 0) {
-                p = strstr(buf, PREFIX_O2_CALIB);
-                // Calculate the length of the O2 calibration command prefix.
-                size_t prefix_len = strlen(PREFIX_O2_CALIB);
-                // Move the pointer past the prefix to the actual calibration data.
-                p += prefix_len;
-
-                // Call a function to calibrate the oxygen sensor with the provided data.
-                calibrate_oxygen(p, len - prefix_len);
-        } else if (strncmp(buf, PREFIX_NO2_CALIB, strlen(PREFIX_NO2_CALIB)) == 0) {
-                p = strstr(buf, PREFIX_NO2_CALIB);
-                // Calculate the length of the NO2 calibration command prefix.
-                size_t prefix_len = strlen(PREFIX_NO2_CALIB);
+	const char *PREFIX_RAW_CAPTURE = "RAW=";
+	const char *PREFIX_TUNE = "TUNE=";
+	const char *PREFIX_LOG = "LOG=";
+	const char *CMD_DIAG_LOG = "DLOG";
+        // Check if the buffer contains a gas calibration command.
+        if (gas_channel >= 0) {
                 // Move the pointer past the prefix to the actual calibration data.
-                p += prefix_len;
+                size_t prefix_len = eq + 1 - (const char *)buf;
 
-                // Update the electrochemical gas calibration with the provided data.
-                calibrate_gas(p, len - prefix_len);
+                // Update the calibration of the channel with the provided data.
+                gas_calibrate(gas_channel, eq + 1, len - prefix_len);
         } else if (strncmp(buf, PREFIX_BT_NAME, strlen(PREFIX_BT_NAME)) == 0) {
                 p = strstr(buf, PREFIX_BT_NAME);
                 size_t prefix_len = strlen(PREFIX_BT_NAME);
@@ -150,12 +173,144 @@ static ssize_t write_ble(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 
 		k_sleep(K_SECONDS(3));
 		sys_reboot();
+	} else if (strncmp(buf, PREFIX_TUNE, strlen(PREFIX_TUNE)) == 0) {
+		size_t prefix_len = strlen(PREFIX_TUNE);
+
+		// Runtime tuning, "TUNE=<channel>:<parameter>=<value>".
+		gas_tune((const char *)buf + prefix_len, len - prefix_len);
+	}
+#if defined(CONFIG_APP_DATA_LOG)
+	else if (strncmp(buf, PREFIX_LOG, strlen(PREFIX_LOG)) == 0) {
+		size_t prefix_len = strlen(PREFIX_LOG);
+		char count_str[sizeof("65535")] = {0};
+
+		// Send the last <n> records of the data log.
+		memcpy(count_str, (const char *)buf + prefix_len,
+		       MIN(len - prefix_len, sizeof(count_str) - 1));
+		log_dump_start(strtoul(count_str, NULL, 10));
+	}
+#endif
+#if defined(CONFIG_APP_LOG_RING)
+	else if (strncmp(buf, CMD_DIAG_LOG, strlen(CMD_DIAG_LOG)) == 0) {
+		// Drain the binary log ring.
+		diag_dump_start();
 	}
+#endif
+#if defined(CONFIG_APP_RAW_CAPTURE)
+	else if (strncmp(buf, PREFIX_RAW_CAPTURE, strlen(PREFIX_RAW_CAPTURE)) == 0) {
+		size_t prefix_len = strlen(PREFIX_RAW_CAPTURE);
+		char rate_str[sizeof("65535")] = {0};
+
+		// Capture rate in Hz, 0 stops the capture.
+		memcpy(rate_str, (const char *)buf + prefix_len,
+		       MIN(len - prefix_len, sizeof(rate_str) - 1));
+		if (capture_set_rate(strtoul(rate_str, NULL, 10)) != 0) {
+			LOG_WRN("Raw capture not subscribed");
+		}
+	}
+#endif
 
         // Return the number of bytes written to indicate success.
         return len;
 }
 
+#if defined(CONFIG_APP_RAW_CAPTURE)
+static void raw_ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+{
+	capture_subscription_changed(value == BT_GATT_CCC_NOTIFY);
+}
+
+static ssize_t read_raw_info(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			     uint16_t len, uint16_t offset)
+{
+	struct capture_info info;
+
+	capture_get_info(&info);
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &info, sizeof(info));
+}
+
+/* Appended after the notify characteristic so attrs[4] keeps its index */
+#define BT_HHS_RAW_CAPTURE_ATTRS                                                                   \
+	, BT_GATT_CHARACTERISTIC(BT_UUID_HHS_RAW, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,           \
+				 BT_GATT_PERM_READ, read_raw_info, NULL, NULL),                    \
+		BT_GATT_CCC(raw_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE)
+#define BT_HHS_RAW_ATTR_IDX 7
+#else
+#define BT_HHS_RAW_CAPTURE_ATTRS
+#endif
+
+#if defined(CONFIG_APP_STACK_MONITOR)
+static ssize_t read_stack_report(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+				 uint16_t len, uint16_t offset)
+{
+	/* Formatted again on every read, a long read spans several requests */
+	static char report[STACK_MONITOR_REPORT_LEN];
+	int n = stack_monitor_format(report, sizeof(report));
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, report,
+				 MIN(n, (int)sizeof(report) - 1));
+}
+
+/* Read only, after the raw capture so BT_HHS_RAW_ATTR_IDX keeps its index */
+#define BT_HHS_STACK_ATTRS                                                                         \
+	, BT_GATT_CHARACTERISTIC(BT_UUID_HHS_STACK, BT_GATT_CHRC_READ, BT_GATT_PERM_READ,          \
+				 read_stack_report, NULL, NULL)
+#else
+#define BT_HHS_STACK_ATTRS
+#endif
+
+#if defined(CONFIG_APP_DELTA_DFU)
+static ssize_t write_patch(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
+			   uint16_t len, uint16_t offset, uint8_t flags)
+{
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+	if (len < sizeof(uint32_t)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	switch (delta_dfu_write(buf, len)) {
+	case 0:
+		return len;
+	case -EINVAL:
+		// Not the expected patch offset, the client reads the status and resumes.
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	case -ENOMEM:
+	case -EBUSY:
+		return BT_GATT_ERR(BT_ATT_ERR_INSUFFICIENT_RESOURCES);
+	case -EPERM:
+		return BT_GATT_ERR(BT_ATT_ERR_WRITE_NOT_PERMITTED);
+	default:
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+}
+
+static ssize_t read_patch_status(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+				 uint16_t len, uint16_t offset)
+{
+	struct delta_dfu_status status;
+
+	delta_dfu_get_status(&status);
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &status, sizeof(status));
+}
+
+/* A patch rewrites slot 1 like an upload, same security as the SMP characteristic */
+#if defined(CONFIG_MCUMGR_TRANSPORT_BT_PERM_RW_AUTHEN)
+#define BT_HHS_PATCH_PERM_WRITE BT_GATT_PERM_WRITE_AUTHEN
+#else
+#define BT_HHS_PATCH_PERM_WRITE BT_GATT_PERM_WRITE_ENCRYPT
+#endif
+
+/* Last, so BT_HHS_RAW_ATTR_IDX keeps its index */
+#define BT_HHS_PATCH_ATTRS                                                                         \
+	, BT_GATT_CHARACTERISTIC(BT_UUID_HHS_PATCH, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,        \
+				 BT_GATT_PERM_READ | BT_HHS_PATCH_PERM_WRITE, read_patch_status,   \
+				 write_patch, NULL)
+#else
+#define BT_HHS_PATCH_ATTRS
+#endif
+
 /* Service Declaration */
 BT_GATT_SERVICE_DEFINE(bt_hhs_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_HHS),
 		       BT_GATT_CHARACTERISTIC(BT_UUID_HHS_WRITE, BT_GATT_CHRC_WRITE,
@@ -163,7 +318,8 @@ BT_GATT_SERVICE_DEFINE(bt_hhs_svc, BT_GATT_PRIMARY_SERVICE(BT_UUID_HHS),
 		       BT_GATT_CHARACTERISTIC(BT_UUID_HHS_NOTI, BT_GATT_CHRC_NOTIFY,
 					      BT_GATT_PERM_NONE, NULL, NULL, NULL),
 		       BT_GATT_CCC(mylbsbc_ccc_gas_cfg_changed,
-				   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE));
+				   BT_GATT_PERM_READ | BT_GATT_PERM_WRITE) BT_HHS_RAW_CAPTURE_ATTRS
+			       BT_HHS_STACK_ATTRS BT_HHS_PATCH_ATTRS);
 
 /*
  * This is a static constant structure that contains the Bluetooth data.
@@ -295,6 +451,9 @@ static void on_connected(struct bt_conn *conn, uint8_t err)
 
 	// Store connection in global variable
 	my_conn = bt_conn_ref(conn);
+#if defined(CONFIG_SHELL_BT_NUS)
+	shell_bt_nus_enable(conn);
+#endif
 
 	// Declare a structure to store the connection parameters
 	struct bt_conn_info info;
@@ -338,7 +497,19 @@ static void on_connected(struct bt_conn *conn, uint8_t err)
 static void on_disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	LOG_INF("Disconnected (reason %u)", reason);
+#if defined(CONFIG_APP_RAW_CAPTURE)
+	capture_subscription_changed(false);
+#endif
+#if defined(CONFIG_SHELL_BT_NUS)
+	shell_bt_nus_disable();
+#endif
 	bt_conn_unref(my_conn);
+	my_conn = NULL;
+	mtu_size = 27;
+	if (adv_restart_pending || !adv_enabled) {
+		/* After the host resumed the advertising with the old interval */
+		k_work_reschedule_for_queue(&app_work_q, &adv_restart_work, K_MSEC(100));
+	}
 }
 
 /**
@@ -401,30 +572,14 @@ struct bt_conn_cb connection_callbacks = {
 };
 
 /**
- * Initialize and configure Bluetooth functionality.
- *
- * This function sets up the Bluetooth stack, configures advertising parameters, and starts
- * advertising. It also registers connection callbacks for handling Bluetooth connection events.
+ * Start connectable advertising at the current interval.
  *
- * Current Consumption
- * 1Sec = 16uA
- * 2Sec = 8uA
+ * The host resumes it after each disconnection with the same parameters.
  *
  * @return 0 on success, or a negative error code on failure.
  */
-int bt_setup(void)
+static int adv_start(void)
 {
-	int err;
-
-	err = bt_enable(NULL);
-	if (err) {
-		LOG_ERR("Bluetooth init failed (err %d)", err);
-		return err;
-	}
-	bt_conn_cb_register(&connection_callbacks);
-
-	LOG_INF("Bluetooth initialized");
-
 	const char *bt_name = (char *)get_config(BT_ADV_NAME);
 
 	/**
@@ -443,17 +598,101 @@ int bt_setup(void)
 	struct bt_le_adv_param *adv_param = BT_LE_ADV_PARAM(
 		(BT_LE_ADV_OPT_CONNECTABLE |
 		 BT_LE_ADV_OPT_USE_IDENTITY), /* Connectable advertising and use identity address */
-		400,                          /* Min Advertising Interval 500ms (800*0.625ms) */
-		800,                          /* Max Advertising Interval 2000ms (3200*0.625ms) */
+		adv_interval_min,             /* Min Advertising Interval, 0.625 ms units */
+		adv_interval_max,             /* Max Advertising Interval, 0.625 ms units */
 		NULL);                        /* Set to NULL for undirected advertising */
 
-	err = bt_le_adv_start(adv_param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	int err = bt_le_adv_start(adv_param, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
 	if (err) {
 		LOG_ERR("Advertising failed to start (err %d)", err);
 		return err;
 	}
+	adv_restart_pending = false;
+	return 0;
+}
+
+/* Restart advertising with a changed interval, or stop it */
+static void adv_restart_work_fn(struct k_work *work)
+{
+	if (my_conn != NULL) {
+		/* Not advertising now, applied after the disconnection */
+		adv_restart_pending = true;
+		return;
+	}
+	bt_le_adv_stop();
+	if (!adv_enabled) {
+		adv_restart_pending = false;
+		LOG_INF("Advertising stopped");
+		return;
+	}
+	if (adv_start() == 0) {
+		LOG_INF("Advertising interval %u ~ %u ms", adv_interval_min * 5 / 8,
+			adv_interval_max * 5 / 8);
+	}
+}
+
+void bt_set_adv_interval(uint16_t min_ms, uint16_t max_ms)
+{
+	/* 0.625 ms units */
+	uint16_t min = (uint32_t)min_ms * 8 / 5;
+	uint16_t max = (uint32_t)max_ms * 8 / 5;
+
+	if (min == adv_interval_min && max == adv_interval_max) {
+		return;
+	}
+	adv_interval_min = min;
+	adv_interval_max = max;
+	k_work_reschedule_for_queue(&app_work_q, &adv_restart_work, K_NO_WAIT);
+}
 
-	LOG_INF("Advertising successfully started");
+void bt_set_advertising(bool enable)
+{
+	if (enable == adv_enabled) {
+		return;
+	}
+	adv_enabled = enable;
+	k_work_reschedule_for_queue(&app_work_q, &adv_restart_work, K_NO_WAIT);
+}
+
+/**
+ * Initialize and configure Bluetooth functionality.
+ *
+ * This function sets up the Bluetooth stack, configures advertising parameters, and starts
+ * advertising. It also registers connection callbacks for handling Bluetooth connection events.
+ *
+ * Current Consumption
+ * 1Sec = 16uA
+ * 2Sec = 8uA
+ *
+ * @return 0 on success, or a negative error code on failure.
+ */
+int bt_setup(void)
+{
+	int err;
+
+	err = bt_enable(NULL);
+	if (err) {
+		LOG_ERR("Bluetooth init failed (err %d)", err);
+		return err;
+	}
+	bt_conn_cb_register(&connection_callbacks);
+
+#if defined(CONFIG_SHELL_BT_NUS)
+	err = shell_bt_nus_init();
+	if (err) {
+		LOG_ERR("NUS shell init failed (err %d)", err);
+	}
+#endif
+
+	LOG_INF("Bluetooth initialized");
+
+	if (adv_enabled) {
+		err = adv_start();
+		if (err) {
+			return err;
+		}
+		LOG_INF("Advertising successfully started");
+	}
 
 	k_event_init(&bt_event);
 
@@ -472,12 +711,9 @@ int bt_setup(void)
  */
 static int bt_gas_notify(char *p_gas_sensor_data)
 {
-	char log_string[sizeof("notify data of length: 999") + 1];
 	uint8_t data_length = strlen(p_gas_sensor_data);
 
-	snprintf(log_string, sizeof("notify data of length: 999") + 1, "notify data of length: %d",
-		 data_length);
-	LOG_HEXDUMP_INF(p_gas_sensor_data, data_length, log_string);
+	LOG_HEXDUMP_DBG(p_gas_sensor_data, data_length, "notify");
 
 	if (mtu_size < data_length) {
 		LOG_WRN("MTU size %d is smaller than data length %d", mtu_size, data_length);
@@ -488,6 +724,198 @@ static int bt_gas_notify(char *p_gas_sensor_data)
 			      (size_t)data_length);
 }
 
+#if defined(CONFIG_APP_DATA_LOG)
+/* Records sent per run of the dump, the other items of the queue run in between */
+#define LOG_DUMP_CHUNK 8
+
+/* Records requested by "LOG=<n>", 0 for none */
+static atomic_t log_dump_request;
+
+/* Record indices of the dump in progress, [next, end) */
+static uint32_t log_dump_next;
+static uint32_t log_dump_end;
+
+struct log_dump_ctx {
+	uint32_t index;
+	uint32_t sent;
+};
+
+static int count_record(const struct data_log_record *rec, void *arg)
+{
+	ARG_UNUSED(rec);
+	(*(uint32_t *)arg)++;
+	return 0;
+}
+
+/* "L<boot>;<uptime s>;<level>;...;<battery %>;<temp 0.01 C>;<faults>;...", one per notification */
+static int send_record(const struct data_log_record *rec, void *arg)
+{
+	struct log_dump_ctx *ctx = arg;
+	char line[sizeof("L65535;4294967295;") + GAS_CHANNEL_COUNT * sizeof("6553.5;") +
+		  sizeof("100;-32768") + GAS_CHANNEL_COUNT * sizeof(";255") + sizeof("\n")];
+	int len;
+
+	if (ctx->index++ < log_dump_next) {
+		return 0;
+	}
+
+	len = snprintf(line, sizeof(line), "L%u;%u;", rec->boot, rec->uptime_s);
+	for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+		len += snprintf(line + len, sizeof(line) - len, "%u.%u;",
+				(uint16_t)rec->level[i] / 10, (uint16_t)rec->level[i] % 10);
+	}
+	len += snprintf(line + len, sizeof(line) - len, "%u;%d", rec->battery_pptt / 100,
+			rec->temp_centi_c);
+	for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+		len += snprintf(line + len, sizeof(line) - len, ";%u", rec->faults[i]);
+	}
+	snprintf(line + len, sizeof(line) - len, "\n");
+	bt_gas_notify(line);
+
+	log_dump_next++;
+	return ++ctx->sent == LOG_DUMP_CHUNK || log_dump_next == log_dump_end;
+}
+
+static void log_dump_work_fn(struct k_work *work)
+{
+	uint32_t request = atomic_set(&log_dump_request, 0);
+	struct log_dump_ctx ctx = {0};
+
+	if (request != 0) {
+		uint32_t total = 0;
+
+		data_log_walk(count_record, &total);
+		log_dump_end = total;
+		log_dump_next = total > request ? total - request : 0;
+	}
+	if (my_conn == NULL || log_dump_next >= log_dump_end) {
+		log_dump_end = 0;
+		return;
+	}
+
+	data_log_walk(send_record, &ctx);
+	if (ctx.sent != 0 && log_dump_next < log_dump_end) {
+		k_work_reschedule_for_queue(&app_work_q, k_work_delayable_from_work(work),
+					    K_NO_WAIT);
+	}
+}
+
+static K_WORK_DELAYABLE_DEFINE(log_dump_work, log_dump_work_fn);
+
+static void log_dump_start(uint32_t count)
+{
+	atomic_set(&log_dump_request, count);
+	k_work_reschedule_for_queue(&app_work_q, &log_dump_work, K_NO_WAIT);
+}
+#endif // CONFIG_APP_DATA_LOG
+
+#if defined(CONFIG_APP_LOG_RING)
+/* Notifications sent per run of the drain, and ring bytes in each */
+#define DIAG_DUMP_CHUNK 8
+#define DIAG_DUMP_BYTES 64
+
+/* "D<hex>" per notification, an empty "D" once the ring is empty */
+static void diag_dump_work_fn(struct k_work *work)
+{
+	uint8_t bytes[DIAG_DUMP_BYTES];
+	char line[sizeof("D") + 2 * DIAG_DUMP_BYTES + sizeof("\n")];
+
+	if (my_conn == NULL || mtu_size <= sizeof("D\n")) {
+		return;
+	}
+
+	size_t max = MIN(DIAG_DUMP_BYTES, (mtu_size - sizeof("D\n")) / 2);
+
+	for (int i = 0; i < DIAG_DUMP_CHUNK; i++) {
+		size_t n = log_ring_read(bytes, max);
+		size_t len = 1 + bin2hex(bytes, n, line + 1, sizeof(line) - 1);
+
+		line[0] = 'D';
+		snprintf(line + len, sizeof(line) - len, "\n");
+		bt_gas_notify(line);
+		if (n == 0) {
+			return;
+		}
+	}
+	k_work_reschedule_for_queue(&app_work_q, k_work_delayable_from_work(work), K_NO_WAIT);
+}
+
+static K_WORK_DELAYABLE_DEFINE(diag_dump_work, diag_dump_work_fn);
+
+static void diag_dump_start(void)
+{
+	k_work_reschedule_for_queue(&app_work_q, &diag_dump_work, K_NO_WAIT);
+}
+#endif // CONFIG_APP_LOG_RING
+
+bool bt_connected(void)
+{
+	return my_conn != NULL;
+}
+
+uint16_t bt_payload_mtu(void)
+{
+	return mtu_size;
+}
+
+#if defined(CONFIG_APP_RAW_CAPTURE)
+int bt_raw_notify(const void *data, uint16_t len, bt_gatt_complete_func_t func)
+{
+	struct bt_gatt_notify_params params = {
+		.attr = &bt_hhs_svc.attrs[BT_HHS_RAW_ATTR_IDX],
+		.data = data,
+		.len = len,
+		.func = func,
+	};
+
+	return bt_gatt_notify_cb(my_conn, &params);
+}
+#endif
+
+/* BIT(enum bt_throughput_user) of the users holding throughput mode */
+static uint32_t throughput_users;
+static K_MUTEX_DEFINE(throughput_lock);
+
+static void apply_throughput_mode(bool enable)
+{
+	struct bt_le_conn_param *param;
+	int err;
+
+	if (my_conn == NULL) {
+		return;
+	}
+
+	if (enable) {
+		update_phy(my_conn);
+		/* 7.5 ~ 15 ms interval, several 251 byte PDUs per event */
+		param = BT_LE_CONN_PARAM(6, 12, 0, 400);
+	} else {
+		param = BT_LE_CONN_PARAM(CONFIG_BT_PERIPHERAL_PREF_MIN_INT,
+					 CONFIG_BT_PERIPHERAL_PREF_MAX_INT,
+					 CONFIG_BT_PERIPHERAL_PREF_LATENCY,
+					 CONFIG_BT_PERIPHERAL_PREF_TIMEOUT);
+	}
+
+	err = bt_conn_le_param_update(my_conn, param);
+	if (err) {
+		LOG_WRN("conn param update failed (err %d)", err);
+	}
+}
+
+void bt_throughput_mode(enum bt_throughput_user user, bool enable)
+{
+	uint32_t users;
+
+	k_mutex_lock(&throughput_lock, K_FOREVER);
+	users = enable ? throughput_users | BIT(user) : throughput_users & ~BIT(user);
+	/* Only the first user in and the last one out change the link */
+	if ((users != 0) != (throughput_users != 0)) {
+		apply_throughput_mode(users != 0);
+	}
+	throughput_users = users;
+	k_mutex_unlock(&throughput_lock);
+}
+
 /**
  * @brief Bluetooth thread function.
  *
@@ -517,12 +945,17 @@ static void bluetooth_thread(void)
 		epoch_time = mktime(&build_time_tm);
 	}
 	char event_info_str[sizeof("type 0xff\n")];
+	/* Periodic publish on the wakeup grid, events in between do not move it */
+	struct tick_align_job publish_tick =
+		TICK_ALIGN_JOB_INIT(TIMEOUT_SEC * MSEC_PER_SEC, 1000, TICK_ALIGN_GRID_MS);
 
 	/* Loop for sending notifications */
 	while (1) {
 		/* Wait for events from the Bluetooth event queue */
-		uint32_t bluetooth_events =
-			k_event_wait(&bt_event, bt_tx_event_sum, true, K_SECONDS(TIMEOUT_SEC));
+		uint32_t bluetooth_events = k_event_wait(
+			&bt_event, bt_tx_event_sum, true,
+			K_TIMEOUT_ABS_MS(tick_align_next(&publish_tick, k_uptime_get())));
+		supervisor_checkin(SUPERVISOR_BT);
 		/* Check if timeout event occurred */
 		snprintf(event_info_str, sizeof(event_info_str), "type 0x%02X", bluetooth_events);
 		/* Log event information */
@@ -534,9 +967,6 @@ static void bluetooth_thread(void)
 			continue;
 		}
 
-		/* Get gas sensor values */
-		struct gas_sensor_value oxygen = get_gas_data(O2);
-		struct gas_sensor_value gas = get_gas_data(GAS);
 		/* Get battery percentage */
 		struct battery_value battery = get_battery_percent();
 		/* Get BME680 sensor data */
@@ -548,23 +978,38 @@ static void bluetooth_thread(void)
 		char timestamp[sizeof("01-01T00:00:00")];
 		strftime(timestamp, sizeof(timestamp), "%m-%dT%X", gmtime(&current_time));
 
-		const char *message_format = "%u.%u;%u.%u;%u;%u.%u;%u;%u\n";
-		const int message_len = snprintf(NULL, 0, message_format, oxygen.val1, oxygen.val2,
-						 gas.val1, gas.val2, battery.val1,
-						 environment.temp.val1, environment.temp.val2,
-						 environment.press.val1, environment.humidity.val1);
-		char *notify_data = malloc(message_len + 1);
-		if (!notify_data) {
-			LOG_ERR("notify data alloc failed");
-			continue;
+		/*
+		 * One "val1.val2;" field per gas channel in devicetree order, then the rest, then one
+		 * fault bitmask per gas channel
+		 */
+		const char *message_format = "%u;%u.%u;%u;%u";
+		char notify_data[GAS_CHANNEL_COUNT * sizeof("4294967295.4294967295;") +
+				 sizeof("4294967295;4294967295.4294967295;4294967295;4294967295") +
+				 GAS_CHANNEL_COUNT * sizeof(";4294967295") + sizeof("\n")];
+		unsigned int faults[GAS_CHANNEL_COUNT];
+		int message_len = 0;
+
+		for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+			/* Get gas sensor values */
+			struct gas_sensor_value gas = get_gas_data(i);
+
+			faults[i] = gas.faults;
+			message_len += snprintf(notify_data + message_len,
+						sizeof(notify_data) - message_len, "%u.%u;",
+						gas.val1, gas.val2);
+		}
+		message_len += snprintf(notify_data + message_len,
+					sizeof(notify_data) - message_len, message_format,
+					battery.val1, environment.temp.val1, environment.temp.val2,
+					environment.press.val1, environment.humidity.val1);
+		for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+			message_len += snprintf(notify_data + message_len,
+						sizeof(notify_data) - message_len, ";%u", faults[i]);
 		}
-		snprintf(notify_data, message_len + 1, message_format, oxygen.val1, oxygen.val2,
-			 gas.val1, gas.val2, battery.val1, environment.temp.val1,
-			 environment.temp.val2, environment.press.val1, environment.humidity.val1);
+		snprintf(notify_data + message_len, sizeof(notify_data) - message_len, "\n");
 
 		/* Send gas notification */
 		bt_gas_notify(notify_data);
-		free(notify_data);
 	}
 }
 
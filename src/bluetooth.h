@@ -3,6 +3,8 @@
 
 #include <stdbool.h>
 
+#include <zephyr/bluetooth/gatt.h>
+
 #include "hhs_util.h"
 
 /** @brief LBS Service UUID. */
@@ -11,10 +13,19 @@
 #define BT_UUID_HHS_NOTI_VAL  BT_UUID_128_ENCODE(0x0000FFF1, 0x0000, 0x1000, 0x8000, 0x00805F9B34FB)
 /** @brief Write Characteristic UUID. */
 #define BT_UUID_HHS_WRITE_VAL BT_UUID_128_ENCODE(0x0000FFF2, 0x0000, 0x1000, 0x8000, 0x00805F9B34FB)
+/** @brief Raw Capture Characteristic UUID. */
+#define BT_UUID_HHS_RAW_VAL   BT_UUID_128_ENCODE(0x0000FFF3, 0x0000, 0x1000, 0x8000, 0x00805F9B34FB)
+/** @brief Stack Report Characteristic UUID. */
+#define BT_UUID_HHS_STACK_VAL BT_UUID_128_ENCODE(0x0000FFF4, 0x0000, 0x1000, 0x8000, 0x00805F9B34FB)
+/** @brief Delta Patch Characteristic UUID. */
+#define BT_UUID_HHS_PATCH_VAL BT_UUID_128_ENCODE(0x0000FFF5, 0x0000, 0x1000, 0x8000, 0x00805F9B34FB)
 
 #define BT_UUID_HHS       BT_UUID_DECLARE_128(BT_UUID_HHS_VAL)
 #define BT_UUID_HHS_NOTI  BT_UUID_DECLARE_128(BT_UUID_HHS_NOTI_VAL)
 #define BT_UUID_HHS_WRITE BT_UUID_DECLARE_128(BT_UUID_HHS_WRITE_VAL)
+#define BT_UUID_HHS_RAW   BT_UUID_DECLARE_128(BT_UUID_HHS_RAW_VAL)
+#define BT_UUID_HHS_STACK BT_UUID_DECLARE_128(BT_UUID_HHS_STACK_VAL)
+#define BT_UUID_HHS_PATCH BT_UUID_DECLARE_128(BT_UUID_HHS_PATCH_VAL)
 
 /** Product : 10sec **/
 #define TIMEOUT_SEC 10
@@ -39,4 +50,66 @@ extern struct k_event bt_event;
 
 int bt_setup(void);
 
+/**
+ * @brief Whether a central is connected.
+ */
+bool bt_connected(void);
+
+/**
+ * @brief Change the advertising interval.
+ *
+ * Advertising restarts with it right away, or after the disconnection while a central is
+ * connected.
+ *
+ * @param min_ms Minimum interval, ms.
+ * @param max_ms Maximum interval, ms, at most 10240.
+ */
+void bt_set_adv_interval(uint16_t min_ms, uint16_t max_ms);
+
+/**
+ * @brief Start or stop advertising.
+ *
+ * Applied right away, or after the disconnection while a central is connected.
+ *
+ * @param enable True to advertise.
+ */
+void bt_set_advertising(bool enable);
+
+/**
+ * @brief Current ATT payload size in bytes (negotiated MTU minus the ATT header).
+ */
+uint16_t bt_payload_mtu(void);
+
+/**
+ * @brief Send a notification on the raw capture characteristic.
+ *
+ * The data is copied, @p func is called once the notification has been handed to the controller.
+ *
+ * @return 0 on success, or a negative error code from bt_gatt_notify_cb().
+ */
+int bt_raw_notify(const void *data, uint16_t len, bt_gatt_complete_func_t func);
+
+/** Users of the high throughput parameters, see bt_throughput_mode(). */
+enum bt_throughput_user {
+	/** Raw capture stream, src/capture.c. */
+	BT_THROUGHPUT_CAPTURE,
+	/** SMP image upload, src/dfu.c. */
+	BT_THROUGHPUT_SMP,
+	/** Delta patch transfer, src/delta_dfu.c. */
+	BT_THROUGHPUT_DELTA,
+};
+
+/**
+ * @brief Hold or release the high throughput parameters of the connection for @p user.
+ *
+ * High throughput requests the 2M PHY and a 7.5-15 ms connection interval. The first user to hold
+ * it switches the link, the preferred peripheral connection parameters come back once the last
+ * user released it. Holding or releasing twice counts once, so a user may release on every stop
+ * path.
+ *
+ * @param user Caller.
+ * @param enable True to hold, false to release.
+ */
+void bt_throughput_mode(enum bt_throughput_user user, bool enable);
+
 #endif // __APP_BT_H__
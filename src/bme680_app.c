@@ -7,11 +7,16 @@
  */
 #include <math.h>
 
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 
 #include <drivers/bme68x_iaq.h>
 
+#include "app_work.h"
 #include "bme680_app.h"
+#include "led.h"
+#include "supervisor.h"
 #if defined(CONFIG_BME68X_IAQ_EN)
 #include "bluetooth.h"
 #endif // CONFIG_BME68X_IAQ_EN
@@ -43,6 +48,20 @@ const struct sensor_trigger trigger = {
 /* Initialize the BME680 data structure with default values. */
 struct bme680_data bme680 = {0};
 
+/* Consumers of the environment snapshot, see bme680_add_env_listener() */
+static bme680_env_cb_t env_listeners[BME680_ENV_LISTENERS_MAX];
+
+int bme680_add_env_listener(bme680_env_cb_t cb)
+{
+	for (int i = 0; i < ARRAY_SIZE(env_listeners); i++) {
+		if (env_listeners[i] == NULL) {
+			env_listeners[i] = cb;
+			return 0;
+		}
+	}
+	return -ENOMEM;
+}
+
 /**
  * @brief Truncates the number of decimal places in the sensor data received from the Zephyr sensor.
  * The default valid range for decimal data is 6 digits, but this can be adjusted by specifying
@@ -96,6 +115,9 @@ static void trigger_handler(const struct device *dev, const struct sensor_trigge
 	// Initialize static variables
 	static bool is_init = true;
 
+	// Called from the BSEC thread on every sample
+	supervisor_checkin(SUPERVISOR_BSEC);
+
 	// Take the BME680 semaphore to ensure exclusive access to the sensor
 	k_sem_take(&bme680_sem, K_FOREVER);
 
@@ -111,6 +133,9 @@ static void trigger_handler(const struct device *dev, const struct sensor_trigge
 	sensor_channel_get(dev, SENSOR_CHAN_VOC, &bme680.breathVOC);
 #endif // CONFIG_BME68X_IAQ_EN
 
+	const struct bme680_env env =
+		bme680_env_from_sensor(&bme680.temp, &bme680.press, &bme680.humidity);
+
 	truncate_sensor_data_decimal_places(&bme680.temp.val2, 1);
 	truncate_sensor_data_decimal_places(&bme680.press.val2, 2);
 	truncate_sensor_data_decimal_places(&bme680.humidity.val2, 2);
@@ -118,6 +143,11 @@ static void trigger_handler(const struct device *dev, const struct sensor_trigge
 	// Release the BME680 semaphore
 	k_sem_give(&bme680_sem);
 
+	// Push the new snapshot to the compensation stages
+	for (int i = 0; i < ARRAY_SIZE(env_listeners) && env_listeners[i] != NULL; i++) {
+		env_listeners[i](&env);
+	}
+
 	// If this is the first time the function is called, release the temperature semaphore
 	if (is_init && bme680.temp.val1 > 0) {
 		is_init = false;
@@ -188,17 +218,60 @@ struct bme680_data get_bme680_data(void)
 	return copy;
 }
 
+int bme680_set_ulp(bool ulp)
+{
+	const struct device *const bme68x_device = DEVICE_DT_GET_ANY(bosch_bme68x);
+	/* 0.0033 Hz selects ULP, the LP rate the configured one */
+	struct sensor_value rate = ulp ? (struct sensor_value){0, 3333}
+				       : (struct sensor_value){0, 333333};
+
+	return sensor_attr_set(bme68x_device, SENSOR_CHAN_ALL, SENSOR_ATTR_SAMPLING_FREQUENCY,
+			       &rate);
+}
+
+int bme680_save_state(void)
+{
+	const struct device *const bme68x_device = DEVICE_DT_GET_ANY(bosch_bme68x);
+	struct sensor_value unused = {0};
+
+	return sensor_attr_set(bme68x_device, SENSOR_CHAN_ALL,
+			       (enum sensor_attribute)SENSOR_ATTR_BSEC_SAVE_STATE, &unused);
+}
+
+int bme680_get_step_time(uint32_t *last_us, uint32_t *max_us)
+{
+	const struct device *const bme68x_device = DEVICE_DT_GET_ANY(bosch_bme68x);
+	struct sensor_value last;
+	struct sensor_value max;
+	int err = sensor_attr_get(bme68x_device, SENSOR_CHAN_ALL,
+				  (enum sensor_attribute)SENSOR_ATTR_BSEC_STEP_US, &last);
+
+	if (err == 0) {
+		err = sensor_attr_get(bme68x_device, SENSOR_CHAN_ALL,
+				      (enum sensor_attribute)SENSOR_ATTR_BSEC_STEP_MAX_US, &max);
+	}
+	if (err < 0) {
+		return err;
+	}
+	*last_us = last.val1;
+	*max_us = max.val1;
+	return 0;
+}
+
 #endif // CONFIG_BME68X
 
 /**
- * @brief The BME680 thread function runs only once and performs two tasks:
+ * @brief The BME680 start up work runs only once and performs two tasks:
  *
  * 1.Initializes the Bosch BME68x device and registers the trigger handler.
  * 2.Initializes the temperature semaphore so that when temperature data is available,
  * the gas sensor can start operating
  * (the gas sensor's results are calibrated based on temperature)
+ *
+ * It is a one-shot item on the shared application work queue, delayed by one second to allow
+ * the device to initialize, so no stack is kept after it ran.
  */
-static void bme680_thread_function(void)
+static void bme680_start_work_fn(struct k_work *work)
 {
 	// Get the device structure for the Bosch BME68x sensor
 	const struct device *const bme68x_device = DEVICE_DT_GET_ANY(bosch_bme68x);
@@ -206,23 +279,31 @@ static void bme680_thread_function(void)
 	// Check if the device is ready
 	if (!device_is_ready(bme68x_device)) {
 		LOG_ERR("BME68x device is not ready");
+		led_signal_set(LED_SIGNAL_SENSOR_FAULT, true);
 		return;
 	}
 
-	// Initialize the temperature semaphore with initial value of 0 and maximum value of 1
-	k_sem_init(&temperature_semaphore, 0, 1);
-
-	// Sleep for 1 second to allow the device to initialize
-	k_sleep(K_SECONDS(1));
-
 	// Set the trigger for the device and register the trigger handler
 	int trigger_set_status = sensor_trigger_set(bme68x_device, &trigger, trigger_handler);
 	if (trigger_set_status) {
 		LOG_ERR("Failed to set trigger for BME68x device");
+		led_signal_set(LED_SIGNAL_SENSOR_FAULT, true);
 		return;
 	}
+
+	// Samples arrive from here on, a stalled BSEC thread is a hang
+	supervisor_set_required(SUPERVISOR_BSEC, true);
+}
+
+static K_WORK_DELAYABLE_DEFINE(bme680_start_work, bme680_start_work_fn);
+
+static int bme680_start(void)
+{
+	// Initialize the temperature semaphore with initial value of 0 and maximum value of 1
+	k_sem_init(&temperature_semaphore, 0, 1);
+
+	k_work_schedule_for_queue(&app_work_q, &bme680_start_work, K_SECONDS(1));
+	return 0;
 }
 
-#define STACKSIZE 1024
-#define PRIORITY  3
-K_THREAD_DEFINE(bme680_id, STACKSIZE, bme680_thread_function, NULL, NULL, NULL, PRIORITY, 0, 0);
+SYS_INIT(bme680_start, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -12,6 +12,8 @@
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/kernel.h>
 
+#include "bme680_env.h"
+
 extern struct k_sem temperature_semaphore;
 
 #if defined(CONFIG_BME68X)
@@ -29,7 +31,7 @@ struct bme680_data {
 	struct sensor_value temp;
 
 	/**
-	 * @brief Atmospheric pressure data in hPa, ranging from 300 to 1100. Sensitivity error is
+	 * @brief Atmospheric pressure data in Pa, ranging from 30000 to 110000. Sensitivity error is
 	 * ±0.25%.
 	 */
 	struct sensor_value press;
@@ -67,5 +69,43 @@ struct bme680_data {
  */
 struct bme680_data get_bme680_data(void);
 
+/** Listener called from the sensor trigger context, keep it short. */
+typedef void (*bme680_env_cb_t)(const struct bme680_env *env);
+
+/** Number of listener slots. */
+#define BME680_ENV_LISTENERS_MAX 2
+
+/**
+ * @brief Register a listener for new environment samples.
+ *
+ * @param cb Listener.
+ * @return 0 on success, -ENOMEM if all slots are taken.
+ */
+int bme680_add_env_listener(bme680_env_cb_t cb);
+
+/**
+ * @brief Switch BSEC between the configured sample rate and ultra low power (300 s).
+ *
+ * @param ulp True for ultra low power.
+ * @return 0 on success, or a negative error code.
+ */
+int bme680_set_ulp(bool ulp);
+
+/**
+ * @brief Save the BSEC state to flash now instead of at the next save interval.
+ *
+ * @return 0 on success, or a negative error code.
+ */
+int bme680_save_state(void);
+
+/**
+ * @brief Processing time of BSEC for one sample, the bsec_do_steps() call.
+ *
+ * @param last_us Last sample, µs.
+ * @param max_us Longest since boot, µs.
+ * @return 0 on success, or a negative error code.
+ */
+int bme680_get_step_time(uint32_t *last_us, uint32_t *max_us);
+
 #endif // CONFIG_BME68X
 #endif // __APP_BME680_H__
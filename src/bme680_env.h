@@ -0,0 +1,58 @@
+/**
+ * @file src/bme680_env.h
+ * @brief Fixed point environment snapshot of a BME680 sample.
+ *
+ * Only depends on struct sensor_value, so tools/gas_replay checks the conversion from the driver
+ * channels on the host.
+ */
+#ifndef __APP_BME680_ENV_H__
+#define __APP_BME680_ENV_H__
+
+#include <stdint.h>
+
+#include <zephyr/drivers/sensor.h>
+
+/**
+ * @struct bme680_env
+ * @brief Environment snapshot pushed to the listeners on every new BME680 sample.
+ *
+ * Fixed point and not truncated like struct bme680_data, for compensation of other sensors.
+ */
+struct bme680_env {
+	/** Temperature in 0.01 °C. */
+	int32_t temp_centi_c;
+	/** Pressure in Pa. */
+	int32_t press_pa;
+	/** Relative humidity in 0.01 %. */
+	int32_t humidity_centi_pct;
+};
+
+/* 0.01 units of a sensor value, before the decimal truncation */
+static inline int32_t bme680_sensor_value_centi(const struct sensor_value *val)
+{
+	return val->val1 * 100 + val->val2 / 10000;
+}
+
+/**
+ * @brief Build the snapshot from the channels of the bme68x_iaq driver.
+ *
+ * SENSOR_CHAN_PRESS carries BSEC_OUTPUT_RAW_PRESSURE as it is, in Pa and not in the kPa of the
+ * Zephyr sensor API.
+ *
+ * @param temp SENSOR_CHAN_AMBIENT_TEMP value.
+ * @param press SENSOR_CHAN_PRESS value.
+ * @param humidity SENSOR_CHAN_HUMIDITY value.
+ * @return The snapshot.
+ */
+static inline struct bme680_env bme680_env_from_sensor(const struct sensor_value *temp,
+						       const struct sensor_value *press,
+						       const struct sensor_value *humidity)
+{
+	return (struct bme680_env){
+		.temp_centi_c = bme680_sensor_value_centi(temp),
+		.press_pa = press->val1,
+		.humidity_centi_pct = bme680_sensor_value_centi(humidity),
+	};
+}
+
+#endif // __APP_BME680_ENV_H__
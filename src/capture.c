@@ -0,0 +1,334 @@
+/**
+ * @file src/capture.c - raw SAADC capture over BLE
+ *
+ * @brief Diagnostic mode that samples the gas and battery ADC channels at a fixed rate and streams
+ * the raw 12 bit values over the FFF3 characteristic.
+ *
+ * The SAADC runs blocks of scans with adc_read_async(), one block per notification, while the
+ * previous block is packed and sent. The ADC is released between blocks so the gas and battery
+ * threads keep measuring; the short gaps this causes are visible in the frame timestamps.
+ * Notifications are limited to CONFIG_APP_RAW_CAPTURE_TX_COUNT in flight. A block that finds no
+ * free buffer is dropped and counted instead of stalling the sampling.
+ *
+ * The battery divider is only powered around the periodic measurement, the capture holds it on
+ * from its start to its stop so the vbatt channel reads the divider output.
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <string.h>
+
+#include <zephyr/drivers/adc.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <periph_usage.h>
+
+#include "battery.h"
+#include "bluetooth.h"
+#include "capture.h"
+
+LOG_MODULE_REGISTER(CAPTURE, CONFIG_APP_LOG_LEVEL);
+
+#define CAPTURE_RESOLUTION 12
+#define CAPTURE_CHANNEL_IDS 8 /* SAADC channel slots */
+#define CAPTURE_PAYLOAD_MAX (CONFIG_BT_L2CAP_TX_MTU - 3)
+#define CAPTURE_SAMPLES_MAX ((CAPTURE_PAYLOAD_MAX - sizeof(struct capture_frame_hdr)) * 2 / 3)
+
+#define VBATT DT_PATH(vbatt)
+
+#define GAS_SPEC_AND_COMMA(node_id) ADC_DT_SPEC_GET(node_id),
+#define GAS_ID_CHECK(node_id)                                                                      \
+	BUILD_ASSERT(DT_IO_CHANNELS_INPUT(node_id) != BATTERY_ADC_CHANNEL_ID,                      \
+		     "Gas channel on the SAADC slot of the battery divider");
+
+/* Gas cells of hhs,gas-channels, the divider channel is added in capture_channels_setup() */
+static const struct adc_dt_spec gas_channels[] = {
+	DT_FOREACH_CHILD_STATUS_OKAY(GAS_CHANNELS_NODE, GAS_SPEC_AND_COMMA)};
+
+DT_FOREACH_CHILD_STATUS_OKAY(GAS_CHANNELS_NODE, GAS_ID_CHECK)
+BUILD_ASSERT(CAPTURE_MAX_CHANNELS <= CAPTURE_CHANNEL_IDS, "More capture channels than SAADC slots");
+
+static const struct device *const adc_dev = DEVICE_DT_GET(DT_IO_CHANNELS_CTLR(VBATT));
+
+/* Requested scan rate, 0 while stopped */
+static atomic_t capture_rate;
+static bool subscribed;
+/* The capture holds the battery divider on */
+static atomic_t divider_held;
+
+K_SEM_DEFINE(capture_start_sem, 0, 1);
+K_SEM_DEFINE(capture_tx_sem, CONFIG_APP_RAW_CAPTURE_TX_COUNT, CONFIG_APP_RAW_CAPTURE_TX_COUNT);
+
+static struct k_poll_signal adc_signal = K_POLL_SIGNAL_INITIALIZER(adc_signal);
+
+/* Double buffer, one block is sampled while the other is sent */
+static int16_t scan_buf[2][CAPTURE_SAMPLES_MAX];
+static uint8_t frame_buf[CAPTURE_PAYLOAD_MAX];
+
+static uint32_t channel_mask;
+static uint8_t channel_count;
+static uint16_t full_scale_mv[CAPTURE_MAX_CHANNELS];
+
+PERIPH_USAGE_DEFINE(capture_adc_usage, "capture adc");
+
+static uint8_t frame_seq;
+static uint16_t dropped_scans;
+
+/**
+ * @brief Collect the channel set and its full scale values.
+ *
+ * The SAADC stores the samples of a scan in ascending channel id order, the full scale table
+ * follows the same order.
+ */
+static int capture_channels_setup(void)
+{
+	uint16_t fs_by_id[CAPTURE_CHANNEL_IDS] = {0};
+
+	channel_mask = 0;
+	for (size_t i = 0; i < ARRAY_SIZE(gas_channels); i++) {
+		const struct adc_dt_spec *spec = &gas_channels[i];
+		int32_t fs = BIT(CAPTURE_RESOLUTION);
+		int err = adc_channel_setup_dt(spec);
+
+		if (err < 0) {
+			LOG_ERR("Could not setup channel #%d (%d)", spec->channel_id, err);
+			return err;
+		}
+		adc_raw_to_millivolts_dt(spec, &fs);
+		fs_by_id[spec->channel_id] = fs;
+		channel_mask |= BIT(spec->channel_id);
+	}
+
+	/* Divider channel, configured by battery.c */
+	int32_t fs = BIT(CAPTURE_RESOLUTION);
+
+	adc_raw_to_millivolts(adc_ref_internal(adc_dev), BATTERY_ADC_GAIN, CAPTURE_RESOLUTION, &fs);
+	fs_by_id[BATTERY_ADC_CHANNEL_ID] =
+		fs * (uint64_t)DT_PROP(VBATT, full_ohms) / DT_PROP(VBATT, output_ohms);
+	channel_mask |= BIT(BATTERY_ADC_CHANNEL_ID);
+
+	channel_count = 0;
+	for (int id = 0; id < CAPTURE_CHANNEL_IDS; id++) {
+		if (channel_mask & BIT(id)) {
+			full_scale_mv[channel_count++] = fs_by_id[id];
+		}
+	}
+	return 0;
+}
+
+/* Number of scans that fit one notification, kept to an even sample count for the packing */
+static uint8_t frame_scans(uint16_t payload)
+{
+	size_t samples = (payload - sizeof(struct capture_frame_hdr)) * 2 / 3;
+	size_t scans = MIN(samples, CAPTURE_SAMPLES_MAX) / channel_count;
+
+	if ((scans * channel_count) & 1) {
+		scans--;
+	}
+	return MIN(scans, UINT8_MAX);
+}
+
+static inline uint16_t clamp12(int16_t v)
+{
+	return CLAMP(v, 0, BIT(CAPTURE_RESOLUTION) - 1);
+}
+
+static size_t pack12(uint8_t *dst, const int16_t *src, size_t n)
+{
+	size_t o = 0;
+
+	for (size_t i = 0; i + 1 < n; i += 2) {
+		uint16_t a = clamp12(src[i]);
+		uint16_t b = clamp12(src[i + 1]);
+
+		dst[o++] = a & 0xff;
+		dst[o++] = (a >> 8) | ((b & 0x0f) << 4);
+		dst[o++] = b >> 4;
+	}
+	return o;
+}
+
+static void frame_sent(struct bt_conn *conn, void *user_data)
+{
+	k_sem_give(&capture_tx_sem);
+}
+
+static void send_frame(const int16_t *samples, uint8_t scans, uint32_t timestamp_us,
+		       k_timeout_t wait)
+{
+	struct capture_frame_hdr *hdr = (struct capture_frame_hdr *)frame_buf;
+
+	if (k_sem_take(&capture_tx_sem, wait) != 0) {
+		dropped_scans = MIN(dropped_scans + scans, UINT16_MAX);
+		return;
+	}
+
+	hdr->seq = frame_seq++;
+	hdr->scans = scans;
+	hdr->dropped = sys_cpu_to_le16(dropped_scans);
+	hdr->timestamp_us = sys_cpu_to_le32(timestamp_us);
+
+	size_t len = sizeof(*hdr) + pack12(frame_buf + sizeof(*hdr), samples,
+					   (size_t)scans * channel_count);
+	int err = bt_raw_notify(frame_buf, len, frame_sent);
+
+	if (err) {
+		k_sem_give(&capture_tx_sem);
+		dropped_scans = MIN(dropped_scans + scans, UINT16_MAX);
+	}
+}
+
+static void run_capture(uint32_t rate_hz)
+{
+	struct k_poll_event adc_event =
+		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SIGNAL, K_POLL_MODE_NOTIFY_ONLY, &adc_signal);
+	uint8_t scans = frame_scans(bt_payload_mtu());
+	uint32_t interval_us = USEC_PER_SEC / rate_hz;
+	/* Wait for a BLE buffer at most half a block, the next block is already sampling */
+	k_timeout_t tx_wait = K_USEC((uint64_t)interval_us * scans / 2);
+	struct adc_sequence_options options = {
+		.interval_us = interval_us,
+		.extra_samplings = scans - 1,
+	};
+	struct adc_sequence sequence = {
+		.options = &options,
+		.channels = channel_mask,
+		.buffer_size = (size_t)scans * channel_count * sizeof(int16_t),
+		.resolution = CAPTURE_RESOLUTION,
+	};
+	uint32_t pending_ts = 0;
+	bool pending = false;
+	int cur = 0;
+
+	if (scans == 0) {
+		LOG_WRN("MTU %u too small for capture", bt_payload_mtu());
+		return;
+	}
+
+	LOG_INF("Capture %u Hz, %u channels, %u scans/frame", rate_hz, channel_count, scans);
+	bt_throughput_mode(BT_THROUGHPUT_CAPTURE, true);
+
+	while (atomic_get(&capture_rate) == rate_hz) {
+		uint32_t ts = k_cyc_to_us_floor32(k_cycle_get_32());
+		unsigned int signaled;
+		int result;
+
+		sequence.buffer = scan_buf[cur];
+		k_poll_signal_reset(&adc_signal);
+		adc_event.state = K_POLL_STATE_NOT_READY;
+
+		int err = adc_read_async(adc_dev, &sequence, &adc_signal);
+
+		if (err < 0) {
+			LOG_ERR("ADC read fail (%d)", err);
+			break;
+		}
+
+		if (pending) {
+			send_frame(scan_buf[cur ^ 1], scans, pending_ts, tx_wait);
+		}
+
+		k_poll(&adc_event, 1, K_FOREVER);
+		k_poll_signal_check(&adc_signal, &signaled, &result);
+		if (result < 0) {
+			LOG_ERR("ADC sampling fail (%d)", result);
+			break;
+		}
+
+		pending = true;
+		pending_ts = ts;
+		cur ^= 1;
+	}
+
+	if (pending) {
+		send_frame(scan_buf[cur ^ 1], scans, pending_ts, K_NO_WAIT);
+	}
+
+	bt_throughput_mode(BT_THROUGHPUT_CAPTURE, false);
+	LOG_INF("Capture stopped, %u scans dropped", dropped_scans);
+}
+
+/* Take or release the one hold of the capture on the battery divider */
+static void divider_hold(bool hold)
+{
+	if (atomic_cas(&divider_held, !hold, hold)) {
+		int err = battery_divider_hold(hold);
+
+		if (err < 0) {
+			LOG_WRN("Battery divider %s failed (%d)", hold ? "hold" : "release", err);
+			atomic_set(&divider_held, !hold);
+		}
+	}
+}
+
+int capture_set_rate(uint32_t rate_hz)
+{
+	if (rate_hz != 0 && !subscribed) {
+		return -ENOTCONN;
+	}
+
+	rate_hz = MIN(rate_hz, CONFIG_APP_RAW_CAPTURE_MAX_RATE_HZ);
+	atomic_set(&capture_rate, rate_hz);
+	divider_hold(rate_hz != 0);
+	if (rate_hz != 0) {
+		k_sem_give(&capture_start_sem);
+	}
+	return 0;
+}
+
+void capture_get_info(struct capture_info *info)
+{
+	memset(info, 0, sizeof(*info));
+	info->rate_hz = sys_cpu_to_le16(atomic_get(&capture_rate));
+	info->channels = channel_count;
+	info->resolution = CAPTURE_RESOLUTION;
+	for (int i = 0; i < channel_count; i++) {
+		info->full_scale_mv[i] = sys_cpu_to_le16(full_scale_mv[i]);
+	}
+}
+
+void capture_subscription_changed(bool enabled)
+{
+	subscribed = enabled;
+	if (!enabled) {
+		atomic_set(&capture_rate, 0);
+		divider_hold(false);
+	}
+}
+
+static void capture_thread(void)
+{
+	if (!device_is_ready(adc_dev)) {
+		LOG_ERR("ADC controller device %s not ready", adc_dev->name);
+		return;
+	}
+
+	while (1) {
+		k_sem_take(&capture_start_sem, K_FOREVER);
+
+		uint32_t rate_hz = atomic_get(&capture_rate);
+
+		if (rate_hz == 0) {
+			continue;
+		}
+		if ((channel_count == 0 && capture_channels_setup() < 0) ||
+		    periph_usage_get(&capture_adc_usage, adc_dev) < 0) {
+			atomic_set(&capture_rate, 0);
+			divider_hold(false);
+			continue;
+		}
+		/* Held since capture_set_rate(), the divider output settles */
+		k_msleep(BATTERY_DIVIDER_SETTLE_MS);
+		frame_seq = 0;
+		dropped_scans = 0;
+		run_capture(rate_hz);
+		periph_usage_put(&capture_adc_usage, adc_dev);
+	}
+}
+
+/* Below the measurement threads, the sampling itself is interrupt driven */
+#define STACKSIZE 1024
+#define PRIORITY  10
+K_THREAD_DEFINE(capture_id, STACKSIZE, capture_thread, NULL, NULL, NULL, PRIORITY, 0, 0);
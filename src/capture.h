@@ -0,0 +1,76 @@
+#ifndef __APP_CAPTURE_H__
+#define __APP_CAPTURE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/toolchain.h>
+
+#include "gas.h"
+
+/**
+ * @file src/capture.h
+ *
+ * @brief Raw SAADC capture streamed over BLE for building replay data sets.
+ *
+ * Frame layout of the FFF3 notifications (little endian):
+ *
+ *   u8  seq           frame counter, wraps
+ *   u8  scans         number of scans in this frame
+ *   u16 dropped       scans dropped so far for lack of BLE buffers, saturating
+ *   u32 timestamp_us  uptime of the first scan, wraps
+ *   ... scans * channels samples, 12 bit, two samples packed in three bytes
+ *       (s0[7:0], s0[11:8] | s1[3:0] << 4, s1[11:4])
+ *
+ * Reading the characteristic returns struct capture_info.
+ */
+
+/** Maximum number of captured channels, the gas cells and the battery divider. */
+#define CAPTURE_MAX_CHANNELS (GAS_CHANNEL_COUNT + 1)
+
+/** Header of every capture notification. */
+struct capture_frame_hdr {
+	uint8_t seq;
+	uint8_t scans;
+	uint16_t dropped;
+	uint32_t timestamp_us;
+} __packed;
+
+/** Stream description, returned on a read of the capture characteristic. */
+struct capture_info {
+	/** Scan rate in Hz, 0 while stopped. */
+	uint16_t rate_hz;
+	/** Number of channels in each scan. */
+	uint8_t channels;
+	/** Sample resolution in bits. */
+	uint8_t resolution;
+	/** Input voltage at full scale per channel, mV, divider included. */
+	uint16_t full_scale_mv[CAPTURE_MAX_CHANNELS];
+} __packed;
+
+/**
+ * @brief Start or stop the raw capture.
+ *
+ * @param rate_hz Scan rate, 0 stops the capture. Clamped to CONFIG_APP_RAW_CAPTURE_MAX_RATE_HZ.
+ *
+ * @return 0 on success, -ENOTCONN if no client subscribed to the capture characteristic.
+ */
+int capture_set_rate(uint32_t rate_hz);
+
+/**
+ * @brief Fill in the stream description.
+ *
+ * @param info Destination.
+ */
+void capture_get_info(struct capture_info *info);
+
+/**
+ * @brief Notify the capture about the client subscription state.
+ *
+ * Unsubscribing stops a running capture.
+ *
+ * @param enabled True when notifications on the capture characteristic are enabled.
+ */
+void capture_subscription_changed(bool enabled);
+
+#endif // __APP_CAPTURE_H__
@@ -0,0 +1,160 @@
+/**
+ * @file src/data_log.c - readings kept in a flash ring
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <zephyr/fs/fcb.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+
+#include "data_log.h"
+
+LOG_MODULE_REGISTER(DATA_LOG, CONFIG_APP_LOG_LEVEL);
+
+BUILD_ASSERT(FIXED_PARTITION_EXISTS(log_partition), "No log_partition in the devicetree");
+
+#define DATA_LOG_AREA_ID FIXED_PARTITION_ID(log_partition)
+
+/* "GLOG", and the record layout */
+#define DATA_LOG_MAGIC   0x474c4f47U
+#define DATA_LOG_VERSION 1
+
+#define DATA_LOG_MAX_SECTORS 8
+
+static struct flash_sector sectors[DATA_LOG_MAX_SECTORS];
+
+static struct fcb fcb = {
+	.f_magic = DATA_LOG_MAGIC,
+	.f_version = DATA_LOG_VERSION,
+	.f_sectors = sectors,
+};
+
+static uint16_t boot;
+static bool ready;
+
+struct walk_ctx {
+	data_log_walk_cb cb;
+	void *arg;
+};
+
+static int walk_entry(struct fcb_entry_ctx *loc_ctx, void *arg)
+{
+	const struct walk_ctx *ctx = arg;
+	struct data_log_record rec;
+
+	/* Left by another layout of the same version, skipped */
+	if (loc_ctx->loc.fe_data_len != sizeof(rec)) {
+		return 0;
+	}
+
+	int rc = flash_area_read(loc_ctx->fap, FCB_ENTRY_FA_DATA_OFF(loc_ctx->loc), &rec,
+				 sizeof(rec));
+	if (rc < 0) {
+		return rc;
+	}
+	return ctx->cb(&rec, ctx->arg);
+}
+
+int data_log_walk(data_log_walk_cb cb, void *arg)
+{
+	struct walk_ctx ctx = {cb, arg};
+
+	if (!ready) {
+		return -ENODEV;
+	}
+	return fcb_walk(&fcb, NULL, walk_entry, &ctx);
+}
+
+int data_log_append(const struct data_log_record *rec)
+{
+	struct fcb_entry loc;
+	int rc;
+
+	if (!ready) {
+		return -ENODEV;
+	}
+
+	rc = fcb_append(&fcb, sizeof(*rec), &loc);
+	if (rc == -ENOSPC) {
+		/* Full, drop the oldest sector */
+		rc = fcb_rotate(&fcb);
+		if (rc == 0) {
+			rc = fcb_append(&fcb, sizeof(*rec), &loc);
+		}
+	}
+	if (rc < 0) {
+		return rc;
+	}
+
+	rc = flash_area_write(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), rec, sizeof(*rec));
+	if (rc < 0) {
+		return rc;
+	}
+	return fcb_append_finish(&fcb, &loc);
+}
+
+uint16_t data_log_boot(void)
+{
+	return boot;
+}
+
+static int highest_boot(const struct data_log_record *rec, void *arg)
+{
+	uint16_t *highest = arg;
+
+	if (rec->boot > *highest) {
+		*highest = rec->boot;
+	}
+	return 0;
+}
+
+/* Erase a partition that holds no log of this layout */
+static int erase_area(void)
+{
+	const struct flash_area *fa;
+	int rc = flash_area_open(DATA_LOG_AREA_ID, &fa);
+
+	if (rc < 0) {
+		return rc;
+	}
+	rc = flash_area_erase(fa, 0, fa->fa_size);
+	flash_area_close(fa);
+	return rc;
+}
+
+static int data_log_init(void)
+{
+	uint32_t count = ARRAY_SIZE(sectors);
+	int rc = flash_area_get_sectors(DATA_LOG_AREA_ID, &count, sectors);
+
+	if (rc < 0) {
+		LOG_ERR("log partition sectors (%d)", rc);
+		return rc;
+	}
+	fcb.f_sector_cnt = count;
+
+	rc = fcb_init(DATA_LOG_AREA_ID, &fcb);
+	if (rc < 0) {
+		LOG_WRN("log unreadable (%d), erased", rc);
+		rc = erase_area();
+		if (rc == 0) {
+			rc = fcb_init(DATA_LOG_AREA_ID, &fcb);
+		}
+		if (rc < 0) {
+			LOG_ERR("log init (%d)", rc);
+			return rc;
+		}
+	}
+	ready = true;
+
+	uint16_t highest = 0;
+
+	data_log_walk(highest_boot, &highest);
+	boot = highest + 1;
+	LOG_INF("data log boot %u", boot);
+	return 0;
+}
+
+SYS_INIT(data_log_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,69 @@
+/**
+ * @file src/data_log.h - readings kept in a flash ring
+ *
+ * @brief Fixed size records appended to the log_partition through a flash circular buffer (FCB).
+ *
+ * When the partition is full the oldest sector is erased, so the log holds the most recent
+ * records. The board has no wall clock: each boot gets a number one above the highest in the
+ * log, and a record carries it with the uptime.
+ */
+#ifndef __APP_DATA_LOG_H__
+#define __APP_DATA_LOG_H__
+
+#include <stdint.h>
+
+#include <zephyr/toolchain.h>
+
+#include "gas.h"
+
+/* No BME680 temperature in the record */
+#define DATA_LOG_TEMP_NONE INT16_MIN
+
+/** One logged reading. Changing it needs a new DATA_LOG_VERSION in data_log.c. */
+struct data_log_record {
+	/** Boot number, see data_log_boot(). */
+	uint16_t boot;
+	/** Battery state of charge, pptt. */
+	uint16_t battery_pptt;
+	/** Uptime of the reading, s. */
+	uint32_t uptime_s;
+	/** Level per gas channel in devicetree order, 0.1 % O2 or 0.1 ppm. */
+	int16_t level[GAS_CHANNEL_COUNT];
+	/** BME680 temperature in 0.01 °C, or DATA_LOG_TEMP_NONE. */
+	int16_t temp_centi_c;
+	/** Fault bitmask per gas channel, enum gas_diag_fault. */
+	uint8_t faults[GAS_CHANNEL_COUNT];
+} __packed;
+
+/**
+ * @brief Called for each record by data_log_walk(), oldest first.
+ *
+ * @return 0 to continue, anything else stops the walk and is returned by it.
+ */
+typedef int (*data_log_walk_cb)(const struct data_log_record *rec, void *arg);
+
+/**
+ * @brief Append a record, erasing the oldest sector when the log is full.
+ *
+ * Blocks for the flash write, and for a sector erase about every 170 records.
+ *
+ * @param rec Record.
+ * @return 0 on success, -ENODEV if the log did not start, or a flash error.
+ */
+int data_log_append(const struct data_log_record *rec);
+
+/**
+ * @brief Read the records, oldest first.
+ *
+ * @param cb Called for each record.
+ * @param arg Passed to @p cb.
+ * @return 0 after the last record, the value of @p cb that stopped the walk, or a flash error.
+ */
+int data_log_walk(data_log_walk_cb cb, void *arg);
+
+/**
+ * @brief Number of this boot, for the records.
+ */
+uint16_t data_log_boot(void);
+
+#endif // __APP_DATA_LOG_H__
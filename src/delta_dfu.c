@@ -0,0 +1,517 @@
+/**
+ * @file src/delta_dfu.c - delta patch applied into slot 1
+ *
+ * @brief Patch bytes written to the FFF5 characteristic go through a pipe to a work item on
+ * app_work_q, which parses them, reads the old image from slot 0 and writes the new one to slot 1
+ * through stream_flash, erasing each page as the image reaches it. A run of the work item checks
+ * or produces at most CONFIG_APP_DELTA_DFU_STEP bytes and submits itself again, so the other items
+ * of the queue keep their period during an update.
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/dfu/mcuboot.h>
+#include <zephyr/drivers/flash.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/storage/stream_flash.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+
+#include "app_work.h"
+#include "bluetooth.h"
+#include "delta_dfu.h"
+#include "dfu.h"
+
+LOG_MODULE_REGISTER(DELTA_DFU, CONFIG_APP_LOG_LEVEL);
+
+#define SOURCE_AREA_ID FIXED_PARTITION_ID(slot0_partition)
+#define TARGET_AREA_ID FIXED_PARTITION_ID(slot1_partition)
+
+/* A restart waits at most this long for the running step */
+#define RESTART_WAIT_MS 200
+
+/* Write block of stream_flash, a multiple of the flash write size */
+#define STREAM_BUF_SIZE 256
+
+enum patch_step {
+	STEP_HEADER,
+	/* CRC of the old image in slot 0 */
+	STEP_SOURCE_CHECK,
+	STEP_OP,
+	STEP_LEN,
+	STEP_SEEK,
+	STEP_TOKEN,
+	/* Source bytes copied as they are, no patch bytes */
+	STEP_COPY,
+	STEP_DIFF,
+	STEP_INSERT,
+	STEP_END,
+};
+
+K_PIPE_DEFINE(patch_pipe, CONFIG_APP_DELTA_DFU_RX_BUF_SIZE, 4);
+static K_MUTEX_DEFINE(patch_lock);
+
+/* The fields are used by the work item under patch_lock, except state and received */
+static struct {
+	/* enum delta_dfu_state, read by the BT RX thread without the lock */
+	atomic_t state;
+	int err;
+	/* Written by the BT RX thread only */
+	atomic_t received;
+	int64_t start_ms;
+	enum patch_step step;
+	struct delta_patch_hdr hdr;
+	size_t hdr_len;
+	uint8_t op;
+	uint32_t varint;
+	uint8_t varint_shift;
+	/* Target bytes left in the operation and in the token */
+	uint32_t op_left;
+	uint32_t run_left;
+	uint32_t src_pos;
+	uint32_t crc;
+	uint32_t written;
+} ctx;
+
+static const struct flash_area *source_fa;
+static const struct flash_area *target_fa;
+/* Start of the last page of slot 1, which holds the MCUboot trailer */
+static uint32_t trailer_off;
+static struct stream_flash_ctx stream;
+static uint8_t stream_buf[STREAM_BUF_SIZE];
+
+/* Work item only: patch bytes not parsed yet, new image bytes not written yet, source window */
+static uint8_t chunk[64];
+static size_t chunk_len;
+static size_t chunk_pos;
+static uint8_t out[64];
+static size_t out_len;
+static uint8_t src_cache[64];
+static uint32_t src_cache_off;
+static bool src_cache_valid;
+
+static uint32_t produced(void)
+{
+	return ctx.written + out_len;
+}
+
+static void step_to(enum patch_step step)
+{
+	ctx.step = step;
+	ctx.varint = 0;
+	ctx.varint_shift = 0;
+}
+
+/* True once the last byte of the varint is fed */
+static bool varint_feed(uint8_t b, int *err)
+{
+	if (ctx.varint_shift > 28) {
+		*err = -EBADMSG;
+		return false;
+	}
+	ctx.varint |= (uint32_t)(b & 0x7f) << ctx.varint_shift;
+	ctx.varint_shift += 7;
+	*err = 0;
+	return (b & 0x80) == 0;
+}
+
+static int source_byte(uint8_t *b)
+{
+	uint32_t pos = ctx.src_pos;
+
+	if (pos >= ctx.hdr.source_size) {
+		return -EBADMSG;
+	}
+	if (!src_cache_valid || pos < src_cache_off || pos - src_cache_off >= sizeof(src_cache)) {
+		uint32_t off = ROUND_DOWN(pos, sizeof(src_cache));
+		uint32_t len = MIN(sizeof(src_cache), ctx.hdr.source_size - off);
+
+		if (flash_area_read(source_fa, off, src_cache, len) != 0) {
+			return -EIO;
+		}
+		src_cache_off = off;
+		src_cache_valid = true;
+	}
+	*b = src_cache[pos - src_cache_off];
+	ctx.src_pos++;
+	return 0;
+}
+
+static int out_flush(bool finish)
+{
+	ctx.crc = crc32_ieee_update(ctx.crc, out, out_len);
+	if (stream_flash_buffered_write(&stream, out, out_len, finish) != 0) {
+		return -EIO;
+	}
+	ctx.written += out_len;
+	out_len = 0;
+	return 0;
+}
+
+static int out_put(uint8_t b)
+{
+	out[out_len++] = b;
+	return out_len == sizeof(out) ? out_flush(false) : 0;
+}
+
+static int header_check(void)
+{
+	struct delta_patch_hdr *hdr = &ctx.hdr;
+
+	hdr->magic = sys_le32_to_cpu(hdr->magic);
+	hdr->source_size = sys_le32_to_cpu(hdr->source_size);
+	hdr->source_crc = sys_le32_to_cpu(hdr->source_crc);
+	hdr->target_size = sys_le32_to_cpu(hdr->target_size);
+	hdr->target_crc = sys_le32_to_cpu(hdr->target_crc);
+
+	if (hdr->magic != DELTA_PATCH_MAGIC) {
+		return -EBADMSG;
+	}
+	if (hdr->source_size > source_fa->fa_size || hdr->target_size == 0 ||
+	    hdr->target_size > trailer_off) {
+		return -EFBIG;
+	}
+	LOG_INF("patch %u -> %u bytes", hdr->source_size, hdr->target_size);
+	ctx.crc = 0;
+	ctx.src_pos = 0;
+	step_to(STEP_SOURCE_CHECK);
+	return 0;
+}
+
+static int source_check(size_t *budget)
+{
+	uint32_t n = MIN(ctx.hdr.source_size - ctx.src_pos, *budget);
+
+	for (uint32_t done = 0; done < n;) {
+		uint32_t len = MIN(n - done, sizeof(src_cache));
+
+		if (flash_area_read(source_fa, ctx.src_pos, src_cache, len) != 0) {
+			return -EIO;
+		}
+		ctx.crc = crc32_ieee_update(ctx.crc, src_cache, len);
+		ctx.src_pos += len;
+		done += len;
+	}
+	*budget -= n;
+	if (ctx.src_pos < ctx.hdr.source_size) {
+		return 0;
+	}
+
+	if (ctx.crc != ctx.hdr.source_crc) {
+		LOG_ERR("patch is not for the running image");
+		return -EILSEQ;
+	}
+	ctx.crc = 0;
+	ctx.src_pos = 0;
+	src_cache_valid = false;
+	step_to(STEP_OP);
+	return 0;
+}
+
+static int patch_finish(void)
+{
+	int err = out_flush(true);
+
+	if (err < 0) {
+		return err;
+	}
+	if (ctx.crc != ctx.hdr.target_crc) {
+		LOG_ERR("new image CRC mismatch");
+		return -EILSEQ;
+	}
+
+	/* Stale trailer of an earlier upload, boot_request_upgrade() writes the magic there */
+	err = flash_area_erase(target_fa, trailer_off, target_fa->fa_size - trailer_off);
+	if (err == 0) {
+		err = boot_request_upgrade(BOOT_UPGRADE_TEST);
+	}
+	if (err != 0) {
+		return -EIO;
+	}
+
+	step_to(STEP_END);
+	atomic_set(&ctx.state, DELTA_DFU_PENDING);
+	dfu_slot_release(DFU_SLOT_DELTA);
+	LOG_INF("%u byte image from %u patch bytes in %u ms, pending", ctx.written,
+		(uint32_t)atomic_get(&ctx.received), (uint32_t)(k_uptime_get() - ctx.start_ms));
+	bt_throughput_mode(BT_THROUGHPUT_DELTA, false);
+	return 0;
+}
+
+/* n target bytes of the current token done */
+static int consumed(uint32_t n)
+{
+	ctx.run_left -= n;
+	ctx.op_left -= n;
+	if (ctx.run_left > 0) {
+		return 0;
+	}
+	if (ctx.op_left > 0) {
+		step_to(STEP_TOKEN);
+		return 0;
+	}
+	if (produced() == ctx.hdr.target_size) {
+		return patch_finish();
+	}
+	step_to(STEP_OP);
+	return 0;
+}
+
+static int copy_run(size_t *budget)
+{
+	uint32_t n = MIN(ctx.run_left, *budget);
+
+	for (uint32_t i = 0; i < n; i++) {
+		uint8_t b;
+		int err = source_byte(&b);
+
+		if (err == 0) {
+			err = out_put(b);
+		}
+		if (err < 0) {
+			return err;
+		}
+	}
+	*budget -= n;
+	return consumed(n);
+}
+
+static int patch_feed(uint8_t b)
+{
+	uint8_t src;
+	int err;
+
+	switch (ctx.step) {
+	case STEP_HEADER:
+		((uint8_t *)&ctx.hdr)[ctx.hdr_len++] = b;
+		return ctx.hdr_len == sizeof(ctx.hdr) ? header_check() : 0;
+	case STEP_OP:
+		if (b != DELTA_OP_ADD && b != DELTA_OP_INSERT) {
+			return -EBADMSG;
+		}
+		ctx.op = b;
+		step_to(STEP_LEN);
+		return 0;
+	case STEP_LEN:
+		if (!varint_feed(b, &err)) {
+			return err;
+		}
+		if (ctx.varint == 0 || ctx.varint > ctx.hdr.target_size - produced()) {
+			return -EBADMSG;
+		}
+		ctx.op_left = ctx.varint;
+		if (ctx.op == DELTA_OP_INSERT) {
+			ctx.run_left = ctx.op_left;
+			step_to(STEP_INSERT);
+		} else {
+			step_to(STEP_SEEK);
+		}
+		return 0;
+	case STEP_SEEK:
+		if (!varint_feed(b, &err)) {
+			return err;
+		}
+		/* Zigzag, wraps like the signed addition; a seek before 0 wraps past source_size */
+		ctx.src_pos += (ctx.varint >> 1) ^ -(ctx.varint & 1);
+		if (ctx.src_pos >= ctx.hdr.source_size) {
+			return -EBADMSG;
+		}
+		step_to(STEP_TOKEN);
+		return 0;
+	case STEP_TOKEN:
+		if (!varint_feed(b, &err)) {
+			return err;
+		}
+		ctx.run_left = ctx.varint >> 1;
+		if (ctx.run_left == 0 || ctx.run_left > ctx.op_left) {
+			return -EBADMSG;
+		}
+		ctx.step = (ctx.varint & 1) ? STEP_DIFF : STEP_COPY;
+		return 0;
+	case STEP_DIFF:
+		err = source_byte(&src);
+		if (err == 0) {
+			err = out_put(src + b);
+		}
+		return err < 0 ? err : consumed(1);
+	case STEP_INSERT:
+		err = out_put(b);
+		return err < 0 ? err : consumed(1);
+	default:
+		/* Bytes after the last operation */
+		return -EBADMSG;
+	}
+}
+
+static void patch_fail(int err)
+{
+	LOG_ERR("patch failed at %u of %u bytes (%d)", ctx.written, ctx.hdr.target_size, err);
+	ctx.err = err;
+	atomic_set(&ctx.state, DELTA_DFU_FAILED);
+	dfu_slot_release(DFU_SLOT_DELTA);
+	bt_throughput_mode(BT_THROUGHPUT_DELTA, false);
+}
+
+static void patch_work_fn(struct k_work *work);
+static K_WORK_DEFINE(patch_work, patch_work_fn);
+
+static void patch_work_fn(struct k_work *work)
+{
+	size_t budget = CONFIG_APP_DELTA_DFU_STEP;
+	bool more;
+	int err = 0;
+
+	k_mutex_lock(&patch_lock, K_FOREVER);
+	while (atomic_get(&ctx.state) == DELTA_DFU_RECEIVING && budget > 0 && err == 0) {
+		if (ctx.step == STEP_SOURCE_CHECK) {
+			err = source_check(&budget);
+		} else if (ctx.step == STEP_COPY) {
+			err = copy_run(&budget);
+		} else {
+			if (chunk_pos == chunk_len) {
+				chunk_pos = 0;
+				chunk_len = 0;
+				(void)k_pipe_get(&patch_pipe, chunk, sizeof(chunk), &chunk_len, 1,
+						 K_NO_WAIT);
+				if (chunk_len == 0) {
+					break;
+				}
+			}
+			err = patch_feed(chunk[chunk_pos++]);
+			budget--;
+		}
+	}
+	if (err < 0) {
+		patch_fail(err);
+	}
+	more = atomic_get(&ctx.state) == DELTA_DFU_RECEIVING && budget == 0;
+	k_mutex_unlock(&patch_lock);
+
+	if (more) {
+		k_work_submit_to_queue(&app_work_q, work);
+	}
+}
+
+/*
+ * Slot 1 holds the image MCUboot reverts to while the running one is in test, or an image that
+ * is swapped in on the next reset
+ */
+static bool slot1_in_use(void)
+{
+	int swap = mcuboot_swap_type();
+
+	return !boot_is_img_confirmed() || swap == BOOT_SWAP_TYPE_TEST ||
+	       swap == BOOT_SWAP_TYPE_PERM;
+}
+
+static int patch_restart(void)
+{
+	k_pipe_flush(&patch_pipe);
+	chunk_len = 0;
+	chunk_pos = 0;
+	out_len = 0;
+	src_cache_valid = false;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.start_ms = k_uptime_get();
+
+	int err = stream_flash_init(&stream, flash_area_get_device(target_fa), stream_buf,
+				    sizeof(stream_buf), target_fa->fa_off, target_fa->fa_size,
+				    NULL);
+	if (err < 0) {
+		patch_fail(err);
+		return err;
+	}
+	step_to(STEP_HEADER);
+	atomic_set(&ctx.state, DELTA_DFU_RECEIVING);
+	return 0;
+}
+
+int delta_dfu_write(const uint8_t *data, uint16_t len)
+{
+	uint32_t offset;
+	size_t put;
+
+	if (len < sizeof(offset)) {
+		return -EINVAL;
+	}
+	offset = sys_get_le32(data);
+	data += sizeof(offset);
+	len -= sizeof(offset);
+
+	if (offset == 0) {
+		if (slot1_in_use()) {
+			LOG_WRN("patch refused, slot 1 holds the revert or a pending image");
+			return -EBUSY;
+		}
+		if (k_mutex_lock(&patch_lock, K_MSEC(RESTART_WAIT_MS)) != 0) {
+			return -EBUSY;
+		}
+		if (!dfu_slot_claim(DFU_SLOT_DELTA)) {
+			k_mutex_unlock(&patch_lock);
+			LOG_WRN("patch refused, SMP upload in progress");
+			return -EBUSY;
+		}
+		int err = patch_restart();
+
+		k_mutex_unlock(&patch_lock);
+		if (err < 0) {
+			return -EIO;
+		}
+		bt_throughput_mode(BT_THROUGHPUT_DELTA, true);
+		LOG_INF("patch started");
+	} else if (atomic_get(&ctx.state) != DELTA_DFU_RECEIVING) {
+		return -EPERM;
+	} else if (offset != (uint32_t)atomic_get(&ctx.received)) {
+		return -EINVAL;
+	}
+
+	if (len == 0) {
+		return 0;
+	}
+	/* All or nothing, the client writes the same offset again */
+	if (k_pipe_put(&patch_pipe, (void *)data, len, &put, len, K_NO_WAIT) != 0) {
+		return -ENOMEM;
+	}
+	atomic_add(&ctx.received, len);
+	k_work_submit_to_queue(&app_work_q, &patch_work);
+	return 0;
+}
+
+void delta_dfu_get_status(struct delta_dfu_status *status)
+{
+	*status = (struct delta_dfu_status){
+		.state = atomic_get(&ctx.state),
+		.err = sys_cpu_to_le32(ctx.err),
+		.received = sys_cpu_to_le32(atomic_get(&ctx.received)),
+		.written = sys_cpu_to_le32(ctx.written),
+	};
+}
+
+static int delta_dfu_init(void)
+{
+	struct flash_pages_info info;
+	int err = flash_area_open(SOURCE_AREA_ID, &source_fa);
+
+	if (err == 0) {
+		err = flash_area_open(TARGET_AREA_ID, &target_fa);
+	}
+	if (err == 0) {
+		uint32_t last = target_fa->fa_off + target_fa->fa_size - 1;
+
+		err = flash_get_page_info_by_offs(flash_area_get_device(target_fa), last, &info);
+	}
+	if (err < 0) {
+		LOG_ERR("image slots not available (%d)", err);
+		return err;
+	}
+	trailer_off = info.start_offset - target_fa->fa_off;
+	return 0;
+}
+
+SYS_INIT(delta_dfu_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,95 @@
+#ifndef __APP_DELTA_DFU_H__
+#define __APP_DELTA_DFU_H__
+
+#include <stdint.h>
+
+#include <zephyr/toolchain.h>
+
+/**
+ * @file src/delta_dfu.h
+ *
+ * @brief Firmware update from a delta patch against the running image, CONFIG_APP_DELTA_DFU.
+ *
+ * The patch is built by tools/delta_dfu/delta_patch.py from the app_update.bin of the running
+ * release and the one of the new release. The unit reads the old image from slot 0, applies the
+ * patch into slot 1 through stream_flash and marks the result for test; MCUboot checks its
+ * signature on the next reset like an image uploaded over SMP.
+ *
+ * Patch layout (little endian): struct delta_patch_hdr, then operations until target_size bytes
+ * are produced. Numbers are LEB128 varints, seeks are zigzag coded.
+ *
+ *   0x01 ADD     len, seek, tokens: the source pointer moves by seek, then len bytes are taken
+ *                from the source. A token with bit 0 clear copies token >> 1 source bytes as
+ *                they are, with bit 0 set it is followed by token >> 1 bytes added to the source
+ *                bytes modulo 256.
+ *   0x02 INSERT  len, len bytes copied to the target as they are.
+ *
+ * Every write to the FFF5 characteristic is a u32 patch offset followed by patch bytes. Offset 0
+ * starts a new update, any other offset must equal delta_dfu_status.received, which a read of the
+ * characteristic returns: a client resumes an interrupted transfer from there as long as the unit
+ * did not reset. An SMP upload and a patch both write slot 1 and exclude each other (src/dfu.h):
+ * offset 0 is refused while an upload runs, upload chunks while a patch is received.
+ */
+
+/** "HDP1" */
+#define DELTA_PATCH_MAGIC 0x31504448U
+
+#define DELTA_OP_ADD    0x01
+#define DELTA_OP_INSERT 0x02
+
+/** Header at the start of a patch. */
+struct delta_patch_hdr {
+	uint32_t magic;
+	/** Size of the image the patch applies to. */
+	uint32_t source_size;
+	/** CRC-32 (IEEE) of that image, checked against slot 0 before anything is written. */
+	uint32_t source_crc;
+	/** Size of the new image. */
+	uint32_t target_size;
+	/** CRC-32 (IEEE) of the new image, checked before it is marked for test. */
+	uint32_t target_crc;
+} __packed;
+
+enum delta_dfu_state {
+	DELTA_DFU_IDLE,
+	DELTA_DFU_RECEIVING,
+	/** Applied and marked for test, swapped on the next reset. */
+	DELTA_DFU_PENDING,
+	DELTA_DFU_FAILED,
+};
+
+/** Returned on a read of the patch characteristic. */
+struct delta_dfu_status {
+	/** enum delta_dfu_state */
+	uint8_t state;
+	uint8_t reserved[3];
+	/** Negative error code of a failed update. */
+	int32_t err;
+	/** Patch bytes accepted, the offset of the next write. */
+	uint32_t received;
+	/** New image bytes written to slot 1. */
+	uint32_t written;
+} __packed;
+
+/**
+ * @brief Take a write of the patch characteristic.
+ *
+ * @param data u32 patch offset followed by patch bytes.
+ * @param len Length of @p data.
+ *
+ * @return 0 on success, -EINVAL on a short write or an offset other than the expected one,
+ *         -ENOMEM while the receive buffer is full (write again), -EBUSY while a restart waits
+ *         for a flash operation, while an SMP upload holds slot 1, while the running image
+ *         is not confirmed yet (slot 1 is its revert image) or while an image in slot 1 is
+ *         pending, -EPERM after a failed or finished update until offset 0.
+ */
+int delta_dfu_write(const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Fill in the update state.
+ *
+ * @param status Destination.
+ */
+void delta_dfu_get_status(struct delta_dfu_status *status);
+
+#endif // __APP_DELTA_DFU_H__
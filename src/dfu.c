@@ -0,0 +1,135 @@
+/**
+ * @file src/dfu.c - firmware update over BLE
+ *
+ * @brief MCUboot and the SMP image group over BLE, CONFIG_APP_DFU.
+ *
+ * An upload switches the link to throughput mode (2M PHY, 7.5 ~ 15 ms interval) and back once it
+ * stops or the image is marked for test. Slot 1 is erased page by page as the upload goes, so no
+ * request waits for a whole slot erase, and the SMP work queue runs below the measurement threads,
+ * which keep their period during a transfer. The upload state stays in RAM until the next reset:
+ * after a dropped link the client resumes at the offset the image group reports.
+ *
+ * Chunks of an upload are refused with MGMT_ERR_EBUSY while a delta patch holds slot 1, see
+ * src/dfu.h.
+ *
+ * A new image is confirmed once it ran CONFIG_APP_DFU_CONFIRM_SEC. If it hangs before, the
+ * supervisor watchdog resets it and MCUboot reverts to the previous image.
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <zephyr/dfu/mcuboot.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/mgmt/mcumgr/grp/img_mgmt/img_mgmt.h>
+#include <zephyr/mgmt/mcumgr/grp/img_mgmt/img_mgmt_callbacks.h>
+#include <zephyr/mgmt/mcumgr/mgmt/callbacks.h>
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt_defines.h>
+#include <zephyr/sys/atomic.h>
+
+#include "app_work.h"
+#include "bluetooth.h"
+#include "dfu.h"
+
+LOG_MODULE_REGISTER(DFU, CONFIG_APP_LOG_LEVEL);
+
+/* Uptime at the start of the upload, 0 while none runs */
+static int64_t upload_start_ms;
+
+/* enum dfu_slot_user */
+static atomic_t slot_user = ATOMIC_INIT(DFU_SLOT_FREE);
+
+bool dfu_slot_claim(enum dfu_slot_user user)
+{
+	return atomic_cas(&slot_user, DFU_SLOT_FREE, user) || atomic_get(&slot_user) == user;
+}
+
+void dfu_slot_release(enum dfu_slot_user user)
+{
+	(void)atomic_cas(&slot_user, user, DFU_SLOT_FREE);
+}
+
+/* The first chunk claims slot 1, the others only fail while a patch took it since */
+static bool upload_chunk_allowed(const struct img_mgmt_upload_check *check)
+{
+	if (check->req->off == 0) {
+		return dfu_slot_claim(DFU_SLOT_SMP);
+	}
+	return atomic_get(&slot_user) != DFU_SLOT_DELTA;
+}
+
+static enum mgmt_cb_return dfu_event(uint32_t event, enum mgmt_cb_return prev_status, int32_t *rc,
+				     uint16_t *group, bool *abort_more, void *data,
+				     size_t data_size)
+{
+	ARG_UNUSED(prev_status);
+	ARG_UNUSED(group);
+	ARG_UNUSED(abort_more);
+	ARG_UNUSED(data_size);
+
+	switch (event) {
+	case MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK:
+		if (!upload_chunk_allowed(data)) {
+			LOG_WRN("upload refused, delta patch in progress");
+			*rc = MGMT_ERR_EBUSY;
+			return MGMT_CB_ERROR_RC;
+		}
+		break;
+	case MGMT_EVT_OP_IMG_MGMT_DFU_STARTED:
+		upload_start_ms = k_uptime_get();
+		bt_throughput_mode(BT_THROUGHPUT_SMP, true);
+		LOG_INF("upload started");
+		break;
+	case MGMT_EVT_OP_IMG_MGMT_DFU_PENDING:
+		LOG_INF("upload done in %u ms, image pending",
+			(uint32_t)(k_uptime_get() - upload_start_ms));
+		upload_start_ms = 0;
+		dfu_slot_release(DFU_SLOT_SMP);
+		bt_throughput_mode(BT_THROUGHPUT_SMP, false);
+		break;
+	case MGMT_EVT_OP_IMG_MGMT_DFU_STOPPED:
+		LOG_WRN("upload stopped");
+		upload_start_ms = 0;
+		dfu_slot_release(DFU_SLOT_SMP);
+		bt_throughput_mode(BT_THROUGHPUT_SMP, false);
+		break;
+	default:
+		break;
+	}
+	return MGMT_CB_OK;
+}
+
+static struct mgmt_callback dfu_callback = {
+	.callback = dfu_event,
+	.event_id = MGMT_EVT_OP_IMG_MGMT_DFU_CHUNK | MGMT_EVT_OP_IMG_MGMT_DFU_STARTED |
+		    MGMT_EVT_OP_IMG_MGMT_DFU_PENDING | MGMT_EVT_OP_IMG_MGMT_DFU_STOPPED,
+};
+
+static void confirm_work_fn(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	int err = boot_write_img_confirmed();
+
+	if (err < 0) {
+		LOG_ERR("image confirm failed (%d)", err);
+		return;
+	}
+	LOG_INF("image confirmed");
+}
+
+static K_WORK_DELAYABLE_DEFINE(confirm_work, confirm_work_fn);
+
+static int dfu_init(void)
+{
+	mgmt_callback_register(&dfu_callback);
+
+	if (!boot_is_img_confirmed()) {
+		LOG_WRN("image in test, confirmed in %u s", CONFIG_APP_DFU_CONFIRM_SEC);
+		k_work_schedule_for_queue(&app_work_q, &confirm_work,
+					  K_SECONDS(CONFIG_APP_DFU_CONFIRM_SEC));
+	}
+	return 0;
+}
+
+SYS_INIT(dfu_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
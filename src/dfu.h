@@ -0,0 +1,39 @@
+/**
+ * @file src/dfu.h - firmware update over BLE
+ *
+ * @brief Slot 1 is written either by an SMP upload or by a delta patch (src/delta_dfu.c), never
+ * by both at once: the writer claims the slot before its first write and releases it once its
+ * image is pending or it failed.
+ */
+#ifndef __APP_DFU_H__
+#define __APP_DFU_H__
+
+#include <stdbool.h>
+
+enum dfu_slot_user {
+	DFU_SLOT_FREE,
+	/**
+	 * img_mgmt upload, from the first chunk until the image is pending or the upload stops. An
+	 * abandoned upload keeps it until the next reset, like img_mgmt keeps its offset.
+	 */
+	DFU_SLOT_SMP,
+	/** Delta patch, while it is received. */
+	DFU_SLOT_DELTA,
+};
+
+/**
+ * @brief Claim slot 1.
+ *
+ * @param user Writer, DFU_SLOT_SMP or DFU_SLOT_DELTA.
+ * @return True if the slot was free or already held by @p user.
+ */
+bool dfu_slot_claim(enum dfu_slot_user user);
+
+/**
+ * @brief Release slot 1, nothing happens unless @p user holds it.
+ *
+ * @param user Writer, DFU_SLOT_SMP or DFU_SLOT_DELTA.
+ */
+void dfu_slot_release(enum dfu_slot_user user);
+
+#endif // __APP_DFU_H__
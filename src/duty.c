@@ -0,0 +1,96 @@
+/**
+ * @file src/duty.c - scheduled measurement bursts for storage and standby
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "battery.h"
+#include "bluetooth.h"
+#include "bme680_app.h"
+#include "data_log.h"
+#include "duty.h"
+#include "gas.h"
+#include "led.h"
+#include "supervisor.h"
+
+LOG_MODULE_REGISTER(DUTY, CONFIG_APP_LOG_LEVEL);
+
+#define DUTY_PERIOD_MS (CONFIG_APP_DUTY_PERIOD_SEC * MSEC_PER_SEC)
+
+/* BSEC heartbeat window in ultra low power mode, three samples */
+#define BSEC_ULP_WINDOW_MS 900000
+
+static void duty_start(void)
+{
+	/* A missed burst is a hang, a late one is not */
+	supervisor_set_window(SUPERVISOR_GAS, 2 * DUTY_PERIOD_MS);
+#if defined(CONFIG_BME68X)
+	bme680_set_ulp(true);
+	supervisor_set_window(SUPERVISOR_BSEC, BSEC_ULP_WINDOW_MS);
+#endif // CONFIG_BME68X
+	led_signal_set(LED_SIGNAL_IDLE, false);
+	LOG_INF("duty mode, %u readings every %u s", CONFIG_APP_DUTY_BURST_READINGS,
+		CONFIG_APP_DUTY_PERIOD_SEC);
+}
+
+static void duty_record(void)
+{
+	struct battery_value battery = get_battery_percent();
+	struct data_log_record rec = {
+		.boot = data_log_boot(),
+		.battery_pptt = battery.val1 * 100 + battery.val2,
+		.uptime_s = k_uptime_get() / MSEC_PER_SEC,
+		.temp_centi_c = DATA_LOG_TEMP_NONE,
+	};
+
+	for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+		struct gas_sensor_value gas = get_gas_data(i);
+
+		rec.level[i] = gas.val1 * 10 + gas.val2;
+		rec.faults[i] = gas.faults;
+	}
+#if defined(CONFIG_BME68X)
+	struct bme680_data env = get_bme680_data();
+
+	rec.temp_centi_c = env.temp.val1 * 100 + env.temp.val2 / 10000;
+#endif // CONFIG_BME68X
+
+	int err = data_log_append(&rec);
+
+	if (err < 0) {
+		LOG_WRN("data log append (%d)", err);
+	}
+	gas_retain();
+}
+
+uint32_t duty_reading_done(uint32_t period_ms)
+{
+	static bool started;
+	static uint32_t readings;
+
+	if (!started) {
+		started = true;
+		duty_start();
+	}
+	if (readings == 0) {
+		bt_set_advertising(true);
+	}
+	if (++readings < CONFIG_APP_DUTY_BURST_READINGS) {
+		return period_ms;
+	}
+	readings = 0;
+	duty_record();
+
+	if (bt_connected()) {
+		/* Live readings while a central is connected, a record per burst length */
+		return period_ms;
+	}
+	bt_set_advertising(false);
+
+	/* The next burst starts one duty period after this one started */
+	uint32_t burst_ms = (CONFIG_APP_DUTY_BURST_READINGS - 1) * period_ms;
+
+	return DUTY_PERIOD_MS > burst_ms + period_ms ? DUTY_PERIOD_MS - burst_ms : period_ms;
+}
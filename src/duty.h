@@ -0,0 +1,31 @@
+/**
+ * @file src/duty.h - scheduled measurement bursts for storage and standby
+ *
+ * @brief Duty mode, CONFIG_APP_DUTY_MODE.
+ *
+ * Every CONFIG_APP_DUTY_PERIOD_SEC the gas thread takes CONFIG_APP_DUTY_BURST_READINGS readings at
+ * its normal period. The last one is appended to the data log and the calibration state is
+ * sealed in retained RAM, then the thread sleeps until the next burst. Advertising runs during a
+ * burst, and while a central stays connected the readings go on at the normal period. BSEC stays
+ * in ultra low power mode and the idle blink is off.
+ *
+ * The nRF52832 has no timer that runs in System OFF, so between bursts the SoC idles in System ON
+ * and the kernel timer on the RTC wakes it. System OFF stays with the long press of the button,
+ * which wakes on the button and resumes the calibration state from retained RAM.
+ */
+#ifndef __APP_DUTY_H__
+#define __APP_DUTY_H__
+
+#include <stdint.h>
+
+/**
+ * @brief Count a reading of the gas thread.
+ *
+ * Called once per measurement cycle, after all channels were published.
+ *
+ * @param period_ms Period of the readings within a burst, ms.
+ * @return Time until the next reading, ms.
+ */
+uint32_t duty_reading_done(uint32_t period_ms);
+
+#endif // __APP_DUTY_H__
@@ -0,0 +1,113 @@
+/**
+ * @file src/fuel_gauge.c - battery state of charge from voltage and an energy model
+ */
+#include <string.h>
+
+#include "fuel_gauge.h"
+
+/* Weight of the average current EMA, about half an hour of one minute samples */
+#define AVG_ALPHA (1.0f / 32.0f)
+
+/* µA times hours in mAh */
+#define UAH_PER_MAH 1000.0f
+
+#define MS_PER_HOUR (3600.0f * 1000.0f)
+
+void fuel_gauge_init(struct fuel_gauge *fg)
+{
+	memset(fg, 0, sizeof(*fg));
+}
+
+uint32_t fuel_gauge_model_ua(const struct fuel_gauge_params *p, uint32_t loads)
+{
+	uint32_t ua = p->base_ua + p->heater_ua;
+
+	ua += (loads & FUEL_GAUGE_LOAD_RADIO) ? p->conn_ua : p->adv_ua;
+	if (loads & FUEL_GAUGE_LOAD_CAPTURE) {
+		ua += p->capture_ua;
+	}
+	return ua;
+}
+
+int32_t fuel_gauge_ocv_mv(const struct fuel_gauge_params *p, int32_t mv, uint32_t loads)
+{
+	/* Current through the cell in the seconds before the sample, not the instant of it */
+	uint32_t ua = p->base_ua;
+
+	ua += (loads & FUEL_GAUGE_LOAD_RADIO) ? p->conn_ua : p->adv_ua;
+	if (loads & FUEL_GAUGE_LOAD_HEATER) {
+		ua += p->heater_peak_ua;
+	}
+	if (loads & FUEL_GAUGE_LOAD_CAPTURE) {
+		ua += p->capture_ua;
+	}
+
+	/* µA * mΩ = nV */
+	return mv + (int32_t)(((uint64_t)ua * p->resistance_mohm + 500000) / 1000000);
+}
+
+static float clamp_pptt(float pptt)
+{
+	if (pptt < 0.0f) {
+		return 0.0f;
+	}
+	return pptt > 10000.0f ? 10000.0f : pptt;
+}
+
+/* Pull of the voltage estimate on the model */
+static float ocv_weight(const struct fuel_gauge *fg, const struct fuel_gauge_params *p, float ocv,
+			uint32_t loads)
+{
+	if (fg->samples < FUEL_GAUGE_WARMUP_SAMPLES) {
+		/* Plain mean of the first samples, the model has nothing to hold yet */
+		return 1.0f / (float)(fg->samples + 1);
+	}
+	if (loads != 0) {
+		return p->ocv_gain_loaded;
+	}
+	if (ocv - fg->soc_pptt > (float)p->reseed_pptt) {
+		return 1.0f;
+	}
+	return p->ocv_gain;
+}
+
+uint32_t fuel_gauge_update(struct fuel_gauge *fg, const struct fuel_gauge_params *p,
+			   uint32_t ocv_pptt, uint32_t loads, int64_t now_ms)
+{
+	float ocv = (float)ocv_pptt;
+
+	if (fg->samples == 0) {
+		fg->soc_pptt = ocv;
+		fg->avg_ua = (float)fuel_gauge_model_ua(p, loads);
+	} else {
+		/* Charge of the interval, drawn by the loads of the previous sample */
+		float ua = (float)fuel_gauge_model_ua(p, fg->loads);
+		float mah = ua * (float)(now_ms - fg->last_ms) / MS_PER_HOUR / UAH_PER_MAH;
+
+		fg->used_mah += mah;
+		fg->avg_ua += AVG_ALPHA * (ua - fg->avg_ua);
+		fg->soc_pptt -= mah * 10000.0f / (float)p->capacity_mah;
+		fg->soc_pptt += ocv_weight(fg, p, ocv, loads) * (ocv - fg->soc_pptt);
+	}
+
+	fg->soc_pptt = clamp_pptt(fg->soc_pptt);
+	fg->loads = loads;
+	fg->last_ms = now_ms;
+	fg->samples++;
+	if (loads != 0) {
+		fg->loaded_samples++;
+	}
+	return (uint32_t)(fg->soc_pptt + 0.5f);
+}
+
+uint32_t fuel_gauge_time_to_empty_min(const struct fuel_gauge *fg,
+				      const struct fuel_gauge_params *p)
+{
+	if (fg->samples == 0 || fg->avg_ua < 1.0f) {
+		return UINT32_MAX;
+	}
+
+	float left_mah = fg->soc_pptt * (float)p->capacity_mah / 10000.0f;
+
+	return (uint32_t)(left_mah * UAH_PER_MAH / fg->avg_ua * 60.0f);
+}
@@ -0,0 +1,128 @@
+/**
+ * @file src/fuel_gauge.h - battery state of charge from voltage and an energy model
+ *
+ * @brief Combines two estimates of the charge left in the cell.
+ *
+ * A voltage sample is taken while the firmware is drawing current, so it sits below the open
+ * circuit voltage (OCV) by the IR drop of the cell. Each sample is tagged with the loads running
+ * at that moment. The drop of those loads is added back before the voltage is mapped through the
+ * OCV curve. Between samples, the charge drawn is integrated from an energy model: the average
+ * current of every load, for as long as it was on. The model is smooth but drifts. The voltage
+ * has no drift but is noisy, and is least reliable under load. The state of charge follows the
+ * model and is pulled toward the voltage estimate by a small gain, which is smaller still for a
+ * loaded sample. No kernel dependency, time is passed in.
+ */
+#ifndef __APP_FUEL_GAUGE_H__
+#define __APP_FUEL_GAUGE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Samples averaged plainly after boot before the model takes over */
+#define FUEL_GAUGE_WARMUP_SAMPLES 8
+
+/** Loads running while a sample is taken, as a bitmask. */
+enum fuel_gauge_load {
+	/** BLE connection open. Without this bit the radio is advertising. */
+	FUEL_GAUGE_LOAD_RADIO = 0x01,
+	/** BME680 gas heater ran within the last seconds, and the cell is still recovering. */
+	FUEL_GAUGE_LOAD_HEATER = 0x02,
+	/** Raw SAADC capture streaming, with the battery divider held on. */
+	FUEL_GAUGE_LOAD_CAPTURE = 0x04,
+};
+
+/** Cell and energy model. Currents are averages in µA. */
+struct fuel_gauge_params {
+	/** Rated capacity, mAh. */
+	uint32_t capacity_mah;
+	/** Internal resistance of the cell and its protection circuit, mΩ. */
+	uint32_t resistance_mohm;
+	/** Floor with every load off: MCU idle, gas front end, regulator. */
+	uint32_t base_ua;
+	/** Radio advertising, no connection. */
+	uint32_t adv_ua;
+	/** Radio with a connection open, including the periodic notifications. */
+	uint32_t conn_ua;
+	/** BME680 heater averaged over its sample period, 0 without the sensor. */
+	uint32_t heater_ua;
+	/** BME680 heater while it heats, used for the IR drop of a tagged sample. */
+	uint32_t heater_peak_ua;
+	/** SAADC, radio in throughput mode and divider during a raw capture. */
+	uint32_t capture_ua;
+	/** Pull toward the voltage estimate per sample without load, 0..1. */
+	float ocv_gain;
+	/** Pull toward the voltage estimate per sample taken under load, 0..1. */
+	float ocv_gain_loaded;
+	/** A sample without load this far above the estimate resets it, pptt (charger, new cell). */
+	int32_t reseed_pptt;
+};
+
+/** Estimator state. */
+struct fuel_gauge {
+	/** State of charge, pptt. */
+	float soc_pptt;
+	/** Average model current, EMA over samples, µA. */
+	float avg_ua;
+	/** Charge drawn since boot according to the model, mAh. */
+	float used_mah;
+	/** Loads of the last sample, they are assumed to run until the next one. */
+	uint32_t loads;
+	int64_t last_ms;
+	uint32_t samples;
+	uint32_t loaded_samples;
+};
+
+/**
+ * @brief Reset the estimator.
+ *
+ * @param fg Estimator state.
+ */
+void fuel_gauge_init(struct fuel_gauge *fg);
+
+/**
+ * @brief Open circuit voltage of a sample.
+ *
+ * @param p Cell and energy model.
+ * @param mv Battery voltage at the divider, mV.
+ * @param loads Bitmask of enum fuel_gauge_load running during the sample.
+ *
+ * @return @p mv with the IR drop of the tagged loads added back, mV.
+ */
+int32_t fuel_gauge_ocv_mv(const struct fuel_gauge_params *p, int32_t mv, uint32_t loads);
+
+/**
+ * @brief Model current of a set of loads.
+ *
+ * @param p Cell and energy model.
+ * @param loads Bitmask of enum fuel_gauge_load.
+ *
+ * @return Average current, µA.
+ */
+uint32_t fuel_gauge_model_ua(const struct fuel_gauge_params *p, uint32_t loads);
+
+/**
+ * @brief Feed one sample.
+ *
+ * @param fg Estimator state.
+ * @param p Cell and energy model.
+ * @param ocv_pptt State of charge read from the OCV curve at fuel_gauge_ocv_mv(), pptt.
+ * @param loads Bitmask of enum fuel_gauge_load running during the sample.
+ * @param now_ms Monotonic time in milliseconds.
+ *
+ * @return State of charge, pptt.
+ */
+uint32_t fuel_gauge_update(struct fuel_gauge *fg, const struct fuel_gauge_params *p,
+			   uint32_t ocv_pptt, uint32_t loads, int64_t now_ms);
+
+/**
+ * @brief Time until the model drains the charge left, at the recent average current.
+ *
+ * @param fg Estimator state.
+ * @param p Cell and energy model.
+ *
+ * @return Minutes, or UINT32_MAX before the first sample.
+ */
+uint32_t fuel_gauge_time_to_empty_min(const struct fuel_gauge *fg,
+				      const struct fuel_gauge_params *p);
+
+#endif // __APP_FUEL_GAUGE_H__
@@ -1,46 +1,16 @@
 #ifndef __APP_GAS_H__
 #define __APP_GAS_H__
 
-#include "settings.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/devicetree.h>
 
-#define GAS_LEVEL_POINT_STRUCT()                                                                   \
-	/* Discharge curve specific to the gas source. */                                          \
-	static struct level_point measurement_range[2][2] = {                                      \
-		/* O2 */                                                                           \
-		{                                                                                  \
-			{250, DEFAULT_O2_VALUE},                                                   \
-			/*  Zero current (offset) <0.6 % vol O2 */ {0, 0},                         \
-		},                                                                                 \
-		{                                                                                  \
-			/*  Measurement Range Max 100ppm H2S*/                                     \
-			{200, DEFAULT_GAS_VALUE},                                                  \
-			{0, 10},                                                                   \
-		},                                                                                 \
-	}
+#include "settings.h"
 
-#define GAS_COEFFICIENT_STRUCT()                                                                   \
-	/* curve specific to the gas temperature coefficient. */                                   \
-	static struct level_point coeff_levels[2][7] = {                                           \
-		/* Output Temperature Coefficient Oxygen Sensor */                                 \
-		{                                                                                  \
-			{1030, 4000},                                                              \
-			{1015, 3000},                                                              \
-			{1000, 2000},                                                              \
-			{975, 1000},                                                               \
-			{950, 0},                                                                  \
-			{920, -1000},                                                              \
-			{890, -2000},                                                              \
-		}, /* Output Temperature Coefficient Gas Sensor */                                 \
-		{                                                                                  \
-			{1030, 4000},                                                              \
-			{1015, 3000},                                                              \
-			{1000, 2000},                                                              \
-			{975, 1000},                                                               \
-			{950, 0},                                                                  \
-			{920, -1000},                                                              \
-			{890, -2000},                                                              \
-		},                                                                                 \
-	}
+/* Electrochemical cells, see dts/bindings/hhs,gas-channels.yaml */
+#define GAS_CHANNELS_NODE DT_COMPAT_GET_ANY_STATUS_OKAY(hhs_gas_channels)
+#define GAS_CHANNEL_COUNT DT_CHILD_NUM_STATUS_OKAY(GAS_CHANNELS_NODE)
 
 struct gas_sensor_value {
 	/** adc raw data **/
@@ -49,33 +19,106 @@ struct gas_sensor_value {
 	unsigned int val1;
 	/** Fractional part of the value (in one-millionth parts). */
 	unsigned int val2;
+	/** Bitmask of enum gas_diag_fault, 0 for a healthy cell. */
+	unsigned int faults;
+};
+
+/** Per channel processing cost, accumulated since boot. */
+struct gas_channel_stats {
+	/** Readings processed. */
+	uint32_t samples;
+	/** ADC burst and decimation, summed and worst case, in hardware cycles. */
+	uint64_t adc_cycles;
+	uint32_t adc_cycles_max;
+	/** Signal processing, summed and worst case, in hardware cycles. */
+	uint64_t dsp_cycles;
+	uint32_t dsp_cycles_max;
 };
 
 /**
  * @brief This function is designed to be used in a multitasking environment where multiple threads
- * might try to access the `gas_data` array concurrently. The use of a semaphore (`gas_sem`) ensures
- * that only one thread can access the data at a time, preventing race conditions and ensuring data
+ * might try to access the gas data concurrently. The use of a semaphore (`gas_sem`) ensures that
+ * only one thread can access the data at a time, preventing race conditions and ensuring data
  * integrity. The function blocks indefinitely until it can take the semaphore, makes a copy of the
  * data, and then releases the semaphore as quickly as possible.
  *
- * @param gas_dev The gas device to get data from.
+ * @param channel Channel index, 0..GAS_CHANNEL_COUNT-1 in devicetree order.
  * @return The copied gas sensor data.
  */
-struct gas_sensor_value get_gas_data(enum gas_device gas_dev);
+struct gas_sensor_value get_gas_data(int channel);
+
+/**
+ * @brief Name of a channel, the sensor-name devicetree property.
+ *
+ * @param channel Channel index.
+ * @return Name, or NULL for an invalid index.
+ */
+const char *gas_channel_name(int channel);
+
+/**
+ * @brief Look up a channel by name.
+ *
+ * @param name Channel name, not necessarily terminated.
+ * @param len Length of name.
+ * @return Channel index, or -ENOENT.
+ */
+int gas_channel_find(const char *name, size_t len);
+
+/**
+ * @brief Copy the processing cost counters of a channel.
+ *
+ * @param channel Channel index.
+ * @param stats Destination.
+ * @return 0 on success, -EINVAL for an invalid index.
+ */
+int gas_channel_get_stats(int channel, struct gas_channel_stats *stats);
 
 /**
- * @brief Calibrates the oxygen sensor based on a reference value.
+ * @brief Calibrates a channel against a reference value.
  *
- * This function calibrates the oxygen sensor by calculating a new millivolt level
- * for the sensor based on the provided reference value. It takes into account
- * the voltage divider formed by resistors R1 and R2 to adjust the sensor's
- * measurement range. It also ensures thread-safe access to shared resources using
- * a semaphore.
+ * Oxygen cells take the reference in percent and are span calibrated through the voltage divider
+ * formed by R1 and R2; toxic cells take it in ppm. The new span point is applied under the
+ * semaphore and stored in the settings.
  *
- * @param reference_value A string representing the reference oxygen level in percent.
+ * @param channel Channel index.
+ * @param reference_value A string with the reference level.
  * @param len The length of the reference_value string.
+ * @return 0 on success, -EINVAL for an invalid index.
+ */
+int gas_calibrate(int channel, const char *reference_value, int len);
+
+/**
+ * @brief Change a signal processing parameter of a channel at runtime.
+ *
+ * The command is "<channel name>:<parameter>=<value>", e.g. "O2:cal.stable_hold_ms=20000", with
+ * the parameter names of gas_dsp_param_table. The change applies from the next reading and is not
+ * stored, a reboot restores the defaults.
+ *
+ * @param cmd Command, not necessarily terminated.
+ * @param len Length of cmd.
+ * @return 0 on success, -ENOENT for an unknown channel or parameter, -EINVAL for a malformed
+ *         command or value.
+ */
+int gas_tune(const char *cmd, size_t len);
+
+/**
+ * @brief Change the measurement period.
+ *
+ * Applies from the next wakeup. Filters that count readings cover a longer time accordingly.
+ *
+ * @param period_ms Period in ms, 0 for the default of 2 s.
+ */
+void gas_set_period(uint32_t period_ms);
+
+/**
+ * @brief Seal the calibration state of every channel in retained RAM.
+ *
+ * The state is picked up once by the next boot, after System OFF or a warm reset: offsets, O2
+ * span calibration timing and diagnostics carry on, the filters start over. Callable from an
+ * interrupt, where it gives up if a measurement is running.
+ *
+ * @return 0 on success, -EBUSY if a measurement held the state.
  */
-void calibrate_oxygen(char *reference_value, int len);
-void calibrate_gas(char *reference_value, int len);
+int gas_retain(void);
 
 #endif // __APP_GAS_H__
@@ -0,0 +1,147 @@
+/**
+ * @file src/gas_diag.c - gas cell fault and drift detection
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "gas_diag.h"
+
+/* Noise EMA weight, about a minute of readings at 1 Hz */
+#define NOISE_ALPHA (1.0f / 64.0f)
+
+/* Clear hysteresis of the noise fault, fraction of the limit */
+#define NOISE_CLEAR_RATIO 0.5f
+
+/* Samples of cal_time older than this do not count */
+#define CAL_WINDOW_MS (3600 * 1000)
+
+void gas_diag_init(struct gas_diag *d)
+{
+	memset(d, 0, sizeof(*d));
+	median_filter_init(&d->blocks, GAS_DIAG_BASELINE_BLOCKS);
+}
+
+static void update_rail(struct gas_diag *d, const struct gas_diag_params *p, int32_t mv)
+{
+	uint32_t rail = 0;
+
+	if (mv <= p->rail_low_mv) {
+		rail = GAS_DIAG_FAULT_RAIL_LOW;
+	} else if (mv >= p->rail_high_mv) {
+		rail = GAS_DIAG_FAULT_RAIL_HIGH;
+	}
+
+	if (rail) {
+		d->rail_hits++;
+		d->clear_run = 0;
+		if (++d->rail_run >= p->rail_hold) {
+			d->faults |= rail;
+		}
+	} else {
+		d->rail_run = 0;
+		if (++d->clear_run >= p->rail_hold) {
+			d->faults &= ~(GAS_DIAG_FAULT_RAIL_LOW | GAS_DIAG_FAULT_RAIL_HIGH);
+		}
+	}
+}
+
+static void update_noise(struct gas_diag *d, const struct gas_diag_params *p, int32_t mv)
+{
+	d->noise_mv += NOISE_ALPHA * ((float)abs(mv - d->prev_mv) - d->noise_mv);
+	d->prev_mv = mv;
+
+	if (d->noise_mv > p->noise_max_mv) {
+		d->faults |= GAS_DIAG_FAULT_NOISY;
+	} else if (d->noise_mv < p->noise_max_mv * NOISE_CLEAR_RATIO) {
+		d->faults &= ~GAS_DIAG_FAULT_NOISY;
+	}
+}
+
+static void update_baseline(struct gas_diag *d, const struct gas_diag_params *p, int32_t mv,
+			    int64_t now)
+{
+	d->block_sum += mv;
+	d->block_n++;
+	if (now - d->block_start < p->block_ms) {
+		return;
+	}
+
+	median_filter_push(&d->blocks, (int32_t)(d->block_sum / d->block_n));
+	d->block_sum = 0;
+	d->block_n = 0;
+	d->block_start = now;
+
+	if (median_filter_count(&d->blocks) < GAS_DIAG_BASELINE_BLOCKS) {
+		return;
+	}
+
+	d->baseline_mv = median_filter_get(&d->blocks);
+	if (!d->reference_valid) {
+		d->reference_mv = d->baseline_mv;
+		d->reference_valid = true;
+		return;
+	}
+
+	int32_t limit = abs(d->reference_mv) * p->drift_max_pct / 100;
+
+	if (abs(d->baseline_mv - d->reference_mv) > limit) {
+		d->faults |= GAS_DIAG_FAULT_DRIFT;
+	} else {
+		d->faults &= ~GAS_DIAG_FAULT_DRIFT;
+	}
+}
+
+static int cal_limit(const struct gas_diag_params *p)
+{
+	if (p->cal_max_per_hour < 1) {
+		return 1;
+	}
+	return p->cal_max_per_hour > GAS_DIAG_CAL_HISTORY ? GAS_DIAG_CAL_HISTORY
+							  : p->cal_max_per_hour;
+}
+
+/* Calibrations in the last hour */
+static int recent_calibrations(const struct gas_diag *d, int64_t now)
+{
+	int n = 0;
+	int kept = d->cal_count < GAS_DIAG_CAL_HISTORY ? d->cal_count : GAS_DIAG_CAL_HISTORY;
+
+	for (int i = 0; i < kept; i++) {
+		if (now - d->cal_time[i] < CAL_WINDOW_MS) {
+			n++;
+		}
+	}
+	return n;
+}
+
+uint32_t gas_diag_update(struct gas_diag *d, const struct gas_diag_params *p, int32_t mv,
+			 int64_t now_ms)
+{
+	if (!d->initialized) {
+		d->block_start = now_ms;
+		d->prev_mv = mv;
+		d->initialized = true;
+	}
+
+	update_rail(d, p, mv);
+	update_noise(d, p, mv);
+	update_baseline(d, p, mv, now_ms);
+
+	/* Latched until an hour without calibration, they are inhibited meanwhile */
+	if ((d->faults & GAS_DIAG_FAULT_CAL_RATE) && recent_calibrations(d, now_ms) == 0) {
+		d->faults &= ~GAS_DIAG_FAULT_CAL_RATE;
+	}
+	return d->faults;
+}
+
+void gas_diag_note_calibration(struct gas_diag *d, const struct gas_diag_params *p,
+			       int64_t now_ms)
+{
+	d->cal_time[d->cal_head] = now_ms;
+	d->cal_head = (d->cal_head + 1) % GAS_DIAG_CAL_HISTORY;
+	d->cal_count++;
+
+	if (recent_calibrations(d, now_ms) > cal_limit(p)) {
+		d->faults |= GAS_DIAG_FAULT_CAL_RATE;
+	}
+}
@@ -0,0 +1,140 @@
+/**
+ * @file src/gas_diag.h - gas cell fault and drift detection
+ *
+ * @brief Long horizon health statistics of one electrochemical cell.
+ *
+ * Runs on every reading next to the gas pipeline and flags a dead or saturated cell (output held
+ * at an ADC rail), excessive noise, a baseline that drifted over hours and a cell that keeps
+ * asking for recalibration. Memory is fixed: a few counters, a noise EMA and a median over the
+ * last GAS_DIAG_BASELINE_BLOCKS block means. No kernel dependency, time is passed in.
+ */
+#ifndef __APP_GAS_DIAG_H__
+#define __APP_GAS_DIAG_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "median_filter.h"
+
+/* Block means in the baseline median, odd; with 10 min blocks a bit over 3 h */
+#define GAS_DIAG_BASELINE_BLOCKS 19
+
+/* Calibration timestamps kept for the rate check, upper bound of cal_max_per_hour */
+#define GAS_DIAG_CAL_HISTORY 8
+
+/** Fault flags, reported in the BLE payload as a decimal bitmask per channel. */
+enum gas_diag_fault {
+	/** Output at or below the low rail: dead, open or reversed cell. */
+	GAS_DIAG_FAULT_RAIL_LOW = 0x01,
+	/** Output at or above the high rail: saturated cell or front end. */
+	GAS_DIAG_FAULT_RAIL_HIGH = 0x02,
+	/** Noise floor above the limit. */
+	GAS_DIAG_FAULT_NOISY = 0x04,
+	/** Multi-hour baseline moved too far from the first one after boot. */
+	GAS_DIAG_FAULT_DRIFT = 0x08,
+	/** More calibrations in the last hour than allowed, held for an hour without one. */
+	GAS_DIAG_FAULT_CAL_RATE = 0x10,
+};
+
+/** Limits of the detector. */
+struct gas_diag_params {
+	/** Readings at or below this are on the low rail, mV. */
+	int32_t rail_low_mv;
+	/** Readings at or above this are on the high rail, mV. */
+	int32_t rail_high_mv;
+	/** Consecutive readings on a rail that set the fault, and off it that clear it. */
+	int32_t rail_hold;
+	/** Noise floor limit, mean absolute difference of consecutive readings, mV. */
+	float noise_max_mv;
+	/** Allowed baseline drift in percent of the first baseline. */
+	int32_t drift_max_pct;
+	/** Length of one baseline block, ms. */
+	int32_t block_ms;
+	/** Calibrations allowed within one hour, 1..GAS_DIAG_CAL_HISTORY. */
+	int32_t cal_max_per_hour;
+};
+
+/* clang-format off */
+#define GAS_DIAG_PARAMS_DEFAULT                                                                    \
+	{                                                                                          \
+		.rail_low_mv = 5,                                                                  \
+		.rail_high_mv = 3500,                                                              \
+		.rail_hold = 10,                                                                   \
+		.noise_max_mv = 15.0f,                                                             \
+		.drift_max_pct = 20,                                                               \
+		.block_ms = 600000,                                                                \
+		.cal_max_per_hour = 3,                                                             \
+	}
+/* clang-format on */
+
+/** Detector state of one cell. */
+struct gas_diag {
+	/* current baseline block */
+	int64_t block_sum;
+	int32_t block_n;
+	int64_t block_start;
+	/* median of the last block means, and the first full one as reference */
+	struct median_filter blocks;
+	int32_t baseline_mv;
+	int32_t reference_mv;
+	bool reference_valid;
+
+	/* mean absolute first difference */
+	float noise_mv;
+	int32_t prev_mv;
+
+	/* consecutive readings on / off a rail, and readings on a rail since boot */
+	int32_t rail_run;
+	int32_t clear_run;
+	uint32_t rail_hits;
+
+	int64_t cal_time[GAS_DIAG_CAL_HISTORY];
+	uint8_t cal_head;
+	uint32_t cal_count;
+
+	uint32_t faults;
+	bool initialized;
+};
+
+/**
+ * @brief Reset the detector.
+ *
+ * @param d Detector state.
+ */
+void gas_diag_init(struct gas_diag *d);
+
+/**
+ * @brief Feed one reading.
+ *
+ * @param d Detector state.
+ * @param p Limits.
+ * @param mv Compensated reading before outlier rejection and clamping, mV.
+ * @param now_ms Monotonic time in milliseconds.
+ *
+ * @return Current bitmask of enum gas_diag_fault.
+ */
+uint32_t gas_diag_update(struct gas_diag *d, const struct gas_diag_params *p, int32_t mv,
+			 int64_t now_ms);
+
+/**
+ * @brief Whether automatic calibration may run on the cell.
+ *
+ * False with any fault set and while the current reading is on a rail, before the rail fault is
+ * confirmed, so a dead cell is not calibrated on its first reading.
+ */
+static inline bool gas_diag_calibration_allowed(const struct gas_diag *d)
+{
+	return d->faults == 0 && d->rail_run == 0;
+}
+
+/**
+ * @brief Record a persistent (span) calibration of the cell.
+ *
+ * @param d Detector state.
+ * @param p Limits.
+ * @param now_ms Monotonic time in milliseconds.
+ */
+void gas_diag_note_calibration(struct gas_diag *d, const struct gas_diag_params *p,
+			       int64_t now_ms);
+
+#endif // __APP_GAS_DIAG_H__
@@ -0,0 +1,603 @@
+/**
+ * @file src/gas_dsp.c - gas sensor signal processing
+ *
+ * @brief Outlier rejection, dynamic calibration, smoothing and level conversion of the
+ * electrochemical gas channels. Kept free of kernel calls so it can be replayed on host.
+ */
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gas_dsp.h"
+
+static inline int32_t clamp_i32(int32_t v, int32_t lo, int32_t hi)
+{
+	return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void window_add(struct gas_dsp_window *w, int32_t value)
+{
+	w->buffer[w->index] = value;
+	w->index = (w->index + 1) % GAS_DSP_WINDOW_SIZE;
+	if (w->index == 0) {
+		w->is_full = true;
+	}
+}
+
+static void welford_stats(const struct gas_dsp_window *w, float *mean, float *std)
+{
+	int count = w->is_full ? GAS_DSP_WINDOW_SIZE : w->index;
+	double m = 0.0, s = 0.0;
+
+	for (int i = 0; i < count; i++) {
+		double x = (double)w->buffer[i];
+		double delta = x - m;
+
+		m += delta / (i + 1);
+		s += delta * (x - m);
+	}
+	*mean = (float)m;
+	*std = (count > 1) ? (float)sqrt(s / (count - 1)) : 0.0f;
+}
+
+static int32_t apply_3_sigma_rule(const struct gas_dsp_window *w, float multiplier, int32_t value)
+{
+	float mean, std;
+
+	if (!w->is_full) {
+		return value;
+	}
+
+	welford_stats(w, &mean, &std);
+	if (std == 0.0f) {
+		return (int32_t)mean;
+	}
+
+	float lo = mean - multiplier * std;
+	float hi = mean + multiplier * std;
+
+	return (value < lo || value > hi) ? (int32_t)lroundf(mean) : value;
+}
+
+/* 기대 raw(mV): range[0] 은 O2 25% 기준 mV */
+static int32_t expected_o2_raw(const struct level_point *range, float percent)
+{
+	return (int32_t)lrintf((float)range[0].lvl_mV * (percent / 25.0f));
+}
+
+/*
+ * Calibration engine shared by the O2 span and the gas offset calibration: a derivative of the
+ * tracked value, the time it has stayed below threshold, the correction window and a cool down.
+ */
+static void cal_start(struct gas_dsp_cal *st, int32_t value, int64_t now)
+{
+	/* 첫 호출 시점에 기준값 세팅(초기 파생 왜곡 방지) */
+	if (!st->initialized) {
+		st->boot_ms = now;
+		st->prev_ms = now;
+		st->prev_value = value;
+		st->initialized = true;
+	}
+}
+
+static bool cal_in_warmup(const struct gas_dsp_cal *st, const struct gas_dsp_cal_params *p,
+			  int64_t now)
+{
+	return now - st->boot_ms < p->warmup_ms;
+}
+
+/* Restart the derivative at value, nothing is tracked meanwhile */
+static void cal_restart(struct gas_dsp_cal *st, int32_t value, int64_t now)
+{
+	st->prev_value = value;
+	st->prev_ms = now;
+	st->stable_ms = 0;
+	st->derivative = 0.0f;
+}
+
+static void cal_track(struct gas_dsp_cal *st, const struct gas_dsp_cal_params *p, int32_t value,
+		      int64_t now)
+{
+	int64_t dt = now - st->prev_ms;
+
+	/* 동일/역전 타임스탬프는 파생값을 갱신하지 않음 */
+	if (dt <= 0) {
+		return;
+	}
+
+	st->derivative = (float)(value - st->prev_value) * 1000.0f / (float)dt;
+
+	/* 안정 누적 시간(히스테리시스) */
+	if (fabsf(st->derivative) < p->derivative_threshold) {
+		int64_t stable = st->stable_ms + dt;
+
+		st->stable_ms = stable > INT32_MAX ? INT32_MAX : (int32_t)stable;
+	} else {
+		st->stable_ms = 0;
+	}
+	st->prev_value = value;
+	st->prev_ms = now;
+}
+
+/* 보정 조건: 오차 윈도 + 연속 안정 + 쿨다운 */
+static bool cal_ready(const struct gas_dsp_cal *st, const struct gas_dsp_cal_params *p,
+		      int32_t error, int64_t now)
+{
+	int32_t abs_err = abs(error);
+
+	return abs_err > p->tolerance_low_mv && abs_err < p->tolerance_high_mv &&
+	       st->stable_ms >= p->stable_hold_ms &&
+	       (!st->calibrated || now - st->last_cal_ms >= p->min_interval_ms);
+}
+
+static void cal_done(struct gas_dsp_cal *st, int64_t now)
+{
+	st->last_cal_ms = now;
+	st->calibrated = true;
+	st->stable_ms = 0;
+}
+
+static uint32_t o2_calibration_step(struct gas_dsp_cal *st, const struct gas_dsp_cal_params *p,
+				    int32_t current_avg, int64_t now,
+				    const struct level_point *range, bool allowed)
+{
+	const int32_t error = current_avg - expected_o2_raw(range, GAS_DSP_O2_EXPECTED_PERCENT);
+	uint32_t events = 0;
+
+	cal_start(st, current_avg, now);
+
+	/* 부팅 후 워밍업 윈도: 기준에서 벗어나면 바로 보정 */
+	if (cal_in_warmup(st, p, now)) {
+		if (allowed && abs(error) > p->tolerance_low_mv) {
+			events |= GAS_DSP_EVT_O2_CALIBRATE;
+			cal_done(st, now);
+		}
+		cal_restart(st, current_avg, now);
+		return events;
+	}
+
+	cal_track(st, p, current_avg, now);
+	if (allowed && cal_ready(st, p, error, now)) {
+		events |= GAS_DSP_EVT_O2_CALIBRATE;
+		cal_done(st, now);
+	}
+	return events;
+}
+
+static uint32_t offset_calibration_step(struct gas_dsp_cal *st, struct gas_dsp_offset *off,
+					const struct gas_dsp_params *p, int32_t adc_value_mv,
+					int64_t now, bool allowed)
+{
+	uint32_t events = 0;
+
+	/* 제안 오프셋 계산 후 안전 범위로 클램프 */
+	int32_t new_offset = clamp_i32(-adc_value_mv, p->gas_offset_min_mv, p->gas_offset_max_mv);
+
+	cal_start(st, new_offset, now);
+
+	/* 워밍업: 레퍼런스 윈도 안의 표본 통계로 지속 보정 */
+	if (cal_in_warmup(st, &p->cal, now)) {
+		if (abs(adc_value_mv - p->gas_reference_mv) <= p->gas_reference_window_mv) {
+			median_filter_push(&off->warm, new_offset);
+		}
+
+		int32_t est_offset = median_filter_count(&off->warm) > 0
+					     ? median_filter_get(&off->warm)
+					     : new_offset;
+
+		off->offset_mv = clamp_i32(est_offset, p->gas_offset_min_mv, p->gas_offset_max_mv);
+		events |= GAS_DSP_EVT_OFFSET_WARMUP;
+
+		cal_restart(st, new_offset, now);
+		return events;
+	}
+
+	/* 런타임 보정: 레퍼런스 윈도 밖 표본은 파생값 기준점만 옮김 */
+	if (abs(p->gas_reference_mv + new_offset) > p->gas_reference_window_mv) {
+		st->prev_value = new_offset;
+		st->prev_ms = now;
+		return events;
+	}
+
+	cal_track(st, &p->cal, new_offset, now);
+	if (allowed && fabsf(st->derivative) < p->cal.derivative_threshold &&
+	    cal_ready(st, &p->cal, new_offset - off->offset_mv, now)) {
+		off->offset_mv = new_offset;
+		cal_done(st, now);
+		events |= GAS_DSP_EVT_OFFSET_UPDATE;
+	}
+	return events;
+}
+
+void gas_dsp_channel_init(struct gas_dsp_channel *ch, const struct gas_dsp_params *params,
+			  bool is_o2)
+{
+	memset(ch, 0, sizeof(*ch));
+	ch->is_o2 = is_o2;
+	ema_init(&ch->ema, params->ema_alpha);
+	hampel_filter_init(&ch->hampel, GAS_DSP_WINDOW_SIZE, params->hampel_k);
+	median_filter_init(&ch->offset.warm, GAS_DSP_WARMUP_MEDIAN_LEN);
+	gas_diag_init(&ch->diag);
+}
+
+void gas_dsp_channel_resume(struct gas_dsp_channel *ch, const struct gas_dsp_params *params)
+{
+	memset(&ch->window, 0, sizeof(ch->window));
+	ema_init(&ch->ema, params->ema_alpha);
+	hampel_filter_init(&ch->hampel, GAS_DSP_WINDOW_SIZE, params->hampel_k);
+	ch->cal.stable_ms = 0;
+}
+
+void gas_dsp_process(struct gas_dsp_channel *ch, const struct gas_dsp_params *params, int32_t mv,
+		     int64_t now_ms, const struct level_point *range, struct gas_dsp_result *res)
+{
+	memset(res, 0, sizeof(*res));
+
+	/* Diagnostics see the reading before clamping, a reversed cell reads below 0 */
+	uint32_t prev_faults = ch->diag.faults;
+
+	res->faults = gas_diag_update(&ch->diag, &params->diag, mv, now_ms);
+	if (res->faults != prev_faults) {
+		res->events |= GAS_DSP_EVT_FAULT_CHANGE;
+	}
+
+	bool cal_allowed = gas_diag_calibration_allowed(&ch->diag);
+
+	if (mv < 0) {
+		mv = 0;
+	}
+
+	int32_t filtered;
+
+	if (params->outlier_filter == GAS_DSP_OUTLIER_HAMPEL) {
+		ch->hampel.k = params->hampel_k;
+		filtered = hampel_filter_apply(&ch->hampel, mv);
+	} else {
+		window_add(&ch->window, mv);
+		filtered = apply_3_sigma_rule(&ch->window, params->sigma_multiplier, mv);
+	}
+
+	if (ch->is_o2) {
+		res->events |= o2_calibration_step(&ch->cal, &params->cal, filtered, now_ms, range,
+						   cal_allowed);
+	} else {
+		res->events |= offset_calibration_step(&ch->cal, &ch->offset, params, filtered,
+						       now_ms, cal_allowed);
+		res->offset_mv = ch->offset.offset_mv;
+		filtered += ch->offset.offset_mv;
+		if (filtered < 0) {
+			filtered = 0;
+		}
+	}
+
+	/* Offset updates stay in RAM and are routine, only span calibrations count */
+	if (res->events & GAS_DSP_EVT_O2_CALIBRATE) {
+		gas_diag_note_calibration(&ch->diag, &params->diag, now_ms);
+		if (ch->diag.faults != res->faults) {
+			res->faults = ch->diag.faults;
+			res->events |= GAS_DSP_EVT_FAULT_CHANGE;
+		}
+	}
+
+	res->derivative_mvps = ch->cal.derivative;
+	res->filtered_mv = filtered;
+	res->avg_mv = (int32_t)lroundf(ema_apply(&ch->ema, (float)filtered));
+	res->level = (int)calculate_level_pptt(res->avg_mv, range);
+
+	if (abs(res->level - ch->prev_level) > params->level_change_threshold) {
+		ch->prev_level = res->level;
+		res->events |= GAS_DSP_EVT_LEVEL_CHANGE;
+	}
+}
+
+#define PARAM(field, type) {#field, GAS_DSP_PARAM_##type, offsetof(struct gas_dsp_params, field)}
+
+const struct gas_dsp_param_desc gas_dsp_param_table[] = {
+	PARAM(outlier_filter, INT),
+	PARAM(sigma_multiplier, FLOAT),
+	PARAM(hampel_k, FLOAT),
+	PARAM(ema_alpha, FLOAT),
+	PARAM(level_change_threshold, INT),
+	PARAM(cal.derivative_threshold, FLOAT),
+	PARAM(cal.tolerance_low_mv, I32),
+	PARAM(cal.tolerance_high_mv, I32),
+	PARAM(cal.stable_hold_ms, I32),
+	PARAM(cal.min_interval_ms, I32),
+	PARAM(cal.warmup_ms, I32),
+	PARAM(gas_reference_mv, I32),
+	PARAM(gas_reference_window_mv, I32),
+	PARAM(gas_offset_min_mv, I32),
+	PARAM(gas_offset_max_mv, I32),
+	PARAM(diag.rail_low_mv, I32),
+	PARAM(diag.rail_high_mv, I32),
+	PARAM(diag.rail_hold, I32),
+	PARAM(diag.noise_max_mv, FLOAT),
+	PARAM(diag.drift_max_pct, I32),
+	PARAM(diag.block_ms, I32),
+	PARAM(diag.cal_max_per_hour, I32),
+};
+
+const size_t gas_dsp_param_count = sizeof(gas_dsp_param_table) / sizeof(gas_dsp_param_table[0]);
+
+int gas_dsp_param_set(struct gas_dsp_params *params, const char *name, size_t name_len,
+		      const char *value)
+{
+	for (size_t i = 0; i < gas_dsp_param_count; i++) {
+		const struct gas_dsp_param_desc *d = &gas_dsp_param_table[i];
+		char *field = (char *)params + d->offset;
+		char *end;
+
+		if (strlen(d->name) != name_len || strncmp(d->name, name, name_len) != 0) {
+			continue;
+		}
+
+		switch (d->type) {
+		case GAS_DSP_PARAM_FLOAT: {
+			float v = strtof(value, &end);
+
+			if (end == value || *end != '\0') {
+				return -EINVAL;
+			}
+			*(float *)field = v;
+			break;
+		}
+		case GAS_DSP_PARAM_INT:
+		case GAS_DSP_PARAM_I32: {
+			long v = strtol(value, &end, 0);
+
+			if (end == value || *end != '\0' || v < INT32_MIN || v > INT32_MAX) {
+				return -EINVAL;
+			}
+			if (d->type == GAS_DSP_PARAM_INT) {
+				*(int *)field = (int)v;
+			} else {
+				*(int32_t *)field = (int32_t)v;
+			}
+			break;
+		}
+		}
+		return 0;
+	}
+	return -ENOENT;
+}
+
+int gas_dsp_param_format(const struct gas_dsp_params *params, const struct gas_dsp_param_desc *desc,
+			 char *buf, size_t len)
+{
+	const char *field = (const char *)params + desc->offset;
+
+	switch (desc->type) {
+	case GAS_DSP_PARAM_FLOAT: {
+		/* no float printf on target, three decimals are enough for every tunable */
+		long milli = lroundf(*(const float *)field * 1000.0f);
+
+		return snprintf(buf, len, "%s=%s%ld.%03ld", desc->name, milli < 0 ? "-" : "",
+				labs(milli) / 1000, labs(milli) % 1000);
+	}
+	case GAS_DSP_PARAM_INT:
+		return snprintf(buf, len, "%s=%d", desc->name, *(const int *)field);
+	case GAS_DSP_PARAM_I32:
+	default:
+		return snprintf(buf, len, "%s=%d", desc->name, (int)*(const int32_t *)field);
+	}
+}
+
+unsigned int gas_dsp_o2_span_mv(unsigned int raw_mv, float reference_percent)
+{
+	/* Voltage divider 1+200, the result is rounded down to two decimals */
+	float voltage = raw_mv / ((1 + 200) * (reference_percent * 0.001 * 100));
+
+	voltage = floor(voltage * 100) / 100;
+	return (voltage * 25 * 0.001 * 100) * (1 + 200);
+}
+
+unsigned int gas_dsp_gas_span_mv(unsigned int raw_mv, float reference_ppm)
+{
+	/* VDIFF = ISENSOR * RF(100k), span point at 20ppm(NO2) */
+	return raw_mv * (20.0f / reference_ppm);
+}
+
+/* clang-format off */
+/* curve specific to the gas temperature coefficient. */
+const struct level_point gas_dsp_coeff_levels[GAS_DSP_CELL_COUNT][GAS_DSP_TEMP_COEFF_POINTS] = {
+	/* Output Temperature Coefficient Oxygen Sensor */
+	[GAS_DSP_CELL_O2] = {
+		{1030, 4000},
+		{1015, 3000},
+		{1000, 2000},
+		{975, 1000},
+		{950, 0},
+		{920, -1000},
+		{890, -2000},
+	},
+	/* Output Temperature Coefficient Gas Sensor */
+	[GAS_DSP_CELL_TOXIC] = {
+		{1030, 4000},
+		{1015, 3000},
+		{1000, 2000},
+		{975, 1000},
+		{950, 0},
+		{920, -1000},
+		{890, -2000},
+	},
+};
+/* clang-format on */
+
+uint32_t gas_dsp_temp_gain_q16(const struct level_point *curve, int32_t temp_centi_c)
+{
+	const struct level_point *c = curve;
+	const int last = GAS_DSP_TEMP_COEFF_POINTS - 1;
+	int64_t num, den;
+
+	if (temp_centi_c >= c[0].lvl_mV) {
+		num = c[0].lvl_pptt;
+		den = 1;
+	} else if (temp_centi_c <= c[last].lvl_mV) {
+		num = c[last].lvl_pptt;
+		den = 1;
+	} else {
+		int i = 1;
+
+		while (temp_centi_c < c[i].lvl_mV) {
+			i++;
+		}
+		/* coefficient = num / den, kept as a fraction to avoid rounding it */
+		den = c[i - 1].lvl_mV - c[i].lvl_mV;
+		num = (int64_t)c[i].lvl_pptt * (c[i - 1].lvl_mV - temp_centi_c) +
+		      (int64_t)c[i - 1].lvl_pptt * (temp_centi_c - c[i].lvl_mV);
+	}
+
+	/* gain = 1000 / coefficient */
+	return (uint32_t)((1000LL * 65536 * den + num / 2) / num);
+}
+
+/* clang-format off */
+const struct gas_dsp_env_surface gas_dsp_env_surface_o2 = {
+	.hum_first_centi_pct = 1000,
+	.hum_step_centi_pct = 2000,
+	.press_first_pa = 80000,
+	.press_step_pa = 10000,
+	.coeff = {
+		/* 80 kPa, 90 kPa, 100 kPa, 110 kPa */
+		{7994, 8993, 9993, 10992}, /* 10 %RH */
+		{7943, 8936, 9928, 10921}, /* 30 %RH */
+		{7895, 8882, 9869, 10856}, /* 50 %RH */
+		{7848, 8829, 9810, 10791}, /* 70 %RH */
+		{7797, 8771, 9746, 10720}, /* 90 %RH */
+	},
+};
+
+const struct gas_dsp_env_surface gas_dsp_env_surface_toxic = {
+	.hum_first_centi_pct = 1000,
+	.hum_step_centi_pct = 2000,
+	.press_first_pa = 80000,
+	.press_step_pa = 10000,
+	.coeff = {
+		{9603, 9652, 9695, 9739},
+		{9752, 9801, 9845, 9889},
+		{9900, 9950, 9995, 10040},
+		{9999, 10050, 10095, 10140},
+		{10048, 10099, 10145, 10191},
+	},
+};
+/* clang-format on */
+
+/* Grid cell and offset into it along one axis, clamped to the grid */
+static void env_axis(int32_t v, int32_t first, int32_t step, int points, int *idx, int32_t *frac)
+{
+	int32_t last = first + step * (points - 1);
+
+	if (v <= first) {
+		*idx = 0;
+		*frac = 0;
+	} else if (v >= last) {
+		*idx = points - 2;
+		*frac = step;
+	} else {
+		*idx = (v - first) / step;
+		*frac = (v - first) - *idx * step;
+	}
+}
+
+uint32_t gas_dsp_env_gain_q16(const struct gas_dsp_env_surface *s, int32_t humidity_centi_pct,
+			      int32_t press_pa)
+{
+	int h, p;
+	int32_t fh, fp;
+
+	env_axis(humidity_centi_pct, s->hum_first_centi_pct, s->hum_step_centi_pct,
+		 GAS_DSP_ENV_HUM_POINTS, &h, &fh);
+	env_axis(press_pa, s->press_first_pa, s->press_step_pa, GAS_DSP_ENV_PRESS_POINTS, &p, &fp);
+
+	const int64_t gh = s->hum_step_centi_pct - fh;
+	const int64_t gp = s->press_step_pa - fp;
+
+	/* coefficient = num / den, den = product of the steps */
+	int64_t den = (int64_t)s->hum_step_centi_pct * s->press_step_pa;
+	int64_t num = s->coeff[h][p] * gh * gp + s->coeff[h + 1][p] * fh * gp +
+		      s->coeff[h][p + 1] * gh * fp + s->coeff[h + 1][p + 1] * (int64_t)fh * fp;
+
+	/* gain = 10000 / coefficient */
+	return (uint32_t)((10000LL * 65536 * den + num / 2) / num);
+}
+
+bool gas_dsp_env_update(struct gas_dsp_env_state *st, int32_t humidity_centi_pct, int32_t press_pa,
+			int32_t humidity_deadband, int32_t press_deadband)
+{
+	if (st->valid && abs(humidity_centi_pct - st->humidity_centi_pct) <= humidity_deadband &&
+	    abs(press_pa - st->press_pa) <= press_deadband) {
+		return false;
+	}
+
+	st->humidity_centi_pct = humidity_centi_pct;
+	st->press_pa = press_pa;
+	st->valid = true;
+	return true;
+}
+
+void gas_dsp_cic_init(struct gas_dsp_cic *cic, uint8_t order, uint16_t decimation)
+{
+	memset(cic, 0, sizeof(*cic));
+	cic->order =
+		order < 1 ? 1 : (order > GAS_DSP_CIC_MAX_ORDER ? GAS_DSP_CIC_MAX_ORDER : order);
+	cic->decimation = decimation < 1 ? 1 : decimation;
+	cic->gain = 1;
+	for (int i = 0; i < cic->order; i++) {
+		cic->gain *= cic->decimation;
+	}
+}
+
+bool gas_dsp_cic_push(struct gas_dsp_cic *cic, int32_t x, int32_t *out)
+{
+	/* Integrators run at the input rate; unsigned math makes the wrap well defined */
+	uint32_t acc = (uint32_t)x;
+
+	for (int i = 0; i < cic->order; i++) {
+		cic->integ[i] = (int32_t)((uint32_t)cic->integ[i] + acc);
+		acc = (uint32_t)cic->integ[i];
+	}
+
+	if (++cic->phase < cic->decimation) {
+		return false;
+	}
+	cic->phase = 0;
+
+	/* Combs run at the output rate */
+	for (int i = 0; i < cic->order; i++) {
+		uint32_t prev = (uint32_t)cic->comb[i];
+
+		cic->comb[i] = (int32_t)acc;
+		acc -= prev;
+	}
+
+	int64_t y = (int64_t)(int32_t)acc * (1 << GAS_DSP_CIC_FRAC_BITS);
+
+	/* round half away from zero */
+	*out = (int32_t)((y + (y >= 0 ? 1 : -1) * (int64_t)(cic->gain / 2)) / (int64_t)cic->gain);
+	return true;
+}
+
+int32_t gas_dsp_decimate(const int16_t *samples, size_t n, uint8_t order, uint16_t decimation)
+{
+	struct gas_dsp_cic cic;
+	int32_t out = 0;
+	bool valid = false;
+
+	gas_dsp_cic_init(&cic, order, decimation);
+	for (size_t i = 0; i < n; i++) {
+		valid |= gas_dsp_cic_push(&cic, samples[i], &out);
+	}
+
+	/* Burst shorter than one decimation period: plain average */
+	if (!valid && n > 0) {
+		int64_t sum = 0;
+
+		for (size_t i = 0; i < n; i++) {
+			sum += samples[i];
+		}
+		out = (int32_t)((sum * (1 << GAS_DSP_CIC_FRAC_BITS)) / (int64_t)n);
+	}
+	return out;
+}
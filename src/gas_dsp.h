@@ -0,0 +1,467 @@
+/**
+ * @file src/gas_dsp.h - gas sensor signal processing
+ *
+ * @brief Hardware independent part of the gas pipeline.
+ *
+ * Everything between the ADC millivolt reading and the reported level lives here: temperature,
+ * humidity and pressure compensation gains, 3-sigma or Hampel outlier rejection, dynamic O2 span
+ * and gas offset calibration, EMA smoothing and the mV to level conversion. The code has no kernel
+ * dependency, time is passed in by the caller and calibration decisions are returned as events, so
+ * the same pipeline runs in src/gas.c and in the host replay tool under tools/gas_replay. Time is
+ * in milliseconds and every channel carries its own struct gas_dsp_params, which can be changed by
+ * name at runtime.
+ */
+#ifndef __APP_GAS_DSP_H__
+#define __APP_GAS_DSP_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ema.h"
+#include "gas_diag.h"
+#include "hhs_math.h"
+#include "median_filter.h"
+
+#define GAS_DSP_WINDOW_SIZE       30 /* 3-sigma window length */
+#define GAS_DSP_WARMUP_MEDIAN_LEN 31 /* warmup offset median window, odd */
+
+/* Expected O2 concentration in fresh air */
+#define GAS_DSP_O2_EXPECTED_PERCENT     20.9f
+#define GAS_DSP_O2_EXPECTED_PERCENT_STR "20.9"
+
+/* Points of each gas_dsp_coeff_levels curve */
+#define GAS_DSP_TEMP_COEFF_POINTS 7
+
+/* Grid of struct gas_dsp_env_surface */
+#define GAS_DSP_ENV_HUM_POINTS   5
+#define GAS_DSP_ENV_PRESS_POINTS 4
+
+#define GAS_DSP_CIC_MAX_ORDER 3
+#define GAS_DSP_CIC_FRAC_BITS 4 /* fractional bits kept in the decimator output */
+
+/** CIC decimator, used to reduce a burst of ADC samples to one reading. */
+struct gas_dsp_cic {
+	int32_t integ[GAS_DSP_CIC_MAX_ORDER];
+	int32_t comb[GAS_DSP_CIC_MAX_ORDER];
+	uint8_t order;
+	uint16_t decimation;
+	uint16_t phase;
+	uint32_t gain;
+};
+
+/**
+ * Humidity and pressure dependence of a cell, sampled on a uniform grid.
+ *
+ * coeff is the output in 0.01 % of the output at 50 %RH and 101.325 kPa. Inputs outside the grid
+ * are clamped to its edges.
+ */
+struct gas_dsp_env_surface {
+	int32_t hum_first_centi_pct;
+	int32_t hum_step_centi_pct;
+	int32_t press_first_pa;
+	int32_t press_step_pa;
+	uint16_t coeff[GAS_DSP_ENV_HUM_POINTS][GAS_DSP_ENV_PRESS_POINTS];
+};
+
+/** Environment inputs the current compensation gain was computed for. */
+struct gas_dsp_env_state {
+	int32_t humidity_centi_pct;
+	int32_t press_pa;
+	bool valid;
+};
+
+/** Outlier rejection of the raw readings. */
+enum gas_dsp_outlier {
+	/** Replace samples outside mean +- sigma_multiplier * std of the window by the mean. */
+	GAS_DSP_OUTLIER_SIGMA = 0,
+	/** Replace samples outside median +- hampel_k * 1.4826 * MAD of the window by the median.
+	 */
+	GAS_DSP_OUTLIER_HAMPEL = 1,
+};
+
+/**
+ * Tunables of the calibration engine shared by the O2 span and the gas offset calibration. The
+ * O2 channel compares the reading with the fresh air expectation, the gas channel compares the
+ * offset it proposes with the applied one.
+ */
+struct gas_dsp_cal_params {
+	/** Derivative below which the reading counts as stable, mV/s. */
+	float derivative_threshold;
+	/** Errors inside (low, high) are corrected, larger ones are left alone, mV. */
+	int32_t tolerance_low_mv;
+	int32_t tolerance_high_mv;
+	/** Time the derivative must stay below threshold, ms. */
+	int32_t stable_hold_ms;
+	/** Cool down between two calibrations, ms. */
+	int32_t min_interval_ms;
+	/** Boot window: O2 is calibrated on any deviation, the gas offset follows the median of the
+	 *  reference samples, ms. */
+	int32_t warmup_ms;
+};
+
+/** Tunables of one channel, see GAS_DSP_PARAMS_O2 and GAS_DSP_PARAMS_TOXIC. */
+struct gas_dsp_params {
+	/** Outlier rejection, enum gas_dsp_outlier. */
+	int outlier_filter;
+	/** Outlier limit in standard deviations. */
+	float sigma_multiplier;
+	/** Hampel outlier limit in MAD based standard deviations. */
+	float hampel_k;
+	/** EMA smoothing factor, 0..1. */
+	float ema_alpha;
+	/** Minimum level change (0.1 unit) reported as a change event. */
+	int level_change_threshold;
+
+	/** O2 span or gas offset calibration. */
+	struct gas_dsp_cal_params cal;
+
+	/** Reference (zero gas) output of a gas channel, mV. */
+	int32_t gas_reference_mv;
+	/** Samples further than this from the reference are not used for the offset, mV. */
+	int32_t gas_reference_window_mv;
+	/** Offset clamp, mV. */
+	int32_t gas_offset_min_mv;
+	int32_t gas_offset_max_mv;
+
+	/** Fault detection; a faulty cell is not calibrated automatically. */
+	struct gas_diag_params diag;
+};
+
+/* clang-format off */
+#define GAS_DSP_PARAMS_COMMON                                                                      \
+	.outlier_filter = GAS_DSP_OUTLIER_SIGMA,                                                   \
+	.sigma_multiplier = 3.0f,                                                                  \
+	.hampel_k = 3.0f,                                                                          \
+	.ema_alpha = 0.10f,                                                                        \
+	.level_change_threshold = 2,                                                               \
+	.gas_reference_mv = 600,                                                                   \
+	.gas_reference_window_mv = 100,                                                            \
+	.gas_offset_min_mv = -1000,                                                                \
+	.gas_offset_max_mv = 1000,                                                                 \
+	.diag = GAS_DIAG_PARAMS_DEFAULT
+
+#define GAS_DSP_PARAMS_O2                                                                          \
+	{                                                                                          \
+		GAS_DSP_PARAMS_COMMON,                                                             \
+		.cal = {                                                                           \
+			/* 1 mV/sec 변화 8mV = 0.1% */                                              \
+			.derivative_threshold = 8.0f,                                              \
+			/* 10 mV(0.125%) < 기준값 차이 < 80 mV(1.0%) 이면 보정 */                     \
+			.tolerance_low_mv = 10,                                                    \
+			.tolerance_high_mv = 80,                                                   \
+			.stable_hold_ms = 10000,                                                   \
+			.min_interval_ms = 60000,                                                  \
+			.warmup_ms = 60000,                                                        \
+		},                                                                                 \
+	}
+
+#define GAS_DSP_PARAMS_TOXIC                                                                       \
+	{                                                                                          \
+		GAS_DSP_PARAMS_COMMON,                                                             \
+		.cal = {                                                                           \
+			.derivative_threshold = 3.0f,                                              \
+			.tolerance_low_mv = 2,                                                     \
+			.tolerance_high_mv = 15,                                                   \
+			.stable_hold_ms = 10000,                                                   \
+			.min_interval_ms = 60000,                                                  \
+			.warmup_ms = 60000,                                                        \
+		},                                                                                 \
+	}
+/* clang-format on */
+
+/** Type of a struct gas_dsp_params field, see gas_dsp_param_table. */
+enum gas_dsp_param_type {
+	GAS_DSP_PARAM_FLOAT,
+	GAS_DSP_PARAM_INT,
+	GAS_DSP_PARAM_I32,
+};
+
+/** Named field of struct gas_dsp_params, for tuning at runtime and in the replay tool. */
+struct gas_dsp_param_desc {
+	const char *name;
+	enum gas_dsp_param_type type;
+	size_t offset;
+};
+
+extern const struct gas_dsp_param_desc gas_dsp_param_table[];
+extern const size_t gas_dsp_param_count;
+
+/** Events returned by gas_dsp_process(), the caller performs the side effects. */
+enum gas_dsp_event {
+	/** O2 span should be recalibrated to GAS_DSP_O2_EXPECTED_PERCENT. */
+	GAS_DSP_EVT_O2_CALIBRATE = 0x01,
+	/** Gas offset follows the warmup estimate. */
+	GAS_DSP_EVT_OFFSET_WARMUP = 0x02,
+	/** Gas offset updated by the runtime calibration. */
+	GAS_DSP_EVT_OFFSET_UPDATE = 0x04,
+	/** Reported level moved by more than level_change_threshold. */
+	GAS_DSP_EVT_LEVEL_CHANGE = 0x08,
+	/** Fault bitmask of the cell changed. */
+	GAS_DSP_EVT_FAULT_CHANGE = 0x10,
+};
+
+/** Sliding window of the 3-sigma rule. */
+struct gas_dsp_window {
+	int32_t buffer[GAS_DSP_WINDOW_SIZE];
+	int index;
+	bool is_full;
+};
+
+/** Calibration engine state: derivative, stable hold time and cool down. */
+struct gas_dsp_cal {
+	int64_t boot_ms;
+	int64_t prev_ms;
+	int64_t last_cal_ms;
+	int32_t prev_value;
+	int32_t stable_ms;
+	float derivative;
+	bool calibrated;
+	bool initialized;
+};
+
+/** Gas offset applied on top of the calibration engine. */
+struct gas_dsp_offset {
+	int32_t offset_mv;
+	/* offsets proposed by reference samples during warmup */
+	struct median_filter warm;
+};
+
+/** One sensor channel of the pipeline. */
+struct gas_dsp_channel {
+	struct gas_dsp_window window;
+	struct hampel_filter hampel;
+	ema_t ema;
+	/* O2 channels run span calibration, gas channels offset calibration */
+	bool is_o2;
+	struct gas_dsp_cal cal;
+	struct gas_dsp_offset offset;
+	struct gas_diag diag;
+	int prev_level;
+};
+
+/** Output of one pipeline step. */
+struct gas_dsp_result {
+	/** Sample after outlier rejection and offset, mV. */
+	int32_t filtered_mv;
+	/** EMA output, mV. */
+	int32_t avg_mv;
+	/** Level in 0.1 units (0.1 % O2 or 0.1 ppm). */
+	int level;
+	/** Offset applied to a gas channel, mV. */
+	int32_t offset_mv;
+	/** Last derivative seen by the calibration, mV/s. */
+	float derivative_mvps;
+	/** Bitmask of enum gas_diag_fault. */
+	uint32_t faults;
+	/** Bitmask of enum gas_dsp_event. */
+	uint32_t events;
+};
+
+/**
+ * @brief Reset a channel to its power-on state.
+ *
+ * @param ch Channel state.
+ * @param params Pipeline parameters.
+ * @param is_o2 True for the O2 channel, false for a toxic gas channel.
+ */
+void gas_dsp_channel_init(struct gas_dsp_channel *ch, const struct gas_dsp_params *params,
+			  bool is_o2);
+
+/**
+ * @brief Continue a channel after a gap in the readings.
+ *
+ * The outlier window and the EMA start over, the readings before the gap are no reference for the
+ * ones after it. Calibration, offset and diagnostics carry on; the caller keeps the time
+ * continuous across the gap.
+ *
+ * @param ch Channel state, from an earlier gas_dsp_channel_init().
+ * @param params Pipeline parameters.
+ */
+void gas_dsp_channel_resume(struct gas_dsp_channel *ch, const struct gas_dsp_params *params);
+
+/**
+ * @brief Run one sample through the pipeline.
+ *
+ * @param ch Channel state.
+ * @param params Pipeline parameters.
+ * @param mv ADC reading in millivolts. Negative readings are clamped to 0 after diagnostics.
+ * @param now_ms Monotonic time of the sample in milliseconds.
+ * @param range mV to level conversion curve of the channel; its first point is the O2 span.
+ * @param res Output of the step.
+ */
+void gas_dsp_process(struct gas_dsp_channel *ch, const struct gas_dsp_params *params, int32_t mv,
+		     int64_t now_ms, const struct level_point *range, struct gas_dsp_result *res);
+
+/**
+ * @brief Set a field of struct gas_dsp_params by name.
+ *
+ * @param params Parameters to change.
+ * @param name Field name as in gas_dsp_param_table, e.g. "cal.stable_hold_ms".
+ * @param name_len Length of name, it need not be terminated.
+ * @param value Terminated decimal value.
+ *
+ * @return 0 on success, -ENOENT for an unknown name, -EINVAL for a malformed value.
+ */
+int gas_dsp_param_set(struct gas_dsp_params *params, const char *name, size_t name_len,
+		      const char *value);
+
+/**
+ * @brief Print a field of struct gas_dsp_params as "name=value".
+ *
+ * @param params Parameters.
+ * @param desc Field, an entry of gas_dsp_param_table.
+ * @param buf Destination.
+ * @param len Size of buf.
+ *
+ * @return Length as snprintf() returns it.
+ */
+int gas_dsp_param_format(const struct gas_dsp_params *params, const struct gas_dsp_param_desc *desc,
+			 char *buf, size_t len);
+
+/**
+ * @brief O2 span point for a reading taken at a known concentration.
+ *
+ * @param raw_mv Averaged O2 reading in millivolts.
+ * @param reference_percent O2 concentration during the reading.
+ *
+ * @return New 25 % span point in millivolts.
+ */
+unsigned int gas_dsp_o2_span_mv(unsigned int raw_mv, float reference_percent);
+
+/**
+ * @brief Gas span point for a reading taken at a known concentration.
+ *
+ * @param raw_mv Averaged gas reading in millivolts.
+ * @param reference_ppm Gas concentration during the reading.
+ *
+ * @return New 20 ppm span point in millivolts.
+ */
+unsigned int gas_dsp_gas_span_mv(unsigned int raw_mv, float reference_ppm);
+
+/**
+ * @brief Set up a CIC decimator.
+ *
+ * The integrators wrap in 32 bits, which is exact as long as
+ * input bits + order * log2(decimation) stays below 32.
+ *
+ * @param cic Decimator state.
+ * @param order Number of integrator/comb stages, 1..GAS_DSP_CIC_MAX_ORDER. Order 1 is a boxcar.
+ * @param decimation Input samples per output sample.
+ */
+void gas_dsp_cic_init(struct gas_dsp_cic *cic, uint8_t order, uint16_t decimation);
+
+/**
+ * @brief Push one sample into the decimator.
+ *
+ * @param cic Decimator state.
+ * @param x Input sample.
+ * @param out Output, unity gain with GAS_DSP_CIC_FRAC_BITS fractional bits. Written when the
+ *            function returns true.
+ *
+ * @return True when an output sample was produced.
+ */
+bool gas_dsp_cic_push(struct gas_dsp_cic *cic, int32_t x, int32_t *out);
+
+/**
+ * @brief Reduce a burst of ADC samples to one reading.
+ *
+ * The burst should hold order * decimation samples so the last output covers a settled filter.
+ *
+ * @param samples ADC samples.
+ * @param n Number of samples.
+ * @param order CIC order.
+ * @param decimation CIC decimation.
+ *
+ * @return Last decimator output, with GAS_DSP_CIC_FRAC_BITS fractional bits.
+ */
+int32_t gas_dsp_decimate(const int16_t *samples, size_t n, uint8_t order, uint16_t decimation);
+
+/** Rows of gas_dsp_coeff_levels. */
+enum gas_dsp_cell {
+	GAS_DSP_CELL_O2,
+	GAS_DSP_CELL_TOXIC,
+	GAS_DSP_CELL_COUNT,
+};
+
+/**
+ * Output temperature coefficient of the cells, the coeff_levels table of gas.c: output in per mille
+ * of the 20 °C output (lvl_pptt) against temperature in 0.01 °C (lvl_mV), both decreasing.
+ */
+extern const struct level_point gas_dsp_coeff_levels[GAS_DSP_CELL_COUNT][GAS_DSP_TEMP_COEFF_POINTS];
+
+/**
+ * @brief Gain that removes the temperature dependence of the cell output.
+ *
+ * Linear interpolation of a gas_dsp_coeff_levels curve, signed and clamped to its end points,
+ * without rounding the coefficient to whole per mille. Meant to be computed once per new
+ * temperature and applied with gas_dsp_compensate().
+ *
+ * @param curve Row of gas_dsp_coeff_levels.
+ * @param temp_centi_c Temperature in 0.01 °C.
+ *
+ * @return 1 / coefficient in Q16.
+ */
+uint32_t gas_dsp_temp_gain_q16(const struct level_point *curve, int32_t temp_centi_c);
+
+/** Humidity and pressure surface of the O2 cell: partial pressure and water vapour dilution. */
+extern const struct gas_dsp_env_surface gas_dsp_env_surface_o2;
+
+/** Humidity and pressure surface of the toxic gas cells. */
+extern const struct gas_dsp_env_surface gas_dsp_env_surface_toxic;
+
+/**
+ * @brief Gain that removes the humidity and pressure dependence of the cell output.
+ *
+ * Bilinear interpolation of the surface, kept as a fraction until the final division like
+ * gas_dsp_temp_gain_q16().
+ *
+ * @param s Surface of the cell.
+ * @param humidity_centi_pct Relative humidity in 0.01 %.
+ * @param press_pa Pressure in Pa.
+ *
+ * @return 1 / coefficient in Q16.
+ */
+uint32_t gas_dsp_env_gain_q16(const struct gas_dsp_env_surface *s, int32_t humidity_centi_pct,
+			      int32_t press_pa);
+
+/**
+ * @brief Track the environment inputs with a deadband.
+ *
+ * Sensor noise on humidity and pressure would otherwise move the gain on every sample and show up
+ * as level changes. The state only follows an input that left the deadband around the value the
+ * gain was last computed for.
+ *
+ * @param st Tracked inputs, zero initialised before the first call.
+ * @param humidity_centi_pct Relative humidity in 0.01 %.
+ * @param press_pa Pressure in Pa.
+ * @param humidity_deadband Humidity deadband in 0.01 %.
+ * @param press_deadband Pressure deadband in Pa.
+ *
+ * @return True when the state was updated and the gain should be recomputed from it.
+ */
+bool gas_dsp_env_update(struct gas_dsp_env_state *st, int32_t humidity_centi_pct, int32_t press_pa,
+			int32_t humidity_deadband, int32_t press_deadband);
+
+/**
+ * @brief Product of two Q16 gains, rounded.
+ */
+static inline uint32_t gas_dsp_gain_mul_q16(uint32_t a, uint32_t b)
+{
+	return (uint32_t)(((uint64_t)a * b + (1 << 15)) >> 16);
+}
+
+/**
+ * @brief Apply a compensation gain from gas_dsp_temp_gain_q16() or gas_dsp_env_gain_q16().
+ *
+ * @param mv Cell output in millivolts.
+ * @param gain_q16 Gain in Q16.
+ *
+ * @return Compensated output in millivolts, rounded.
+ */
+static inline int32_t gas_dsp_compensate(int32_t mv, uint32_t gain_q16)
+{
+	return (int32_t)(((int64_t)mv * gain_q16 + (1 << 15)) >> 16);
+}
+
+#endif // __APP_GAS_DSP_H__
@@ -1,4 +1,3 @@
-#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <zephyr/logging/log.h>
@@ -28,48 +27,6 @@ int calculate_moving_average(moving_average_t *av_obj, int new_element)
 		 (double)(av_obj->is_filled ? av_obj->buffer_length : av_obj->current_position)));
 }
 
-moving_average_t *allocate_moving_average(const int buffer_length)
-{
-	/* Allocate memory for the moving_average_t object */
-	moving_average_t *moving_average_obj = malloc(sizeof(moving_average_t));
-
-	/* Check if memory allocation was successful */
-	if (moving_average_obj == NULL) {
-		return NULL;
-	}
-
-	/* Initialize the members of the moving_average_t object */
-	moving_average_obj->sum = 0;
-	moving_average_obj->current_position = 0;
-	moving_average_obj->buffer_length = buffer_length;
-	moving_average_obj->is_filled = false;
-
-	/* Allocate memory for the buffer and initialize it to 0 */
-	moving_average_obj->buffer = calloc(buffer_length, sizeof(int));
-
-	/* Check if memory allocation was successful */
-	if (moving_average_obj->buffer == NULL) {
-		free(moving_average_obj);
-		return NULL;
-	}
-
-	/* Return the pointer to the allocated moving_average_t object */
-	return moving_average_obj;
-}
-
-void free_moving_average(moving_average_t **avg_obj)
-{
-	if (avg_obj == NULL || *avg_obj == NULL) {
-		return;
-	}
-
-	free((*avg_obj)->buffer);
-	(*avg_obj)->buffer = NULL;
-
-	free(*avg_obj);
-	*avg_obj = NULL;
-}
-
 unsigned int calculate_level_pptt(unsigned int voltage_mV, const struct level_point *curvePoints)
 {
 #define MAX_LEVEL_POINTS 100 // curvePoints 배열에서 최대 점 개수 (안전 검사용)
@@ -83,12 +40,12 @@ unsigned int calculate_level_pptt(unsigned int voltage_mV, const struct level_po
 	int iterations = 0;
 
 	/* 측정 전압이 최고점 이상의 경우, 최대 레벨로 제한 */
-	if (voltage_mV >= currentPoint->lvl_mV) {
+	if (voltage_mV >= (unsigned int)currentPoint->lvl_mV) {
 		return currentPoint->lvl_pptt;
 	}
 
 	/* 무한 루프 방지를 위해 최대 반복 횟수를 제한하면서, 측정 전압보다 큰 구간을 탐색 */
-	while ((currentPoint->lvl_pptt > 0) && (voltage_mV < currentPoint->lvl_mV)) {
+	while ((currentPoint->lvl_pptt > 0) && (voltage_mV < (unsigned int)currentPoint->lvl_mV)) {
 		++currentPoint;
 		iterations++;
 		if (iterations > MAX_LEVEL_POINTS) {
@@ -99,7 +56,7 @@ unsigned int calculate_level_pptt(unsigned int voltage_mV, const struct level_po
 	}
 
 	/* 측정 전압이 최저점 이하인 경우, 최소 레벨로 제한 */
-	if (voltage_mV < currentPoint->lvl_mV) {
+	if (voltage_mV < (unsigned int)currentPoint->lvl_mV) {
 		return currentPoint->lvl_pptt;
 	}
 
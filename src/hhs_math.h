@@ -31,26 +31,20 @@ typedef struct moving_average {
 int calculate_moving_average(moving_average_t *av_obj, int new_element);
 
 /**
- * @brief Allocates and initializes a moving_average_t object.
+ * @brief Statically define a moving average.
  *
- * This function allocates memory for a moving_average_t object and its buffer.
- * It also initializes the members of the object.
+ * Defines a moving_average_t named @p name and its buffer of @p len samples, both zero
+ * initialized. Used with static storage, so the filter costs no heap.
  *
- * @param len The length of the buffer to be allocated.
- * @return A pointer to the allocated moving_average_t object.
+ * @param name Name of the moving_average_t object.
+ * @param len Number of samples averaged.
  */
-moving_average_t *allocate_moving_average(const int buffer_length);
-
-/**
- * @brief Frees the memory allocated for a moving_average_t object.
- *
- * This function frees the memory allocated for the buffer of the moving_average_t object
- * and the object itself. It also sets the pointer to the object to NULL to prevent
- * dangling pointers.
- *
- * @param avg_obj Pointer to the moving_average_t object to be freed.
- */
-void free_moving_average(moving_average_t **av_obj);
+#define MOVING_AVERAGE_DEFINE(name, len)                                                           \
+	static int name##_buffer[len];                                                             \
+	static moving_average_t name = {                                                           \
+		.buffer = name##_buffer,                                                           \
+		.buffer_length = (len),                                                            \
+	}
 
 /** A dataset for converting ADC mV data to pptt
  *
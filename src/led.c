@@ -1,108 +1,254 @@
 /**
- * @file src/led.c - led mosfet gpio control
+ * @file src/led.c - status led pattern engine
  *
- * @brief Code for indicating the battery status with an LED.
+ * @brief Code for indicating the device status with the LEDs.
  *
- * The LED operates every LED_THREAD_SLEEP_INTERVAL to conserve power, staying
- on for LED_TIME_MS.
- * Additionally, for low-power operation, it operates at a brightness of
- LED_PWM_LEVEL.
- * (If the battery status is higher than LOW_BATT_THRESHOLD, it lights up in
- green;
- * otherwise, it lights up in yellow).
+ * A pattern is up to two flashes of LED_ON_MS followed by a dark gap, repeated
+ * with a fixed period. RTC2 counts at 1024 Hz from the 32 kHz clock that
+ * already runs for the kernel; its four compare events toggle the LED pin
+ * through PPI and GPIOTE, and the last one also clears the counter to start
+ * the next period. The CPU only rewires the compare values when the active
+ * signal changes.
+ *
+ * The LEDs are driven at full brightness. Dimming them with the PWM
+ * peripheral would keep the 16 MHz clock running for the whole pattern, far
+ * more current than the LED flash itself.
  *
  * @author bradkim06@gmail.com
  */
 #include <stdbool.h>
 
-#include <zephyr/device.h>
+#include <hal/nrf_gpiote.h>
+#include <hal/nrf_rtc.h>
+#include <nrfx_gpiote.h>
+#include <nrfx_ppi.h>
+#include <soc.h>
 #include <zephyr/devicetree.h>
-#include <zephyr/drivers/led.h>
+#include <zephyr/init.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/util.h>
 
-#include "battery.h"
-#include "hhs_util.h"
+#include <periph_usage.h>
+
+#include "led.h"
 
 /* Register the LED module with the application log level */
 LOG_MODULE_REGISTER(LED, CONFIG_APP_LOG_LEVEL);
 
-/* The battery thread's running period */
-#define LED_THREAD_SLEEP_INTERVAL 10
-/* LED on time */
-#define LED_TIME_MS 50
-/* LED Brightness level */
-#define LED_PWM_LEVEL 100
-
-/* access the Devicetree for the pwm_led node */
-#define LED_PWM_NODE_ID DT_COMPAT_GET_ANY_STATUS_OKAY(pwm_leds)
-static const struct device *led_pwm_device = DEVICE_DT_GET(LED_PWM_NODE_ID);
-
-/* Define the LED device */
-#define LED_DEVICE(X)                                                          \
-    /* battery level stable */                                                 \
-    X(LED_STATE_STABLE_BATTERY, = 0)                                           \
-    /* battery level low */                                                    \
-    X(LED_STATE_LOW_BATTERY, )
-DECLARE_ENUM(led_device_state, LED_DEVICE)
+BUILD_ASSERT(!IS_ENABLED(CONFIG_NRFX_RTC2), "RTC2 is used by the LED pattern engine");
 
-/**
- * @brief Activate the LED MOSFET for a specified time.
- *
- * This function sets the brightness level of the LED, waits for a
- * specified time, and then turns the LED off.
- *
- * @param color: Selected LEDs are controlled by the enum led_dev.
- *
- * @return 0 if successful, error code otherwise.
- */
-static int control_led(uint8_t led_color) {
-    /* Set the LED brightness level */
-    int err = led_set_brightness(led_pwm_device, led_color, LED_PWM_LEVEL);
-    if (err < 0) {
-        LOG_ERR("Error Code=%d, Brightness Level=%d\n", err, LED_PWM_LEVEL);
-        return err;
+/* RTC2 at 32768 / (31 + 1) = 1024 Hz, the 24 bit counter spans 4.5 hours */
+#define LED_RTC           NRF_RTC2
+#define LED_RTC_PRESCALER 31
+#define LED_RTC_HZ        (32768 / (LED_RTC_PRESCALER + 1))
+
+/* Flash length and gap between the two flashes of a double blink */
+#define LED_ON_MS  50
+#define LED_GAP_MS 200
+
+/* Compare channels: three edges inside the period, the last one ends it */
+#define LED_EDGES     4
+#define LED_EDGE_LAST (LED_EDGES - 1)
+
+enum led_color {
+    LED_GREEN,
+    LED_YELLOW,
+    LED_COLOR_COUNT,
+};
+
+struct led_pattern {
+    enum led_color color;
+    /* flashes per period, 1 or 2 */
+    uint8_t flashes;
+    uint16_t on_ms;
+    uint16_t gap_ms;
+    uint32_t period_ms;
+};
+
+/* One pattern per signal, same order as enum led_signal */
+static const struct led_pattern patterns[LED_SIGNAL_COUNT] = {
+    [LED_SIGNAL_IDLE] = {LED_GREEN, 1, LED_ON_MS, 0, 10000},
+    [LED_SIGNAL_LOW_BATTERY] = {LED_YELLOW, 2, LED_ON_MS, LED_GAP_MS, 10000},
+    [LED_SIGNAL_SENSOR_FAULT] = {LED_YELLOW, 1, LED_ON_MS, 0, 1000},
+    [LED_SIGNAL_FAULT] = {LED_YELLOW, 2, LED_ON_MS, LED_GAP_MS, 1000},
+};
+
+/* LED pins from the gpio-leds nodes */
+static const uint32_t led_pins[LED_COLOR_COUNT] = {
+    [LED_GREEN] = NRF_DT_GPIOS_TO_PSEL(DT_NODELABEL(led0), gpios),
+    [LED_YELLOW] = NRF_DT_GPIOS_TO_PSEL(DT_NODELABEL(led1), gpios),
+};
+
+#if defined(NRFX_GPIOTE_INSTANCE)
+static const nrfx_gpiote_t gpiote = NRFX_GPIOTE_INSTANCE(0);
+#define GPIOTE_CHANNEL_ALLOC(ch) nrfx_gpiote_channel_alloc(&gpiote, ch)
+#else
+#define GPIOTE_CHANNEL_ALLOC(ch) nrfx_gpiote_channel_alloc(ch)
+#endif
+
+static uint8_t gpiote_ch[LED_COLOR_COUNT];
+static nrf_ppi_channel_t ppi_ch[LED_EDGES];
+static bool led_ready;
+
+/* Requested signals, bit per enum led_signal */
+static atomic_t requested = ATOMIC_INIT(BIT(LED_SIGNAL_IDLE));
+static bool enabled = true;
+static int playing = -1;
+static K_MUTEX_DEFINE(led_mutex);
+
+/* RTC2 has no driver instance, only the time a pattern runs is counted */
+PERIPH_USAGE_DEFINE(led_usage, "led rtc");
+
+static uint32_t ms_to_ticks(uint32_t ms) {
+    uint32_t ticks = (uint32_t)(((uint64_t)ms * LED_RTC_HZ + 500) / 1000);
+
+    return ticks ? ticks : 1;
+}
+
+/* Stop the counter and the routing, LEDs off */
+static void pattern_stop(void) {
+    nrf_rtc_task_trigger(LED_RTC, NRF_RTC_TASK_STOP);
+    for (int i = 0; i < LED_EDGES; i++) {
+        nrfx_ppi_channel_disable(ppi_ch[i]);
     }
-    /* Wait for a specified time before turning LED off */
-    k_sleep(K_MSEC(LED_TIME_MS));
+    for (int c = 0; c < LED_COLOR_COUNT; c++) {
+        nrf_gpiote_task_trigger(NRF_GPIOTE,
+                                nrf_gpiote_clr_task_get(gpiote_ch[c]));
+    }
+    nrf_rtc_task_trigger(LED_RTC, NRF_RTC_TASK_CLEAR);
+}
 
-    /* Turn LED off */
-    led_off(led_pwm_device, led_color);
+static void pattern_start(const struct led_pattern *p) {
+    uint32_t toggle = nrf_gpiote_task_address_get(
+        NRF_GPIOTE, nrf_gpiote_out_task_get(gpiote_ch[p->color]));
+    /* Edges inside the period: off, then on and off again for the second
+     * flash; the last edge turns the LED on and starts the next period */
+    uint32_t edge_ms[LED_EDGES] = {
+        p->on_ms,
+        p->on_ms + p->gap_ms,
+        2 * p->on_ms + p->gap_ms,
+        p->period_ms,
+    };
+    int used = p->flashes == 2 ? 3 : 1;
 
-    return 0;
+    for (int i = 0; i < LED_EDGES; i++) {
+        bool enable = i < used || i == LED_EDGE_LAST;
+
+        nrf_rtc_cc_set(LED_RTC, i, ms_to_ticks(edge_ms[i]));
+        nrfx_ppi_channel_assign(
+            ppi_ch[i],
+            nrf_rtc_event_address_get(LED_RTC, nrf_rtc_compare_event_get(i)),
+            toggle);
+        if (enable) {
+            nrfx_ppi_channel_enable(ppi_ch[i]);
+        }
+    }
+
+    /* First flash right away */
+    nrf_gpiote_task_trigger(NRF_GPIOTE,
+                            nrf_gpiote_set_task_get(gpiote_ch[p->color]));
+    nrf_rtc_task_trigger(LED_RTC, NRF_RTC_TASK_START);
 }
 
-/**
- * @brief LED thread function that illuminates the LED based on the battery
- * status at the interval of LED_THREAD_SLEEP_INTERVAL.
- */
-static void led_thread_fn(void) {
-    /* Check if the LED device is ready */
-    if (!device_is_ready(led_pwm_device)) {
-        LOG_ERR("Device %s is not ready", led_pwm_device->name);
+/* Play the highest priority requested signal */
+static void update_pattern(void) {
+    uint32_t mask = enabled ? atomic_get(&requested) : 0;
+    int signal = mask ? 31 - __builtin_clz(mask) : -1;
+
+    if (!led_ready || signal == playing) {
+        return;
+    }
+
+    pattern_stop();
+    if (playing >= 0) {
+        periph_usage_put(&led_usage, NULL);
+    }
+    if (signal >= 0) {
+        periph_usage_get(&led_usage, NULL);
+        pattern_start(&patterns[signal]);
+    }
+    LOG_DBG("signal %d -> %d", playing, signal);
+    playing = signal;
+}
+
+void led_signal_set(enum led_signal signal, bool active) {
+    if (signal >= LED_SIGNAL_COUNT) {
         return;
     }
 
-    while (1) {
-        /* Get the battery percentage */
-        // enum led_device_state led_color = (get_battery_percent().val1 >= 20)
-        // 					  ? LED_STATE_STABLE_BATTERY
-        // 					  : LED_STATE_LOW_BATTERY;
+    bool was = active ? atomic_test_and_set_bit(&requested, signal)
+                      : atomic_test_and_clear_bit(&requested, signal);
+
+    if (was == active) {
+        return;
+    }
+
+    k_mutex_lock(&led_mutex, K_FOREVER);
+    update_pattern();
+    k_mutex_unlock(&led_mutex);
+}
+
+void led_set_enabled(bool enable) {
+    k_mutex_lock(&led_mutex, K_FOREVER);
+    enabled = enable;
+    update_pattern();
+    k_mutex_unlock(&led_mutex);
+}
+
+void led_shutdown(void) {
+    if (!led_ready) {
+        return;
+    }
+    pattern_stop();
+    if (playing >= 0) {
+        periph_usage_put(&led_usage, NULL);
+        playing = -1;
+    }
+    for (int c = 0; c < LED_COLOR_COUNT; c++) {
+        nrf_gpiote_te_default(NRF_GPIOTE, gpiote_ch[c]);
+    }
+    led_ready = false;
+}
 
-        enum led_device_state led_color = LED_STATE_STABLE_BATTERY;
+/**
+ * @brief Allocate the GPIOTE and PPI channels and start the idle signal.
+ */
+static int led_init(void) {
+    for (int c = 0; c < LED_COLOR_COUNT; c++) {
+        if (GPIOTE_CHANNEL_ALLOC(&gpiote_ch[c]) != NRFX_SUCCESS) {
+            LOG_ERR("No GPIOTE channel for LED %d", c);
+            return -ENOMEM;
+        }
+        nrf_gpiote_task_configure(NRF_GPIOTE, gpiote_ch[c], led_pins[c],
+                                  NRF_GPIOTE_POLARITY_TOGGLE,
+                                  NRF_GPIOTE_INITIAL_VALUE_LOW);
+        nrf_gpiote_task_enable(NRF_GPIOTE, gpiote_ch[c]);
+    }
 
-        /* Activate the LED with the appropriate color based on the battery
-         * status */
-        control_led((uint32_t)led_color);
-        /* Wait for LED_THREAD_SLEEP_INTERVAL before checking battery status */
-        k_sleep(K_SECONDS(LED_THREAD_SLEEP_INTERVAL));
+    for (int i = 0; i < LED_EDGES; i++) {
+        if (nrfx_ppi_channel_alloc(&ppi_ch[i]) != NRFX_SUCCESS) {
+            LOG_ERR("No PPI channel for LED edge %d", i);
+            return -ENOMEM;
+        }
     }
+    /* The last edge also starts the next period */
+    nrfx_ppi_channel_fork_assign(
+        ppi_ch[LED_EDGE_LAST],
+        nrf_rtc_task_address_get(LED_RTC, NRF_RTC_TASK_CLEAR));
+
+    nrf_rtc_prescaler_set(LED_RTC, LED_RTC_PRESCALER);
+    nrf_rtc_event_enable(LED_RTC, NRF_RTC_INT_COMPARE0_MASK |
+                                      NRF_RTC_INT_COMPARE1_MASK |
+                                      NRF_RTC_INT_COMPARE2_MASK |
+                                      NRF_RTC_INT_COMPARE3_MASK);
+
+    k_mutex_lock(&led_mutex, K_FOREVER);
+    led_ready = true;
+    update_pattern();
+    k_mutex_unlock(&led_mutex);
+    return 0;
 }
 
-/* Define the stack size and priority for the LED thread */
-#define STACK_SIZE 1024
-#define PRIORITY 6
-/* Define the thread for the LED */
-K_THREAD_DEFINE(led_id, STACK_SIZE, led_thread_fn, NULL, NULL, NULL, PRIORITY,
-                0, 0);
+SYS_INIT(led_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,53 @@
+#ifndef __APP_LED_H__
+#define __APP_LED_H__
+
+#include <stdbool.h>
+
+/**
+ * @file src/led.h
+ *
+ * @brief Status LED signals played by hardware.
+ *
+ * Modules request a signal and the LED plays the pattern of the highest priority active one. A
+ * pattern runs on RTC2 compare events routed through PPI to a GPIOTE toggle of the LED pin, so
+ * once armed it needs neither the CPU nor the high frequency clock.
+ */
+
+/** Signals, in increasing priority. */
+enum led_signal {
+	/** Green blink every 10 s, the device is running. Active from boot. */
+	LED_SIGNAL_IDLE,
+	/** Yellow double blink every 10 s. */
+	LED_SIGNAL_LOW_BATTERY,
+	/** Yellow blink every second, the BME680 did not start; gas goes on uncompensated. */
+	LED_SIGNAL_SENSOR_FAULT,
+	/** Yellow double blink every second, a gas cell reports a fault. */
+	LED_SIGNAL_FAULT,
+	LED_SIGNAL_COUNT,
+};
+
+/**
+ * @brief Request or withdraw a signal.
+ *
+ * Cheap when the state does not change, callable from threads and work items.
+ *
+ * @param signal The signal.
+ * @param active True to request, false to withdraw.
+ */
+void led_signal_set(enum led_signal signal, bool active);
+
+/**
+ * @brief Allow or silence the LED.
+ *
+ * Silenced, no pattern plays; requests are still recorded and play again once allowed.
+ *
+ * @param enable False to keep the LED off.
+ */
+void led_set_enabled(bool enable);
+
+/**
+ * @brief Stop the pattern and release the LED pins to GPIO, before System OFF.
+ */
+void led_shutdown(void);
+
+#endif // __APP_LED_H__
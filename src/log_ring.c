@@ -0,0 +1,179 @@
+/**
+ * @file src/log_ring.c - binary log records kept in RAM
+ *
+ * @brief A message is formatted by the dictionary output into a record buffer and copied to the
+ * ring only when it fits whole, so the host never sees half a record. The count of dropped
+ * messages goes in front of the next record that fits.
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log_backend.h>
+#include <zephyr/logging/log_backend_std.h>
+#include <zephyr/logging/log_core.h>
+#include <zephyr/logging/log_msg.h>
+#include <zephyr/logging/log_output.h>
+#include <zephyr/logging/log_output_dict.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+#include "log_ring.h"
+#include "retained.h"
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_APP_LOG_RING_SIZE), "Log ring size must be a power of two");
+BUILD_ASSERT(!IS_ENABLED(CONFIG_LOG_RUNTIME_FILTERING),
+	     "Rate limits are indexed by the constant log sources");
+
+/* "LRNG" */
+#define LOG_RING_MAGIC 0x4c524e47U
+#define LOG_RING_MASK  (CONFIG_APP_LOG_RING_SIZE - 1)
+
+/* Not cleared at boot, checked by log_ring_init(), must fit retained_ram with the others */
+static __retained struct {
+	uint32_t magic;
+	/* Free running, head - tail bytes are stored */
+	uint32_t head;
+	uint32_t tail;
+	uint8_t data[CONFIG_APP_LOG_RING_SIZE];
+} ring;
+
+static struct k_spinlock ring_lock;
+
+/* Record of the message being processed, log thread only */
+static uint8_t record[CONFIG_APP_LOG_RING_RECORD_MAX];
+static size_t record_len;
+static bool record_overflow;
+static uint32_t dropped;
+
+struct rate_state {
+	uint16_t window;
+	uint8_t count;
+};
+
+/* Per log source, the sources above the array share the last entry */
+static struct rate_state rates[CONFIG_APP_LOG_RING_RATE_SOURCES];
+
+static int record_out(uint8_t *data, size_t length, void *ctx)
+{
+	ARG_UNUSED(ctx);
+
+	if (record_len + length > sizeof(record)) {
+		record_overflow = true;
+	} else {
+		memcpy(record + record_len, data, length);
+		record_len += length;
+	}
+	return length;
+}
+
+static uint8_t output_buf[32];
+LOG_OUTPUT_DEFINE(log_output_ring, record_out, output_buf, sizeof(output_buf));
+
+static bool ring_put(const uint8_t *data, size_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&ring_lock);
+	bool fits = sizeof(ring.data) - (ring.head - ring.tail) >= len;
+
+	if (fits) {
+		for (size_t i = 0; i < len; i++) {
+			ring.data[(ring.head + i) & LOG_RING_MASK] = data[i];
+		}
+		ring.head += len;
+	}
+	k_spin_unlock(&ring_lock, key);
+	return fits;
+}
+
+size_t log_ring_read(uint8_t *buf, size_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&ring_lock);
+	size_t n = MIN(len, ring.head - ring.tail);
+
+	for (size_t i = 0; i < n; i++) {
+		buf[i] = ring.data[(ring.tail + i) & LOG_RING_MASK];
+	}
+	ring.tail += n;
+	k_spin_unlock(&ring_lock, key);
+	return n;
+}
+
+static bool rate_allowed(struct log_msg *msg)
+{
+	const void *source = log_msg_get_source(msg);
+
+	if (source == NULL) {
+		return true;
+	}
+
+	uint32_t id = MIN(log_const_source_id(source), ARRAY_SIZE(rates) - 1);
+	uint16_t window = k_uptime_get() / (CONFIG_APP_LOG_RING_RATE_WINDOW_SEC * MSEC_PER_SEC);
+	struct rate_state *rate = &rates[id];
+
+	if (rate->window != window) {
+		rate->window = window;
+		rate->count = 0;
+	}
+	if (rate->count >= CONFIG_APP_LOG_RING_RATE_BURST) {
+		return false;
+	}
+	rate->count++;
+	return true;
+}
+
+static void log_ring_process(const struct log_backend *const backend, union log_msg_generic *msg)
+{
+	ARG_UNUSED(backend);
+
+	if (!rate_allowed(&msg->log)) {
+		dropped++;
+		return;
+	}
+
+	record_len = 0;
+	record_overflow = false;
+	if (dropped != 0) {
+		log_dict_output_dropped_process(&log_output_ring, dropped);
+	}
+	log_dict_output_msg_process(&log_output_ring, &msg->log, log_backend_std_get_flags());
+
+	if (!record_overflow && ring_put(record, record_len)) {
+		dropped = 0;
+	} else {
+		dropped++;
+	}
+}
+
+static void log_ring_dropped(const struct log_backend *const backend, uint32_t cnt)
+{
+	ARG_UNUSED(backend);
+	dropped += cnt;
+}
+
+/* Records are already written synchronously, nothing changes in panic mode */
+static void log_ring_panic(const struct log_backend *const backend)
+{
+	ARG_UNUSED(backend);
+}
+
+static void log_ring_init(const struct log_backend *const backend)
+{
+	ARG_UNUSED(backend);
+
+	/* Kept through a warm reset, garbage after power on or System OFF */
+	if (ring.magic != LOG_RING_MAGIC || ring.head - ring.tail > sizeof(ring.data)) {
+		ring.head = 0;
+		ring.tail = 0;
+		ring.magic = LOG_RING_MAGIC;
+	}
+}
+
+static const struct log_backend_api log_ring_api = {
+	.process = log_ring_process,
+	.dropped = log_ring_dropped,
+	.panic = log_ring_panic,
+	.init = log_ring_init,
+};
+
+LOG_BACKEND_DEFINE(log_backend_ring, log_ring_api, true);
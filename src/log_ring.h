@@ -0,0 +1,33 @@
+/**
+ * @file src/log_ring.h - binary log records kept in RAM
+ *
+ * @brief Log backend for field builds, CONFIG_APP_LOG_RING.
+ *
+ * Messages are stored in Zephyr's dictionary format: the address of the format string and the
+ * raw arguments instead of the text, formatted on a host by tools/log_decode/log_decode.py with
+ * build/zephyr/log_dictionary.json of the same build. Each log module may write
+ * CONFIG_APP_LOG_RING_RATE_BURST messages per CONFIG_APP_LOG_RING_RATE_WINDOW_SEC; the others are
+ * counted as dropped, like messages that do not fit. When the ring is full new messages are
+ * dropped, the first error of a storm is the one worth keeping.
+ *
+ * The ring is not initialized at boot when it is intact, so the messages before a watchdog reset
+ * or a fatal error can still be read after it. "DLOG" on the write characteristic drains it.
+ */
+#ifndef __APP_LOG_RING_H__
+#define __APP_LOG_RING_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Take the oldest bytes out of the ring.
+ *
+ * Records may be split between two reads; the decoder joins them.
+ *
+ * @param buf Destination.
+ * @param len Size of @p buf.
+ * @return Bytes copied, 0 when the ring is empty.
+ */
+size_t log_ring_read(uint8_t *buf, size_t len);
+
+#endif // __APP_LOG_RING_H__
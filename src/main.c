@@ -10,7 +10,6 @@
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/hwinfo.h>
-#include <zephyr/drivers/watchdog.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/pm/pm.h>
@@ -18,6 +17,8 @@
 #include <zephyr/sys/reboot.h>
 
 #include "gas.h"
+#include "led.h"
+#include "power_down.h"
 #include "version.h"
 
 /* ───── 설정 값 ───── */
@@ -38,33 +39,6 @@ static void long_press_handler(struct k_timer *timer) {
     off_pending = true; /* 뗐을 때 끌 것 */
 }
 
-/* 전원 끄기 전 GPIO 핀을 연결 해제하여 누설 전류를 최소화합니다. */
-static void configure_gpios_for_poweroff(void) {
-    const struct device *const gpio0 = DEVICE_DT_GET(DT_NODELABEL(gpio0));
-
-    if (!device_is_ready(gpio0)) {
-        printk("GPIO0 not ready\n");
-        return;
-    }
-
-    for (uint8_t pin = 0; pin < 32; pin++) {
-        switch (pin) {
-        case 31: /* wake-up 버튼 – 건드리지 않음 */
-            break;
-
-        case 29: /* VBATT 전원 스위치 및 LED 게이트 전원 차단 */
-        case 26: /* LED 게이트는 VBATT 스위치를 Low 로 당겨 공유 차단 */
-        case 27: /* LED 게이트는 VBATT 스위치를 Low 로 당겨 공유 차단 */
-            gpio_pin_configure(gpio0, 29, GPIO_OUTPUT_LOW);
-            break;
-
-        default: /* 나머지 – 완전 Hi-Z */
-            gpio_pin_configure(gpio0, pin, GPIO_DISCONNECTED);
-            break;
-        }
-    }
-}
-
 static void button_cb(const struct device *dev, struct gpio_callback *cb,
                       uint32_t pins) {
     bool val = gpio_pin_get_dt(&sw0);
@@ -82,7 +56,12 @@ static void button_cb(const struct device *dev, struct gpio_callback *cb,
             /* 깨우기용: 다음 Rising(High) 에 반응 */
             gpio_pin_interrupt_configure_dt(&sw0, GPIO_INT_LEVEL_ACTIVE);
 
-            configure_gpios_for_poweroff();
+            /* 보정 상태를 유지 RAM 에 봉인, 깨어나면 이어서 씀 */
+            gas_retain();
+
+            /* LED 핀을 GPIOTE 에서 GPIO 로 되돌린 뒤 devicetree 의 hhs,power-down 대로 정리 */
+            led_shutdown();
+            power_down();
 
             hwinfo_clear_reset_cause();
             sys_poweroff(); /* System-OFF, 전류 ≈ 0.3 µA */
@@ -138,68 +117,3 @@ int main(void) {
 
     return 0;
 }
-
-#if DT_HAS_COMPAT_STATUS_OKAY(nordic_nrf_wdt)
-/* Maximum and minimum window for watchdog timer in milliseconds */
-#define WDT_MAX_WINDOW 5000U
-#define WDT_MIN_WINDOW 0U
-
-/* Interval for feeding the watchdog timer(ms) */
-#define WDT_FEED_INTERVAL 1000U
-
-/* Option for watchdog timer */
-#define WDT_OPER_MODE WDT_OPT_PAUSE_HALTED_BY_DBG
-#endif
-
-/**
- * @brief Watchdog thread function.
- *
- * This function sets up the watchdog timer and continuously feeds it.
- */
-static void watchdog_thread_fn(void) {
-    int setup_error_status;  // wdt_setup 결과 코드 저장
-    int watchdog_channel_id; // 설치된 watchdog 채널 식별자
-    const struct device *const watchdog_device =
-        DEVICE_DT_GET(DT_ALIAS(watchdog0)); // watchdog 주변장치 핸들
-
-    // Check if the device is ready before proceeding
-    if (!device_is_ready(watchdog_device)) {
-        LOG_ERR("%s: device not ready.\n", watchdog_device->name);
-        return;
-    }
-
-    struct wdt_timeout_cfg watchdog_configuration = {
-        /* Reset SoC when watchdog timer expires. */
-        .flags = WDT_FLAG_RESET_SOC,
-
-        /* Expire watchdog after max window */
-        .window.min = WDT_MIN_WINDOW,
-        .window.max = WDT_MAX_WINDOW,
-    };
-
-    // Install timeout for the watchdog
-    watchdog_channel_id =
-        wdt_install_timeout(watchdog_device, &watchdog_configuration);
-    if (watchdog_channel_id < 0) {
-        LOG_ERR("Error installing watchdog timeout\n");
-        return;
-    }
-
-    // Set up the watchdog
-    setup_error_status = wdt_setup(watchdog_device, WDT_OPER_MODE);
-    if (setup_error_status < 0) {
-        printk("Error setting up watchdog\n");
-        return;
-    }
-
-    // Feed the watchdog
-    while (1) {
-        wdt_feed(watchdog_device, watchdog_channel_id);
-        k_sleep(K_MSEC(WDT_FEED_INTERVAL));
-    }
-}
-
-#define STACKSIZE 1024
-#define PRIORITY 14
-K_THREAD_DEFINE(watchdog_thread_id, STACKSIZE, watchdog_thread_fn, NULL, NULL,
-                NULL, PRIORITY, 0, 0);
@@ -0,0 +1,198 @@
+/**
+ * @file src/median_filter.c - sliding window median and Hampel filter
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "median_filter.h"
+
+/* Value of a heap entry */
+#define LO_VAL(f, i) ((f)->ring[(f)->lo[i]])
+#define HI_VAL(f, i) ((f)->ring[(f)->hi[i]])
+
+static inline void lo_set(struct median_filter *f, int i, uint8_t slot)
+{
+	f->lo[i] = slot;
+	f->pos[slot] = -(i + 1);
+}
+
+static inline void hi_set(struct median_filter *f, int i, uint8_t slot)
+{
+	f->hi[i] = slot;
+	f->pos[slot] = i;
+}
+
+/* Lower half, max-heap */
+static int lo_sift_up(struct median_filter *f, int i)
+{
+	uint8_t slot = f->lo[i];
+
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+
+		if (LO_VAL(f, parent) >= f->ring[slot]) {
+			break;
+		}
+		lo_set(f, i, f->lo[parent]);
+		i = parent;
+	}
+	lo_set(f, i, slot);
+	return i;
+}
+
+static void lo_sift_down(struct median_filter *f, int i)
+{
+	uint8_t slot = f->lo[i];
+
+	for (;;) {
+		int child = 2 * i + 1;
+
+		if (child >= f->lo_n) {
+			break;
+		}
+		if (child + 1 < f->lo_n && LO_VAL(f, child + 1) > LO_VAL(f, child)) {
+			child++;
+		}
+		if (LO_VAL(f, child) <= f->ring[slot]) {
+			break;
+		}
+		lo_set(f, i, f->lo[child]);
+		i = child;
+	}
+	lo_set(f, i, slot);
+}
+
+/* Upper half, min-heap */
+static int hi_sift_up(struct median_filter *f, int i)
+{
+	uint8_t slot = f->hi[i];
+
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+
+		if (HI_VAL(f, parent) <= f->ring[slot]) {
+			break;
+		}
+		hi_set(f, i, f->hi[parent]);
+		i = parent;
+	}
+	hi_set(f, i, slot);
+	return i;
+}
+
+static void hi_sift_down(struct median_filter *f, int i)
+{
+	uint8_t slot = f->hi[i];
+
+	for (;;) {
+		int child = 2 * i + 1;
+
+		if (child >= f->hi_n) {
+			break;
+		}
+		if (child + 1 < f->hi_n && HI_VAL(f, child + 1) < HI_VAL(f, child)) {
+			child++;
+		}
+		if (HI_VAL(f, child) >= f->ring[slot]) {
+			break;
+		}
+		hi_set(f, i, f->hi[child]);
+		i = child;
+	}
+	hi_set(f, i, slot);
+}
+
+/* Swap the two heap tops when they are out of order */
+static void exchange_tops(struct median_filter *f)
+{
+	if (f->lo_n == 0 || f->hi_n == 0 || LO_VAL(f, 0) <= HI_VAL(f, 0)) {
+		return;
+	}
+
+	uint8_t lo_top = f->lo[0];
+	uint8_t hi_top = f->hi[0];
+
+	lo_set(f, 0, hi_top);
+	hi_set(f, 0, lo_top);
+	lo_sift_down(f, 0);
+	hi_sift_down(f, 0);
+}
+
+void median_filter_init(struct median_filter *f, uint8_t len)
+{
+	memset(f, 0, sizeof(*f));
+	f->len = len < 1 ? 1 : (len > MEDIAN_FILTER_MAX_LEN ? MEDIAN_FILTER_MAX_LEN : len);
+}
+
+void median_filter_push(struct median_filter *f, int32_t x)
+{
+	uint8_t slot = f->head;
+
+	f->head = (f->head + 1) % f->len;
+
+	if (f->count == f->len) {
+		/* Full window: overwrite the oldest sample where it sits in its heap */
+		int p = f->pos[slot];
+
+		f->ring[slot] = x;
+		if (p < 0) {
+			p = -p - 1;
+			lo_sift_down(f, lo_sift_up(f, p));
+		} else {
+			hi_sift_down(f, hi_sift_up(f, p));
+		}
+		exchange_tops(f);
+		return;
+	}
+
+	/* Growing window: lower heap holds the extra sample of an odd count */
+	f->ring[slot] = x;
+	f->count++;
+	if (f->lo_n == f->hi_n) {
+		lo_set(f, f->lo_n++, slot);
+		lo_sift_up(f, f->lo_n - 1);
+	} else {
+		hi_set(f, f->hi_n++, slot);
+		hi_sift_up(f, f->hi_n - 1);
+	}
+	exchange_tops(f);
+}
+
+int32_t median_filter_get(const struct median_filter *f)
+{
+	if (f->count == 0) {
+		return 0;
+	}
+	if (f->lo_n > f->hi_n) {
+		return LO_VAL(f, 0);
+	}
+	return (LO_VAL(f, 0) + HI_VAL(f, 0)) / 2;
+}
+
+void hampel_filter_init(struct hampel_filter *h, uint8_t len, float k)
+{
+	median_filter_init(&h->value, len);
+	median_filter_init(&h->deviation, len);
+	h->k = k;
+}
+
+int32_t hampel_filter_apply(struct hampel_filter *h, int32_t x)
+{
+	median_filter_push(&h->value, x);
+
+	int32_t med = median_filter_get(&h->value);
+	int32_t dev = abs(x - med);
+
+	median_filter_push(&h->deviation, dev);
+
+	/* Too few samples for a meaningful spread */
+	if (median_filter_count(&h->value) < 3) {
+		return x;
+	}
+
+	/* Integer samples of a quiet signal give a MAD of 0, keep one count of spread */
+	int32_t mad = median_filter_get(&h->deviation);
+	float limit = h->k * MEDIAN_FILTER_MAD_SCALE * (float)(mad < 1 ? 1 : mad);
+
+	return ((float)dev > limit) ? med : x;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file src/median_filter.h - sliding window median and Hampel filter
+ *
+ * @brief Running median over the last N samples in O(log N) per sample.
+ *
+ * The window is kept in two heaps, a max-heap holding the lower half and a min-heap holding the
+ * upper half, plus a ring of the samples in arrival order. Every ring slot knows its heap
+ * position, so the oldest sample is replaced in place and sifted instead of searched for. All
+ * storage is inside the struct, no allocation. No kernel dependency, the filter also builds on
+ * host.
+ */
+#ifndef __APP_MEDIAN_FILTER_H__
+#define __APP_MEDIAN_FILTER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Largest supported window. */
+#define MEDIAN_FILTER_MAX_LEN 63
+
+/** Scale from median absolute deviation to standard deviation for gaussian data. */
+#define MEDIAN_FILTER_MAD_SCALE 1.4826f
+
+/** Sliding median state. */
+struct median_filter {
+	/* samples in arrival order */
+	int32_t ring[MEDIAN_FILTER_MAX_LEN];
+	/* heap position of each ring slot, negative in the lower heap: -(pos + 1) */
+	int8_t pos[MEDIAN_FILTER_MAX_LEN];
+	/* ring slots, lower half as max-heap and upper half as min-heap */
+	uint8_t lo[(MEDIAN_FILTER_MAX_LEN + 1) / 2];
+	uint8_t hi[MEDIAN_FILTER_MAX_LEN / 2];
+	uint8_t lo_n;
+	uint8_t hi_n;
+	uint8_t len;
+	uint8_t head;
+	uint8_t count;
+};
+
+/** Hampel outlier filter: median and median absolute deviation of a sliding window. */
+struct hampel_filter {
+	struct median_filter value;
+	/* |x - median| of each sample against the median at its arrival */
+	struct median_filter deviation;
+	float k;
+};
+
+/**
+ * @brief Set up an empty window.
+ *
+ * @param f Filter state.
+ * @param len Window length, 1..MEDIAN_FILTER_MAX_LEN, clamped.
+ */
+void median_filter_init(struct median_filter *f, uint8_t len);
+
+/**
+ * @brief Add a sample, evicting the oldest one once the window is full.
+ *
+ * @param f Filter state.
+ * @param x Sample.
+ */
+void median_filter_push(struct median_filter *f, int32_t x);
+
+/**
+ * @brief Median of the window.
+ *
+ * For an even count this is the truncated mean of the two middle samples.
+ *
+ * @param f Filter state.
+ *
+ * @return Median, 0 while the window is empty.
+ */
+int32_t median_filter_get(const struct median_filter *f);
+
+/**
+ * @brief Number of samples in the window.
+ */
+static inline uint8_t median_filter_count(const struct median_filter *f)
+{
+	return f->count;
+}
+
+/**
+ * @brief Set up a Hampel filter.
+ *
+ * @param h Filter state.
+ * @param len Window length.
+ * @param k Rejection threshold in (MAD based) standard deviations.
+ */
+void hampel_filter_init(struct hampel_filter *h, uint8_t len, float k);
+
+/**
+ * @brief Run one sample through the Hampel filter.
+ *
+ * The sample enters the window either way. It is replaced by the window median when it is further
+ * than k * 1.4826 * MAD from it. The MAD is tracked as the running median of each sample's
+ * deviation from the median at its arrival, which keeps the update O(log N); it follows the exact
+ * MAD closely while the window median moves slowly.
+ *
+ * @param h Filter state.
+ * @param x Sample.
+ *
+ * @return x, or the window median when x is an outlier.
+ */
+int32_t hampel_filter_apply(struct hampel_filter *h, int32_t x);
+
+#endif // __APP_MEDIAN_FILTER_H__
@@ -0,0 +1,166 @@
+/**
+ * @file src/perf_shell.c - live performance counters on the shell
+ *
+ * @brief "perf" shell commands for profiling a unit in the field, over the BLE NUS or RTT shell
+ * backend of shell.conf. The commands only read counters the measurement code keeps anyway and
+ * pause CONFIG_APP_PERF_SHELL_LINE_DELAY_MS after every line, so the output spreads over several
+ * connection events instead of crowding the radio next to a reading. The shell thread runs below
+ * the measurement threads (shell.conf).
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/shell/shell.h>
+
+#include "battery.h"
+#include "bme680_app.h"
+#include "gas.h"
+
+/* Rows of "perf adc", one per default measurement period */
+#define ADC_ROWS_MAX     60
+#define ADC_ROW_INTERVAL K_MSEC(2000)
+
+static void line_pause(void)
+{
+	k_msleep(CONFIG_APP_PERF_SHELL_LINE_DELAY_MS);
+}
+
+struct threads_ctx {
+	const struct shell *sh;
+	uint64_t total;
+};
+
+static void print_thread(const struct k_thread *thread, void *user_data)
+{
+	struct threads_ctx *ctx = user_data;
+	k_thread_runtime_stats_t rt;
+	const char *name = k_thread_name_get((k_tid_t)thread);
+
+	if (k_thread_runtime_stats_get((k_tid_t)thread, &rt) != 0) {
+		return;
+	}
+	shell_print(ctx->sh, "%-20s %10u ms %3u.%u %%", name ? name : "?",
+		    (uint32_t)k_cyc_to_ms_floor64(rt.execution_cycles),
+		    (uint32_t)(rt.execution_cycles * 100 / ctx->total),
+		    (uint32_t)(rt.execution_cycles * 1000 / ctx->total % 10));
+	line_pause();
+}
+
+static int cmd_threads(const struct shell *sh, size_t argc, char **argv)
+{
+	k_thread_runtime_stats_t all;
+	struct threads_ctx ctx = {.sh = sh};
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	if (k_thread_runtime_stats_all_get(&all) != 0 || all.execution_cycles == 0) {
+		return -ENODATA;
+	}
+	ctx.total = all.execution_cycles;
+	shell_print(sh, "%-20s %13s %7s", "thread", "run time", "cpu");
+	line_pause();
+	k_thread_foreach_unlocked(print_thread, &ctx);
+	return 0;
+}
+
+static int cmd_gas(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(sh, "%-8s %8s %14s %14s", "channel", "samples", "adc avg/max us",
+		    "dsp avg/max us");
+	for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+		struct gas_channel_stats st;
+
+		if (gas_channel_get_stats(i, &st) < 0 || st.samples == 0) {
+			continue;
+		}
+		shell_print(sh, "%-8s %8u %6u/%-7u %6u/%-7u", gas_channel_name(i), st.samples,
+			    k_cyc_to_us_floor32(st.adc_cycles / st.samples),
+			    k_cyc_to_us_floor32(st.adc_cycles_max),
+			    k_cyc_to_us_floor32(st.dsp_cycles / st.samples),
+			    k_cyc_to_us_floor32(st.dsp_cycles_max));
+		line_pause();
+	}
+	return 0;
+}
+
+static int cmd_adc(const struct shell *sh, size_t argc, char **argv)
+{
+	int rows = argc > 1 ? CLAMP(atoi(argv[1]), 1, ADC_ROWS_MAX) : 1;
+
+	for (int r = 0; r < rows; r++) {
+		char line[GAS_CHANNEL_COUNT * sizeof("NO2 65535 mV 6553.5  ")];
+		int len = 0;
+
+		if (r > 0) {
+			k_sleep(ADC_ROW_INTERVAL);
+		}
+		for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+			struct gas_sensor_value gas = get_gas_data(i);
+
+			len += snprintf(line + len, sizeof(line) - len, "%s %u mV %u.%u  ",
+					gas_channel_name(i), gas.raw, gas.val1, gas.val2);
+			len = MIN(len, sizeof(line) - 1);
+		}
+		shell_print(sh, "%s", line);
+	}
+	return 0;
+}
+
+static int cmd_energy(const struct shell *sh, size_t argc, char **argv)
+{
+	struct battery_value soc = get_battery_percent();
+	uint32_t tte_min = get_battery_time_to_empty();
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(sh, "battery   %u.%u %%", soc.val1, soc.val2);
+	line_pause();
+	shell_print(sh, "average   %u uA", get_battery_avg_current());
+	line_pause();
+	if (tte_min == UINT32_MAX) {
+		shell_print(sh, "empty in  -");
+	} else {
+		shell_print(sh, "empty in  %u d %u h", tte_min / (24 * 60), tte_min / 60 % 24);
+	}
+	line_pause();
+	shell_print(sh, "tier      %s", get_battery_power_tier());
+	return 0;
+}
+
+static int cmd_bsec(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+#if defined(CONFIG_BME68X)
+	uint32_t last_us;
+	uint32_t max_us;
+	int err = bme680_get_step_time(&last_us, &max_us);
+
+	if (err < 0) {
+		return err;
+	}
+	shell_print(sh, "bsec_do_steps last %u us, max %u us", last_us, max_us);
+	return 0;
+#else
+	return -ENOTSUP;
+#endif // CONFIG_BME68X
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	perf_cmds, SHELL_CMD(threads, NULL, "CPU time per thread since boot", cmd_threads),
+	SHELL_CMD(gas, NULL, "ADC and signal processing time per gas channel", cmd_gas),
+	SHELL_CMD_ARG(adc, NULL, "Last gas readings [rows, 2 s apart]", cmd_adc, 1, 1),
+	SHELL_CMD(energy, NULL, "Fuel gauge estimate and power tier", cmd_energy),
+	SHELL_COND_CMD(CONFIG_BME68X, bsec, NULL, "BSEC processing time per sample", cmd_bsec),
+	SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(perf, &perf_cmds, "Performance counters", NULL);
@@ -0,0 +1,117 @@
+/**
+ * @file src/periph_usage.c - peripheral active time report
+ *
+ * @brief Every CONFIG_APP_PERIPH_USAGE_PERIOD_SEC the records of include/periph_usage.h are
+ * read and cleared, and the active time of each is logged scaled to one hour, with the number of
+ * transactions. A transaction still open at the report is split between the two periods. The last
+ * report is kept for the "periph" shell command when a shell is built in.
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+#include <periph_usage.h>
+
+#include "app_work.h"
+
+LOG_MODULE_REGISTER(PERIPH_USAGE, CONFIG_APP_LOG_LEVEL);
+
+#define SEC_PER_HOUR 3600
+
+/* Last report per record, in the order of the section */
+struct usage_report {
+	uint32_t ms_per_hour;
+	uint32_t count;
+};
+
+static struct usage_report reports[CONFIG_APP_PERIPH_USAGE_MAX];
+static int64_t period_start_ms;
+
+/* Held time and transactions since the last call, cleared */
+static void usage_take(struct periph_usage *usage, uint64_t *cycles, uint32_t *count)
+{
+	k_spinlock_key_t key = k_spin_lock(&usage->lock);
+	uint32_t now = k_cycle_get_32();
+
+	if (usage->refs > 0) {
+		usage->active_cycles += now - usage->since;
+		usage->since = now;
+	}
+	*cycles = usage->active_cycles;
+	*count = usage->count;
+	usage->active_cycles = 0;
+	usage->count = usage->refs > 0 ? 1 : 0;
+	k_spin_unlock(&usage->lock, key);
+}
+
+static void periph_usage_fn(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(periph_usage_work, periph_usage_fn);
+
+static void periph_usage_fn(struct k_work *work)
+{
+	int64_t now_ms = k_uptime_get();
+	uint64_t period_ms = MAX(now_ms - period_start_ms, 1);
+	size_t i = 0;
+
+	period_start_ms = now_ms;
+
+	STRUCT_SECTION_FOREACH(periph_usage, usage) {
+		uint64_t cycles;
+		uint32_t count;
+
+		usage_take(usage, &cycles, &count);
+
+		uint64_t active_ms = k_cyc_to_ms_near64(cycles);
+		uint32_t ms_per_hour = active_ms * SEC_PER_HOUR * MSEC_PER_SEC / period_ms;
+
+		LOG_INF("%s %u ms/h, %u uses", usage->name, ms_per_hour, count);
+		if (i < ARRAY_SIZE(reports)) {
+			reports[i] = (struct usage_report){ms_per_hour, count};
+		}
+		i++;
+	}
+	if (i > ARRAY_SIZE(reports)) {
+		LOG_WRN("%zu usage records, %zu kept", i, ARRAY_SIZE(reports));
+	}
+
+	k_work_schedule_for_queue(&app_work_q, k_work_delayable_from_work(work),
+				  K_SECONDS(CONFIG_APP_PERIPH_USAGE_PERIOD_SEC));
+}
+
+static int periph_usage_init(void)
+{
+	period_start_ms = k_uptime_get();
+	k_work_schedule_for_queue(&app_work_q, &periph_usage_work,
+				  K_SECONDS(CONFIG_APP_PERIPH_USAGE_PERIOD_SEC));
+	return 0;
+}
+
+SYS_INIT(periph_usage_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if defined(CONFIG_SHELL)
+static int cmd_periph(const struct shell *sh, size_t argc, char **argv)
+{
+	size_t i = 0;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(sh, "%-16s %8s %8s", "peripheral", "ms/h", "uses");
+	STRUCT_SECTION_FOREACH(periph_usage, usage) {
+		if (i >= ARRAY_SIZE(reports)) {
+			break;
+		}
+		shell_print(sh, "%-16s %8u %8u", usage->name, reports[i].ms_per_hour,
+			    reports[i].count);
+		i++;
+	}
+	return 0;
+}
+
+SHELL_CMD_REGISTER(periph, NULL, "Peripheral active time of the last report", cmd_periph);
+#endif
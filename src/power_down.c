@@ -0,0 +1,96 @@
+/**
+ * @file src/power_down.c - board power down before System OFF
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/pm/device.h>
+
+#include "power_down.h"
+
+LOG_MODULE_REGISTER(POWER_DOWN, CONFIG_APP_LOG_LEVEL);
+
+#define POWER_DOWN_NODE DT_COMPAT_GET_ANY_STATUS_OKAY(hhs_power_down)
+
+BUILD_ASSERT(DT_NODE_EXISTS(POWER_DOWN_NODE), "No hhs,power-down devicetree node");
+
+/* Looked up by name, a device whose driver is not built in has no struct device to link to */
+#define DEVICE_NAME_BY_IDX(node_id, prop, idx)                                                     \
+	DEVICE_DT_NAME(DT_PHANDLE_BY_IDX(node_id, prop, idx)),
+
+static const char *const device_names[] = {
+	DT_FOREACH_PROP_ELEM(POWER_DOWN_NODE, devices, DEVICE_NAME_BY_IDX)};
+
+#define GPIO_SPEC_BY_IDX(node_id, prop, idx) GPIO_DT_SPEC_GET_BY_IDX(node_id, prop, idx),
+
+static const struct gpio_dt_spec inactive_gpios[] = {
+	IF_ENABLED(DT_NODE_HAS_PROP(POWER_DOWN_NODE, inactive_gpios),
+		   (DT_FOREACH_PROP_ELEM(POWER_DOWN_NODE, inactive_gpios, GPIO_SPEC_BY_IDX)))};
+
+static const struct gpio_dt_spec keep_gpios[] = {
+	IF_ENABLED(DT_NODE_HAS_PROP(POWER_DOWN_NODE, keep_gpios),
+		   (DT_FOREACH_PROP_ELEM(POWER_DOWN_NODE, keep_gpios, GPIO_SPEC_BY_IDX)))};
+
+struct disconnect_port {
+	const struct device *dev;
+	uint8_t ngpios;
+};
+
+#define PORT_BY_IDX(node_id, prop, idx)                                                            \
+	{DEVICE_DT_GET(DT_PHANDLE_BY_IDX(node_id, prop, idx)),                                     \
+	 DT_PROP(DT_PHANDLE_BY_IDX(node_id, prop, idx), ngpios)},
+
+static const struct disconnect_port disconnect_ports[] = {
+	IF_ENABLED(DT_NODE_HAS_PROP(POWER_DOWN_NODE, disconnect_ports),
+		   (DT_FOREACH_PROP_ELEM(POWER_DOWN_NODE, disconnect_ports, PORT_BY_IDX)))};
+
+static bool listed(const struct gpio_dt_spec *specs, size_t n, const struct device *port,
+		   gpio_pin_t pin)
+{
+	for (size_t i = 0; i < n; i++) {
+		if (specs[i].port == port && specs[i].pin == pin) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void power_down(void)
+{
+	for (int i = ARRAY_SIZE(device_names) - 1; i >= 0; i--) {
+		const struct device *dev = device_get_binding(device_names[i]);
+
+		if (dev == NULL) {
+			continue;
+		}
+
+		/* -EALREADY when runtime PM suspended it, -ENOSYS for a driver without PM */
+		int err = pm_device_action_run(dev, PM_DEVICE_ACTION_SUSPEND);
+
+		if (err < 0 && err != -EALREADY && err != -ENOSYS) {
+			LOG_WRN("%s suspend failed (%d)", dev->name, err);
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(inactive_gpios); i++) {
+		gpio_pin_configure_dt(&inactive_gpios[i], GPIO_OUTPUT_INACTIVE);
+	}
+
+	for (size_t p = 0; p < ARRAY_SIZE(disconnect_ports); p++) {
+		const struct disconnect_port *port = &disconnect_ports[p];
+
+		if (!device_is_ready(port->dev)) {
+			continue;
+		}
+		for (gpio_pin_t pin = 0; pin < port->ngpios; pin++) {
+			if (listed(inactive_gpios, ARRAY_SIZE(inactive_gpios), port->dev, pin) ||
+			    listed(keep_gpios, ARRAY_SIZE(keep_gpios), port->dev, pin)) {
+				continue;
+			}
+			gpio_pin_configure(port->dev, pin, GPIO_DISCONNECTED);
+		}
+	}
+}
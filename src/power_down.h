@@ -0,0 +1,20 @@
+/**
+ * @file src/power_down.h - board power down before System OFF
+ *
+ * @brief Puts the board in its lowest current state as described by the hhs,power-down
+ * devicetree node (dts/bindings/hhs,power-down.yaml), instead of a pin loop that knows the board.
+ */
+#ifndef __APP_POWER_DOWN_H__
+#define __APP_POWER_DOWN_H__
+
+/**
+ * @brief Suspend the peripherals and park the pins.
+ *
+ * The listed devices are suspended through pm_device in reverse order, their drivers switch the
+ * pins to the pinctrl sleep state. The inactive-gpios are driven inactive and the other pins of
+ * the disconnect-ports are disconnected, except the keep-gpios. Callable from an interrupt, the
+ * caller enters System OFF right after.
+ */
+void power_down(void);
+
+#endif // __APP_POWER_DOWN_H__
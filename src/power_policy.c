@@ -0,0 +1,58 @@
+/**
+ * @file src/power_policy.c - battery tiers and what the firmware gives up in each
+ */
+#include "power_policy.h"
+
+#define DAY_MIN (24 * 60)
+
+/* clang-format off */
+const struct power_tier_row power_tiers[POWER_TIER_COUNT] = {
+	/* name       soc    tte           gas ms adv ms       ulp    led                 flush */
+	{"normal",   10000, UINT32_MAX,   2000,  250,  500,   false, POWER_LED_ALL,      false},
+	{"save",     3000,  14 * DAY_MIN, 5000,  1000, 2000,  true,  POWER_LED_ALL,      false},
+	{"low",      1500,  3 * DAY_MIN,  10000, 2000, 4000,  true,  POWER_LED_WARNINGS, true},
+	{"critical", 500,   DAY_MIN / 2,  30000, 5000, 10000, true,  POWER_LED_OFF,      true},
+};
+/* clang-format on */
+
+void power_policy_init(struct power_policy *pp)
+{
+	pp->tier = POWER_TIER_NORMAL;
+}
+
+static bool tier_reached(const struct power_tier_row *row, uint32_t soc_pptt, uint32_t tte_min)
+{
+	return soc_pptt <= row->soc_pptt || tte_min <= row->tte_min;
+}
+
+static bool tier_cleared(const struct power_tier_row *row, uint32_t soc_pptt, uint32_t tte_min)
+{
+	uint64_t tte_limit =
+		row->tte_min + (uint64_t)row->tte_min * POWER_POLICY_HYSTERESIS_TTE_PCT / 100;
+
+	return soc_pptt > row->soc_pptt + POWER_POLICY_HYSTERESIS_PPTT && tte_min > tte_limit;
+}
+
+bool power_policy_update(struct power_policy *pp, uint32_t soc_pptt, uint32_t tte_min)
+{
+	enum power_tier tier = pp->tier;
+
+	/* Down to the deepest tier whose limit is reached */
+	for (int i = POWER_TIER_COUNT - 1; i > (int)tier; i--) {
+		if (tier_reached(&power_tiers[i], soc_pptt, tte_min)) {
+			tier = i;
+			break;
+		}
+	}
+
+	/* Up one tier at a time, while the limits of the current one are cleared */
+	while (tier > POWER_TIER_NORMAL && tier_cleared(&power_tiers[tier], soc_pptt, tte_min)) {
+		tier--;
+	}
+
+	if (tier == pp->tier) {
+		return false;
+	}
+	pp->tier = tier;
+	return true;
+}
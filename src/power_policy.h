@@ -0,0 +1,88 @@
+/**
+ * @file src/power_policy.h - battery tiers and what the firmware gives up in each
+ *
+ * @brief Maps the fuel gauge state of charge and time to empty to a power tier.
+ *
+ * Each tier is one row of power_tiers[] that lists its entry limits and settings. A tier is
+ * entered when either limit is reached, so a heavy load lowers the tier before the charge does.
+ * It is left only once both limits of the tier above are cleared by a hysteresis margin, so a
+ * cell recovering after a load step does not flip the settings back and forth. No kernel
+ * dependency, the caller applies the actions.
+ */
+#ifndef __APP_POWER_POLICY_H__
+#define __APP_POWER_POLICY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Charge above the entry limit of a tier that leaves it again, pptt */
+#define POWER_POLICY_HYSTERESIS_PPTT 300
+
+/* Time to empty above the entry limit of a tier that leaves it again, percent of the limit */
+#define POWER_POLICY_HYSTERESIS_TTE_PCT 25
+
+/** Tiers, from full service down. */
+enum power_tier {
+	POWER_TIER_NORMAL,
+	POWER_TIER_SAVE,
+	POWER_TIER_LOW,
+	POWER_TIER_CRITICAL,
+	POWER_TIER_COUNT,
+};
+
+/** LED use of a tier. */
+enum power_led {
+	/** Every signal, including the idle blink. */
+	POWER_LED_ALL,
+	/** Low battery and fault signals only. */
+	POWER_LED_WARNINGS,
+	/** LED off. */
+	POWER_LED_OFF,
+};
+
+/** One tier: when it applies and what runs in it. */
+struct power_tier_row {
+	const char *name;
+	/** Entered at or below this state of charge, pptt. */
+	uint32_t soc_pptt;
+	/** Entered at or below this time to empty, minutes. */
+	uint32_t tte_min;
+	/** Gas measurement period, ms. */
+	uint32_t gas_period_ms;
+	/** Advertising interval, ms. */
+	uint16_t adv_min_ms;
+	uint16_t adv_max_ms;
+	/** BME680 in BSEC ultra low power mode, a sample every 300 s. */
+	bool bsec_ulp;
+	enum power_led led;
+	/** Save the sensor state and flush the logs on entry, brown-out may follow. */
+	bool flush;
+};
+
+/** The tier table, indexed by enum power_tier. */
+extern const struct power_tier_row power_tiers[POWER_TIER_COUNT];
+
+/** Policy state. */
+struct power_policy {
+	enum power_tier tier;
+};
+
+/**
+ * @brief Start in POWER_TIER_NORMAL.
+ *
+ * @param pp Policy state.
+ */
+void power_policy_init(struct power_policy *pp);
+
+/**
+ * @brief Tier for a new fuel gauge estimate.
+ *
+ * @param pp Policy state.
+ * @param soc_pptt State of charge, pptt.
+ * @param tte_min Time to empty in minutes, UINT32_MAX when unknown.
+ *
+ * @return True if the tier changed, the new one is in @p pp.
+ */
+bool power_policy_update(struct power_policy *pp, uint32_t soc_pptt, uint32_t tte_min);
+
+#endif // __APP_POWER_POLICY_H__
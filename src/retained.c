@@ -0,0 +1,49 @@
+/**
+ * @file src/retained.c - state kept in RAM through System OFF
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <hal/nrf_power.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/sys/crc.h>
+
+#include "retained.h"
+
+/* nRF52832: RAM[0..7] blocks of two 4 kB sections each */
+#define RAM_BASE         DT_REG_ADDR(DT_CHOSEN(zephyr_sram))
+#define RAM_SECTION_SIZE 0x1000
+#define RAM_SECTIONS     2
+
+static uint32_t block_crc(const struct retained_header *hdr, size_t size)
+{
+	return crc32_ieee((const uint8_t *)(hdr + 1), size - sizeof(*hdr));
+}
+
+/* Retention of every section the block touches, the others stay off in System OFF */
+static void retain_sections(const void *start, size_t size)
+{
+	uintptr_t first = ((uintptr_t)start - RAM_BASE) / RAM_SECTION_SIZE;
+	uintptr_t last = ((uintptr_t)start + size - 1 - RAM_BASE) / RAM_SECTION_SIZE;
+
+	for (uintptr_t s = first; s <= last; s++) {
+		nrf_power_rampower_mask_on(NRF_POWER, s / RAM_SECTIONS,
+					   NRF_POWER_RAMPOWER_S0RETENTION_MASK << (s % RAM_SECTIONS));
+	}
+}
+
+bool retained_valid(const struct retained_header *hdr, size_t size, uint32_t magic)
+{
+	return hdr->magic == magic && hdr->crc == block_crc(hdr, size);
+}
+
+void retained_seal(struct retained_header *hdr, size_t size, uint32_t magic)
+{
+	hdr->magic = magic;
+	hdr->crc = block_crc(hdr, size);
+	retain_sections(hdr, size);
+}
+
+void retained_clear(struct retained_header *hdr)
+{
+	hdr->magic = 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * @file src/retained.h - state kept in RAM through System OFF
+ *
+ * @brief Helpers for a __noinit block that survives System OFF and warm resets.
+ *
+ * The nRF52 powers its RAM sections down in System OFF unless their retention bit is set, and the
+ * wakeup is a reset, so a block is only trusted after a CRC check. The block is a struct whose
+ * first member is a struct retained_header; the CRC covers everything after the header.
+ *
+ * Blocks are placed with __retained in the retained_ram region of the board devicetree. It is not
+ * part of sram0, so neither the application nor MCUboot uses it and it is not cleared at boot.
+ */
+#ifndef __APP_RETAINED_H__
+#define __APP_RETAINED_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/devicetree.h>
+#include <zephyr/linker/devicetree_regions.h>
+#include <zephyr/toolchain.h>
+
+/** Place a variable in retained RAM, used instead of __noinit. */
+#define __retained Z_GENERIC_SECTION(LINKER_DT_NODE_REGION_NAME(DT_NODELABEL(retained_ram)))
+
+/** Header of a retained block. */
+struct retained_header {
+	/** Caller chosen, tells the block apart from another layout. */
+	uint32_t magic;
+	uint32_t crc;
+};
+
+/**
+ * @brief Check a retained block.
+ *
+ * @param hdr Header at the start of the block.
+ * @param size Size of the whole block.
+ * @param magic Magic of the expected layout.
+ *
+ * @return True when the block was sealed by retained_seal() with @p magic and is intact.
+ */
+bool retained_valid(const struct retained_header *hdr, size_t size, uint32_t magic);
+
+/**
+ * @brief Seal a retained block after it was written.
+ *
+ * Also turns on the retention of the RAM sections holding it, so it survives System OFF.
+ *
+ * @param hdr Header at the start of the block.
+ * @param size Size of the whole block.
+ * @param magic Magic of the layout.
+ */
+void retained_seal(struct retained_header *hdr, size_t size, uint32_t magic);
+
+/**
+ * @brief Invalidate a retained block, it is not restored after the next reset.
+ *
+ * @param hdr Header at the start of the block.
+ */
+void retained_clear(struct retained_header *hdr);
+
+#endif // __APP_RETAINED_H__
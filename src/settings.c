@@ -2,7 +2,9 @@
 #include <zephyr/settings/settings.h>
 #include <zephyr/logging/log.h>
 #include <errno.h>
+#include <stdio.h>
 
+#include "gas.h"
 #include "settings.h"
 
 LOG_MODULE_REGISTER(APP_CONFIG, CONFIG_APP_LOG_LEVEL);
@@ -12,11 +14,9 @@ LOG_MODULE_REGISTER(APP_CONFIG, CONFIG_APP_LOG_LEVEL);
 /* Definitions used to store and retrieve BSEC state from the settings API */
 #define SETTINGS_NAME_CONF "config"
 
-#define SETTINGS_KEY_OXYGEN   "oxygen"
-#define SETTINGS_OXYGEN_VALUE SETTINGS_NAME_CONF "/" SETTINGS_KEY_OXYGEN
-
-#define SETTINGS_KEY_NO2   "no2"
-#define SETTINGS_NO2_VALUE SETTINGS_NAME_CONF "/" SETTINGS_KEY_NO2
+/* Gas span points are stored under the settings-key of each gas channel node */
+#define GAS_SPAN_KEY(node_id)     DT_PROP_OR(node_id, settings_key, DT_NODE_FULL_NAME(node_id)),
+#define GAS_SPAN_DEFAULT(node_id) DT_PROP(node_id, span_mv),
 
 #define SETTINGS_KEY_BT_NAME "name"
 #define SETTINGS_BT_VALUE    SETTINGS_NAME_CONF "/" SETTINGS_KEY_BT_NAME
@@ -26,8 +26,10 @@ struct k_mutex config_mutex;
 struct k_event config_event;
 
 #define BT_NAME_LEN 15
-static unsigned int oxygen_mV = DEFAULT_O2_VALUE;
-static unsigned int no2_mV = DEFAULT_GAS_VALUE;
+static const char *const gas_span_key[GAS_CHANNEL_COUNT] = {
+	DT_FOREACH_CHILD_STATUS_OKAY(GAS_CHANNELS_NODE, GAS_SPAN_KEY)};
+static unsigned int gas_span_mV[GAS_CHANNEL_COUNT] = {
+	DT_FOREACH_CHILD_STATUS_OKAY(GAS_CHANNELS_NODE, GAS_SPAN_DEFAULT)};
 static char bt_name[BT_NAME_LEN] = "DC_G0099";
 
 /**
@@ -35,7 +37,7 @@ static char bt_name[BT_NAME_LEN] = "DC_G0099";
  *
  * This function is responsible for setting the configuration of a particular setting
  * identified by its name. It uses a callback function to read the necessary data.
- * In this example, it specifically handles the setting for "oxygen" level.
+ * It handles the span point of every gas channel and the advertising name.
  *
  * @param name The name of the setting to be configured.
  * @param len The length of the data to be read for the setting.
@@ -52,33 +54,20 @@ static int config_set(const char *name, size_t len, settings_read_cb read_cb, vo
 	// Return code from the callback function.
 	int rc;
 
-	// Check if the setting name matches "oxygen" and that there are no additional characters
-	// after the match.
-	if (settings_name_steq(name, SETTINGS_KEY_OXYGEN, &next) && !next) {
-		// Verify that the length of the data is equal to the expected size for the oxygen
-		// setting.
-		if (len != sizeof(oxygen_mV)) {
-			return -EINVAL; // Return error if the length does not match.
-		}
-
-		// Use the callback function to read the data for the oxygen setting.
-		rc = read_cb(cb_arg, &oxygen_mV, sizeof(oxygen_mV));
-		if (rc >= 0) {
-			return 0; // Return success if the callback function was successful.
+	// Check if the setting name matches the key of a gas channel and that there are no
+	// additional characters after the match.
+	for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+		if (!settings_name_steq(name, gas_span_key[i], &next) || next) {
+			continue;
 		}
 
-		return rc; // Return the error code from the callback function.
-	}
-
-	if (settings_name_steq(name, SETTINGS_KEY_NO2, &next) && !next) {
-		// Verify that the length of the data is equal to the expected size for the oxygen
-		// setting.
-		if (len != sizeof(no2_mV)) {
+		// Verify that the length of the data is equal to the expected size.
+		if (len != sizeof(gas_span_mV[i])) {
 			return -EINVAL; // Return error if the length does not match.
 		}
 
-		// Use the callback function to read the data for the oxygen setting.
-		rc = read_cb(cb_arg, &no2_mV, sizeof(no2_mV));
+		// Use the callback function to read the span point of the channel.
+		rc = read_cb(cb_arg, &gas_span_mV[i], sizeof(gas_span_mV[i]));
 		if (rc >= 0) {
 			return 0; // Return success if the callback function was successful.
 		}
@@ -110,19 +99,19 @@ struct settings_handler my_conf = {.name = SETTINGS_NAME_CONF, .h_set = config_s
 
 bool update_config(enum config_event type, void *value)
 {
-	// Check if the event type is OXYGEN_CALIBRATION
-	if (type == OXYGEN_CALIBRATION) {
-		// Update the oxygen calibration value with the new value provided
-		oxygen_mV = *(unsigned int *)value;
+	// Check if the event type is GAS_CALIBRATION
+	if (type == GAS_CALIBRATION) {
+		const struct gas_span_config *cfg = value;
 
-		// Log the new calibration value for debugging or informational purposes
-		LOG_INF("new oxygen calibration value : %d", oxygen_mV);
-	} else if (type == NO2_CALIBRATION) {
-		// Update the oxygen calibration value with the new value provided
-		no2_mV = *(unsigned int *)value;
+		if (cfg->channel < 0 || cfg->channel >= GAS_CHANNEL_COUNT) {
+			return false;
+		}
+		// Update the calibration value of the channel with the new value provided
+		gas_span_mV[cfg->channel] = cfg->span_mv;
 
 		// Log the new calibration value for debugging or informational purposes
-		LOG_INF("new gas calibration value : %d", no2_mV);
+		LOG_INF("new %s calibration value : %d", gas_span_key[cfg->channel],
+			cfg->span_mv);
 	} else if (type == BT_ADV_NAME) {
 		strcpy(bt_name, (char *)value);
 
@@ -138,15 +127,12 @@ void *get_config(enum config_event type)
 {
 	void *ret_value; // Default return value if the event type is not supported
 
-	// Check if the event type is OXYGEN_CALIBRATION
-	if (type == OXYGEN_CALIBRATION) {
-		ret_value = &oxygen_mV; // Retrieve the oxygen calibration millivolt value
-		LOG_INF("oxygen_mV: %d",
-			oxygen_mV); // Log the retrieved value for debugging purposes
-	} else if (type == NO2_CALIBRATION) {
-		ret_value = &no2_mV; // Retrieve the oxygen calibration millivolt value
-		LOG_INF("gas_mV: %d",
-			no2_mV); // Log the retrieved value for debugging purposes
+	// Check if the event type is GAS_CALIBRATION
+	if (type == GAS_CALIBRATION) {
+		ret_value = gas_span_mV; // Retrieve the span points of all gas channels
+		for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+			LOG_INF("%s_mV: %d", gas_span_key[i], gas_span_mV[i]);
+		}
 	} else if (type == BT_ADV_NAME) {
 		ret_value = bt_name; // Retrieve the oxygen calibration millivolt value
 		LOG_INF("bt_name: %s",
@@ -203,24 +189,21 @@ static void config_thread(void)
 		uint32_t events;
 		int rc;
 
-		// Wait for a specific configuration event (e.g., OXYGEN_CALIBRATION) indefinitely.
+		// Wait for a specific configuration event (e.g., GAS_CALIBRATION) indefinitely.
 		events = k_event_wait(&config_event, ALL_CONFIG_EVENT_FLAG, true, K_FOREVER);
 
 		// Check if the expected event occurred.
-		if (events == OXYGEN_CALIBRATION) {
-			// Save the oxygen calibration value to persistent storage and check for
-			// errors.
-			rc = settings_save_one(SETTINGS_OXYGEN_VALUE, &oxygen_mV,
-					       sizeof(oxygen_mV));
-			if (rc) {
-				LOG_ERR("settings_save, error: %d", rc);
-			}
-		} else if (events == NO2_CALIBRATION) {
-			// Save the oxygen calibration value to persistent storage and check for
-			// errors.
-			rc = settings_save_one(SETTINGS_NO2_VALUE, &no2_mV, sizeof(no2_mV));
-			if (rc) {
-				LOG_ERR("settings_save, error: %d", rc);
+		if (events == GAS_CALIBRATION) {
+			// Save the span points to persistent storage and check for errors. NVS
+			// skips the write of values that did not change.
+			for (int i = 0; i < GAS_CHANNEL_COUNT; i++) {
+				char key[SETTINGS_MAX_NAME_LEN + 1];
+
+				snprintf(key, sizeof(key), SETTINGS_NAME_CONF "/%s", gas_span_key[i]);
+				rc = settings_save_one(key, &gas_span_mV[i], sizeof(gas_span_mV[i]));
+				if (rc) {
+					LOG_ERR("settings_save, error: %d", rc);
+				}
 			}
 		} else if (events == BT_ADV_NAME) {
 			// Save the oxygen calibration value to persistent storage and check for
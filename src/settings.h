@@ -5,27 +5,21 @@
 
 #include "hhs_util.h"
 
-#define DEVICE_LIST(X)                                                         \
-    /* O2 gas sensor*/                                                         \
-    X(O2, = 0)                                                                 \
-    /* optional select gas sensor(H2S, CO, NH3, SO2) are common */             \
-    X(GAS, )                                                                   \
-    X(TEST, )
-DECLARE_ENUM(gas_device, DEVICE_LIST)
-
 /* Define a list of Bluetooth events with their corresponding values. */
 #define CONFIG_EVENT_LIST(X)                                                   \
-    /* event oxygen calibration */                                             \
-    X(OXYGEN_CALIBRATION, = 0x01)                                              \
-    X(NO2_CALIBRATION, = 0x02)                                                 \
+    /* event gas channel span calibration */                                   \
+    X(GAS_CALIBRATION, = 0x01)                                                 \
     X(BT_ADV_NAME, = 0x04)                                                     \
-    X(ALL_CONFIG_EVENT_FLAG, = 0x07)
+    X(ALL_CONFIG_EVENT_FLAG, = 0x05)
 DECLARE_ENUM(config_event, CONFIG_EVENT_LIST)
 
-/*  Voltage(0.1%) = (Currently measured voltage value) / ((1+2000/10.7) *
- * (20.9*0.001*0.001*100)) */
-#define DEFAULT_O2_VALUE 1900
-#define DEFAULT_GAS_VALUE 300
+/* Value of update_config(GAS_CALIBRATION, ...) */
+struct gas_span_config {
+    /* gas channel index */
+    int channel;
+    /* new span point in millivolts */
+    unsigned int span_mv;
+};
 
 extern struct k_condvar config_condvar;
 extern struct k_mutex config_mutex;
@@ -36,15 +30,15 @@ extern struct k_event config_event;
  * value.
  *
  * This function is responsible for updating the configuration settings of a
- * system. It currently handles the oxygen calibration event by updating the
- * calibration value. The function can be extended to handle other types of
- * configuration events.
+ * system. It currently handles the gas span calibration (a struct
+ * gas_span_config) and the advertising name. The function can be extended to
+ * handle other types of configuration events.
  *
  * @param type The type of configuration event that is triggering the update.
  *             This is an enumerated type that should list all possible
  * configuration events.
- * @param value The value associated with the event. For oxygen calibration,
- * this is the new calibration value in millivolts.
+ * @param value The value associated with the event. For gas calibration,
+ * this is a struct gas_span_config.
  * @return Returns true to indicate the update was successful. Currently, it
  * always returns true.
  */
@@ -54,10 +48,10 @@ bool update_config(enum config_event type, void *value);
  * @brief Retrieves a configuration value based on the specified event type.
  *
  * This function looks up a configuration value associated with a particular
- * event type. For example, if the event type is OXYGEN_CALIBRATION, it returns
- * the millivolt value for oxygen calibration. The function currently supports
- * a limited set of events, and can be expanded to include more configuration
- * types as needed.
+ * event type. For example, if the event type is GAS_CALIBRATION, it returns
+ * the unsigned int array of span points in millivolts, one per gas channel.
+ * The function currently supports a limited set of events, and can be expanded
+ * to include more configuration types as needed.
  *
  * @param type The type of configuration event for which the value is requested.
  *             This is an enumerated type that specifies the particular
@@ -0,0 +1,153 @@
+/**
+ * @file src/stack_monitor.c - thread stack high-water marks
+ *
+ * @brief Walks the thread list on app_work_q and logs how much of each stack was ever used. The
+ * walk is unlocked so scanning the stacks does not hold off interrupts; all threads of this
+ * application are static, the list does not change under it. A thread above
+ * CONFIG_APP_STACK_MONITOR_WARN_PCT is logged as a warning; the others at debug level. Meant for
+ * sizing the stacks in prj.conf and the K_THREAD_DEFINE()s, not for field builds: painting the
+ * stacks costs boot time.
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <stdio.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#if defined(CONFIG_SHELL)
+#include <zephyr/shell/shell.h>
+#endif
+
+#include "app_work.h"
+#include "stack_monitor.h"
+
+LOG_MODULE_REGISTER(STACK_MON, CONFIG_APP_LOG_LEVEL);
+
+struct stack_usage {
+	const char *name;
+	size_t size;
+	size_t used;
+};
+
+struct format_ctx {
+	char *buf;
+	size_t len;
+	int pos;
+};
+
+static void thread_usage(const struct k_thread *thread, struct stack_usage *usage)
+{
+	size_t unused = 0;
+
+	usage->name = k_thread_name_get((k_tid_t)thread);
+	usage->size = thread->stack_info.size;
+	if (k_thread_stack_space_get(thread, &unused) != 0) {
+		unused = usage->size;
+	}
+	usage->used = usage->size - unused;
+}
+
+static void format_thread(const struct k_thread *thread, void *user_data)
+{
+	struct format_ctx *ctx = user_data;
+	struct stack_usage usage;
+	char *dst = NULL;
+	size_t room = 0;
+
+	thread_usage(thread, &usage);
+
+	if ((size_t)ctx->pos < ctx->len) {
+		dst = ctx->buf + ctx->pos;
+		room = ctx->len - ctx->pos;
+	}
+
+	const char *sep = ctx->pos > 0 ? ";" : "";
+
+	if (usage.name != NULL && usage.name[0] != '\0') {
+		ctx->pos += snprintf(dst, room, "%s%s:%zu/%zu", sep, usage.name, usage.used,
+				     usage.size);
+	} else {
+		ctx->pos += snprintf(dst, room, "%s%p:%zu/%zu", sep, (void *)thread, usage.used,
+				     usage.size);
+	}
+}
+
+int stack_monitor_format(char *buf, size_t len)
+{
+	struct format_ctx ctx = {.buf = buf, .len = len};
+
+	if (len > 0) {
+		buf[0] = '\0';
+	}
+	k_thread_foreach_unlocked(format_thread, &ctx);
+	return ctx.pos;
+}
+
+static void check_thread(const struct k_thread *thread, void *user_data)
+{
+	struct stack_usage usage;
+
+	ARG_UNUSED(user_data);
+	thread_usage(thread, &usage);
+
+	if (usage.size == 0) {
+		return;
+	}
+	if (usage.used * 100 >= usage.size * CONFIG_APP_STACK_MONITOR_WARN_PCT) {
+		LOG_WRN("%s stack %zu/%zu bytes", usage.name ? usage.name : "?", usage.used,
+			usage.size);
+	}
+}
+
+static void stack_monitor_fn(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(stack_monitor_work, stack_monitor_fn);
+
+static void stack_monitor_fn(struct k_work *work)
+{
+	static char report[STACK_MONITOR_REPORT_LEN];
+
+	k_thread_foreach_unlocked(check_thread, NULL);
+
+	if (stack_monitor_format(report, sizeof(report)) >= (int)sizeof(report)) {
+		LOG_DBG("stack report truncated");
+	}
+	LOG_DBG("%s", report);
+
+	k_work_schedule_for_queue(&app_work_q, k_work_delayable_from_work(work),
+				  K_SECONDS(CONFIG_APP_STACK_MONITOR_PERIOD_SEC));
+}
+
+static int stack_monitor_init(void)
+{
+	/* First report once all threads ran through their start up */
+	k_work_schedule_for_queue(&app_work_q, &stack_monitor_work,
+				  K_SECONDS(CONFIG_APP_STACK_MONITOR_PERIOD_SEC));
+	return 0;
+}
+
+SYS_INIT(stack_monitor_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#if defined(CONFIG_SHELL)
+static void shell_thread(const struct k_thread *thread, void *user_data)
+{
+	const struct shell *sh = user_data;
+	struct stack_usage usage;
+
+	thread_usage(thread, &usage);
+	shell_print(sh, "%-20s %5zu / %5zu  %3zu%%", usage.name ? usage.name : "?", usage.used,
+		    usage.size, usage.size ? usage.used * 100 / usage.size : 0);
+}
+
+static int cmd_stacks(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	shell_print(sh, "%-20s  used /  size", "thread");
+	k_thread_foreach_unlocked(shell_thread, (void *)sh);
+	return 0;
+}
+
+SHELL_CMD_REGISTER(stacks, NULL, "Thread stack high-water marks", cmd_stacks);
+#endif
@@ -0,0 +1,30 @@
+#ifndef __APP_STACK_MONITOR_H__
+#define __APP_STACK_MONITOR_H__
+
+#include <stddef.h>
+
+/**
+ * @file src/stack_monitor.h
+ *
+ * @brief Run-time stack high-water marks of every thread.
+ *
+ * Stacks are painted at thread creation (CONFIG_INIT_STACKS) and the untouched part is measured
+ * with k_thread_stack_space_get(). The report is one "<thread>:<used>/<size>" entry per thread,
+ * separated by ';', in bytes. It is logged every CONFIG_APP_STACK_MONITOR_PERIOD_SEC, readable on
+ * the FFF4 characteristic and accepted by tools/ram_report/ram_report.py --runtime.
+ */
+
+/** Buffer size that holds the report of all threads of this application. */
+#define STACK_MONITOR_REPORT_LEN 384
+
+/**
+ * @brief Format the high-water report of all threads.
+ *
+ * @param buf Destination, always NUL terminated.
+ * @param len Size of @p buf.
+ *
+ * @return Length of the full report, may exceed @p len - 1 when truncated.
+ */
+int stack_monitor_format(char *buf, size_t len);
+
+#endif // __APP_STACK_MONITOR_H__
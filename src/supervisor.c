@@ -0,0 +1,208 @@
+/**
+ * @file src/supervisor.c - task liveness watchdog
+ *
+ * @brief Feeds the hardware watchdog from a k_timer on the wakeup grid, but only when every
+ * required task checked in within its window. A task is required from boot when it is built in;
+ * until its first heartbeat it has SUPERVISOR_STARTUP_MS after boot, which covers the
+ * configuration load. BSEC is only required once the BME680 started, a missing sensor is a fault
+ * of its own and not a reason to reset.
+ *
+ * @author bradkim06@gmail.com
+ */
+#include <zephyr/device.h>
+#include <zephyr/drivers/hwinfo.h>
+#include <zephyr/drivers/watchdog.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+
+#include "retained.h"
+#include "supervisor.h"
+#include "tick_align.h"
+
+LOG_MODULE_REGISTER(SUPERVISOR, CONFIG_APP_LOG_LEVEL);
+
+/* Maximum and minimum window for watchdog timer in milliseconds */
+#define WDT_MAX_WINDOW 5000U
+#define WDT_MIN_WINDOW 0U
+
+/* Interval of the liveness check and feed, with the gas measurement on the wakeup grid */
+#define WDT_FEED_INTERVAL 2000U
+
+/* Option for watchdog timer */
+#define WDT_OPER_MODE WDT_OPT_PAUSE_HALTED_BY_DBG
+
+/* Time until the first heartbeat of every task is due */
+#define SUPERVISOR_STARTUP_MS 60000U
+
+/* Marks a valid record of late tasks in no-init RAM */
+#define SUPERVISOR_RECORD_MAGIC 0x57445447U
+
+struct supervised {
+	const char *name;
+	/* longest time between two heartbeats, ms */
+	uint32_t window_ms;
+	bool required;
+};
+
+/* BSEC in ultra low power samples every 300 s */
+#define BSEC_WINDOW_MS (IS_ENABLED(CONFIG_BME68X_IAQ_SAMPLE_RATE_ULTRA_LOW_POWER) ? 900000 : 15000)
+
+/* Windows are a few periods, a single slow run is not a hang */
+static const struct supervised tasks[SUPERVISOR_TASK_COUNT] = {
+	[SUPERVISOR_GAS] = {"gas", 10000, true},
+	[SUPERVISOR_BT] = {"bt", 30000, true},
+	/* supervisor_set_required() by src/bme680_app.c */
+	[SUPERVISOR_BSEC] = {"bsec", BSEC_WINDOW_MS, false},
+	[SUPERVISOR_APP_WORK] = {"app_work", 30000, true},
+};
+
+/* Uptime of the last heartbeat in ms, 0 before the first one */
+static atomic_t last_checkin[SUPERVISOR_TASK_COUNT];
+
+/* Tasks required at run time on top of tasks[], bit per enum supervisor_task */
+static atomic_t required_set;
+
+/* Window set at run time, 0 for the one in tasks[] */
+static atomic_t window_override[SUPERVISOR_TASK_COUNT];
+
+/* Survives the watchdog reset */
+static __retained struct {
+	uint32_t magic;
+	uint32_t late;
+} record;
+
+static const struct device *const watchdog_device = DEVICE_DT_GET(DT_ALIAS(watchdog0));
+static int watchdog_channel_id;
+
+void supervisor_checkin(enum supervisor_task task)
+{
+	if (task < SUPERVISOR_TASK_COUNT) {
+		/* 0 means no heartbeat yet */
+		atomic_set(&last_checkin[task], k_uptime_get_32() | 1);
+	}
+}
+
+void supervisor_set_required(enum supervisor_task task, bool required)
+{
+	if (task >= SUPERVISOR_TASK_COUNT) {
+		return;
+	}
+	if (required) {
+		/* The window runs from now, not from boot */
+		atomic_cas(&last_checkin[task], 0, k_uptime_get_32() | 1);
+		atomic_or(&required_set, BIT(task));
+	} else {
+		atomic_and(&required_set, ~BIT(task));
+	}
+}
+
+void supervisor_set_window(enum supervisor_task task, uint32_t window_ms)
+{
+	if (task < SUPERVISOR_TASK_COUNT) {
+		atomic_set(&window_override[task], window_ms);
+	}
+}
+
+/* Bitmask of the required tasks whose heartbeat is overdue */
+static uint32_t late_tasks(uint32_t now)
+{
+	uint32_t late = 0;
+	uint32_t required = atomic_get(&required_set);
+
+	for (int i = 0; i < SUPERVISOR_TASK_COUNT; i++) {
+		uint32_t last = atomic_get(&last_checkin[i]);
+		uint32_t window = atomic_get(&window_override[i]);
+
+		if (!tasks[i].required && !(required & BIT(i))) {
+			continue;
+		}
+		if (window == 0) {
+			window = tasks[i].window_ms;
+		}
+		if (last == 0 ? now > SUPERVISOR_STARTUP_MS : now - last > window) {
+			late |= BIT(i);
+		}
+	}
+	return late;
+}
+
+static void watchdog_feed_fn(struct k_timer *timer)
+{
+	uint32_t late = late_tasks(k_uptime_get_32());
+
+	if (late) {
+		/* No feed, the watchdog resets within WDT_MAX_WINDOW */
+		record.magic = SUPERVISOR_RECORD_MAGIC;
+		record.late = late;
+		return;
+	}
+	record.magic = 0;
+	wdt_feed(watchdog_device, watchdog_channel_id);
+}
+
+static K_TIMER_DEFINE(watchdog_feed_timer, watchdog_feed_fn, NULL);
+
+static void report_last_reset(void)
+{
+	uint32_t cause = 0;
+
+	if (hwinfo_get_reset_cause(&cause) == 0 && (cause & RESET_WATCHDOG)) {
+		if (record.magic != SUPERVISOR_RECORD_MAGIC) {
+			/* No-init RAM is not guaranteed to survive every watchdog reset */
+			LOG_ERR("watchdog reset");
+		}
+		for (int i = 0; i < SUPERVISOR_TASK_COUNT; i++) {
+			if (record.magic == SUPERVISOR_RECORD_MAGIC && (record.late & BIT(i))) {
+				LOG_ERR("watchdog reset, %s missed its heartbeat", tasks[i].name);
+			}
+		}
+	}
+	record.magic = 0;
+	/* RESETREAS accumulates until cleared, the next reset starts from a clean cause */
+	hwinfo_clear_reset_cause();
+}
+
+static int supervisor_init(void)
+{
+	int err;
+
+	report_last_reset();
+
+	if (!device_is_ready(watchdog_device)) {
+		LOG_ERR("%s: device not ready", watchdog_device->name);
+		return -ENODEV;
+	}
+
+	const struct wdt_timeout_cfg watchdog_configuration = {
+		/* Reset SoC when watchdog timer expires. */
+		.flags = WDT_FLAG_RESET_SOC,
+		/* Expire watchdog after max window */
+		.window.min = WDT_MIN_WINDOW,
+		.window.max = WDT_MAX_WINDOW,
+	};
+
+	watchdog_channel_id = wdt_install_timeout(watchdog_device, &watchdog_configuration);
+	if (watchdog_channel_id < 0) {
+		LOG_ERR("Error installing watchdog timeout: %d", watchdog_channel_id);
+		return watchdog_channel_id;
+	}
+
+	err = wdt_setup(watchdog_device, WDT_OPER_MODE);
+	if (err < 0) {
+		LOG_ERR("Error setting up watchdog: %d", err);
+		return err;
+	}
+
+	/* First check on the wakeup grid and periodic from there */
+	struct tick_align_job feed_tick =
+		TICK_ALIGN_JOB_INIT(WDT_FEED_INTERVAL, 0, TICK_ALIGN_GRID_MS);
+
+	k_timer_start(&watchdog_feed_timer,
+		      K_TIMEOUT_ABS_MS(tick_align_next(&feed_tick, k_uptime_get())),
+		      K_MSEC(WDT_FEED_INTERVAL));
+	return 0;
+}
+
+SYS_INIT(supervisor_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
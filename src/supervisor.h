@@ -0,0 +1,59 @@
+#ifndef __APP_SUPERVISOR_H__
+#define __APP_SUPERVISOR_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @file src/supervisor.h
+ *
+ * @brief Watchdog fed only while every supervised task is alive.
+ *
+ * Each periodic task checks in once per run. On every feed, which rides on the gas measurement
+ * wakeup, the supervisor checks that every required task checked in within its window and only
+ * then feeds the watchdog; a hung task stops the feeding and the watchdog resets the SoC. The
+ * tasks that were late are kept in no-init RAM and logged after the reset, where the RAM survived
+ * it; otherwise only the reset cause is logged.
+ */
+
+/** Supervised tasks. */
+enum supervisor_task {
+	/** Gas measurement thread, every 2 s. */
+	SUPERVISOR_GAS,
+	/** Bluetooth publish thread, at least every 10 s. */
+	SUPERVISOR_BT,
+	/** BSEC thread of the BME68x driver, a sample every 3 s, once the sensor started. */
+	SUPERVISOR_BSEC,
+	/** Shared application work queue. */
+	SUPERVISOR_APP_WORK,
+	SUPERVISOR_TASK_COUNT,
+};
+
+/**
+ * @brief Heartbeat of a task.
+ *
+ * Cheap enough for every run, callable from any context.
+ *
+ * @param task The task that is alive.
+ */
+void supervisor_checkin(enum supervisor_task task);
+
+/**
+ * @brief Start or stop supervising a task that is not required from boot.
+ *
+ * A task that becomes required has a full window from the call for its first heartbeat.
+ *
+ * @param task The task.
+ * @param required True to supervise it.
+ */
+void supervisor_set_required(enum supervisor_task task, bool required);
+
+/**
+ * @brief Change the heartbeat window of a task, for a task whose period changed.
+ *
+ * @param task The task.
+ * @param window_ms Longest time between two heartbeats, 0 for the default.
+ */
+void supervisor_set_window(enum supervisor_task task, uint32_t window_ms);
+
+#endif // __APP_SUPERVISOR_H__
@@ -0,0 +1,32 @@
+/**
+ * @file src/tick_align.c - periodic wakeups snapped to a common grid
+ */
+#include "tick_align.h"
+
+int64_t tick_align(int64_t due_ms, uint32_t slack_ms, uint32_t grid_ms)
+{
+	if (grid_ms <= 1 || due_ms < 0) {
+		return due_ms;
+	}
+
+	int64_t below = due_ms - due_ms % grid_ms;
+	int64_t nearest = (due_ms - below) * 2 < (int64_t)grid_ms ? below : below + grid_ms;
+	int64_t shift = nearest > due_ms ? nearest - due_ms : due_ms - nearest;
+
+	return shift <= (int64_t)slack_ms ? nearest : due_ms;
+}
+
+int64_t tick_align_next(struct tick_align_job *job, int64_t now_ms)
+{
+	if (now_ms < job->wake_ms) {
+		return job->wake_ms;
+	}
+
+	/* The wakeup may sit up to the slack before its due time, it still has to be in the future */
+	do {
+		job->due_ms += job->period_ms;
+		job->wake_ms = tick_align(job->due_ms, job->slack_ms, job->grid_ms);
+	} while (job->wake_ms <= now_ms);
+
+	return job->wake_ms;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file src/tick_align.h - periodic wakeups snapped to a common grid
+ *
+ * @brief Every periodic job of the firmware wakes on a multiple of one grid, so jobs with
+ * unrelated periods share CPU active windows instead of each waking the CPU on its own.
+ *
+ * A job keeps its nominal due time on a fixed period counted from boot, so it does not drift with
+ * its own run time, and wakes at the grid point nearest to it when that point is within the job's
+ * slack. A job whose slack does not reach a grid point wakes at its due time. No kernel
+ * dependency, time is passed in.
+ */
+#ifndef __APP_TICK_ALIGN_H__
+#define __APP_TICK_ALIGN_H__
+
+#include <stdint.h>
+
+/* Grid of the firmware jobs, 1 ms (no alignment) with CONFIG_APP_TICK_ALIGN off */
+#if defined(CONFIG_APP_TICK_ALIGN)
+#define TICK_ALIGN_GRID_MS CONFIG_APP_TICK_ALIGN_GRID_MS
+#else
+#define TICK_ALIGN_GRID_MS 1
+#endif
+
+/** Schedule of one periodic job. */
+struct tick_align_job {
+	/** Nominal period, ms. */
+	uint32_t period_ms;
+	/** How far the wakeup may move from the nominal due time, ms. */
+	uint32_t slack_ms;
+	/** Grid the wakeups snap to, ms. */
+	uint32_t grid_ms;
+	/** Nominal due time of the next run, ms since boot. */
+	int64_t due_ms;
+	/** Wakeup of the next run, ms since boot. */
+	int64_t wake_ms;
+};
+
+/* clang-format off */
+#define TICK_ALIGN_JOB_INIT(period, slack, grid)                                                   \
+	{                                                                                          \
+		.period_ms = (period),                                                             \
+		.slack_ms = (slack),                                                               \
+		.grid_ms = (grid),                                                                 \
+	}
+/* clang-format on */
+
+/**
+ * @brief Snap a time to the nearest grid point within the slack.
+ *
+ * @param due_ms Nominal time, ms.
+ * @param slack_ms Allowed shift, ms.
+ * @param grid_ms Grid, ms.
+ *
+ * @return The grid point nearest to @p due_ms if it is within @p slack_ms, else @p due_ms.
+ */
+int64_t tick_align(int64_t due_ms, uint32_t slack_ms, uint32_t grid_ms);
+
+/**
+ * @brief Wakeup of the next run of a job.
+ *
+ * Called after every run, or after an early wakeup by an event. Once the current wakeup is
+ * reached the job moves on by whole periods, skipping the ones it missed; before that the same
+ * wakeup is returned again.
+ *
+ * @param job Job schedule.
+ * @param now_ms Current time, ms since boot.
+ *
+ * @return Absolute wakeup time, ms since boot, later than @p now_ms once the job advanced.
+ */
+int64_t tick_align_next(struct tick_align_job *job, int64_t now_ms);
+
+#endif // __APP_TICK_ALIGN_H__
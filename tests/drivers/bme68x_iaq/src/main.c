@@ -0,0 +1,217 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* drivers/bme68x_iaq against the register-level emulator and the BSEC stub.
+ *
+ * bme68x_bsec_init() runs at boot on the emulated part, then the BSEC thread calls
+ * apply_sensor_settings() and fetch_and_process_output() on the schedule of the stub. The tests
+ * load profiles into the emulator and check the values that come out of the sensor API, the
+ * sample timing and the bus transfers per sample.
+ *
+ * Every test starts right after a sample: the trigger handler wakes the test thread, which
+ * preempts the BSEC thread before its next bus access, so the emulator can be reprogrammed
+ * between two samples.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include <drivers/bme68x_emul.h>
+#include <drivers/bme68x_iaq.h>
+
+#define BME68X_NODE DT_NODELABEL(bme68x)
+
+/* LP schedule of the driver, BSEC_SAMPLE_PERIOD_S */
+#define LP_PERIOD_MS  3000
+/* ULP schedule of BSEC, one sample every 300 s, selected by any rate below 1/3 Hz */
+#define ULP_PERIOD_MS 300000
+#define ULP_RATE_HZ   (1000.0 / ULP_PERIOD_MS)
+/* A sample is read within the field polling of bme68x_get_data() */
+#define SAMPLE_SLACK_MS 100
+
+/* Bus budget of a temperature, pressure and humidity sample, 18 transfers and 70 bytes today */
+#define SAMPLE_MAX_TRANSFERS  20
+#define SAMPLE_MAX_BYTES_READ 80
+
+/* CONFIG_BME68X_IAQ_TEMPERATURE_OFFSET is subtracted by BSEC as the heat source */
+#define TEMP_OFFSET_C (CONFIG_BME68X_IAQ_TEMPERATURE_OFFSET / 100.0)
+
+static const struct device *const dev = DEVICE_DT_GET(BME68X_NODE);
+static const struct emul *const emul = EMUL_DT_GET(BME68X_NODE);
+
+static const struct bme68x_emul_sample default_profile[] = {
+	{.temperature_mc = 25000, .pressure_pa = 101325, .humidity_mpct = 45000, .gas_ohm = 50000},
+};
+
+static K_SEM_DEFINE(sample_sem, 0, 1);
+static int64_t sample_ms;
+
+static void sample_handler(const struct device *sensor, const struct sensor_trigger *trig)
+{
+	ARG_UNUSED(sensor);
+	ARG_UNUSED(trig);
+
+	sample_ms = k_uptime_get();
+	k_sem_give(&sample_sem);
+}
+
+static bool wait_sample(int32_t timeout_ms)
+{
+	return k_sem_take(&sample_sem, K_MSEC(timeout_ms)) == 0;
+}
+
+static double channel(enum sensor_channel chan)
+{
+	struct sensor_value val;
+
+	zassert_ok(sensor_channel_get(dev, chan, &val));
+	return sensor_value_to_double(&val);
+}
+
+static void set_rate(double rate_hz)
+{
+	struct sensor_value val;
+
+	zassert_ok(sensor_value_from_double(&val, rate_hz));
+	zassert_ok(sensor_attr_set(dev, SENSOR_CHAN_ALL, SENSOR_ATTR_SAMPLING_FREQUENCY, &val));
+}
+
+static void *bme68x_iaq_setup(void)
+{
+	static const struct sensor_trigger trig = {
+		.type = SENSOR_TRIG_TIMER,
+		.chan = SENSOR_CHAN_ALL,
+	};
+
+	zassert_true(device_is_ready(dev), "bme68x_bsec_init() failed on the emulator");
+	zassert_ok(sensor_trigger_set(dev, &trig, sample_handler));
+	return NULL;
+}
+
+static void bme68x_iaq_before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	/* Back to the LP schedule, a ULP test left the thread in its 300 s wait */
+	set_rate(1.0);
+	k_sem_reset(&sample_sem);
+	zassert_true(wait_sample(2 * LP_PERIOD_MS), "no sample");
+	zassert_ok(bme68x_emul_set_profile(emul, default_profile, ARRAY_SIZE(default_profile),
+					   true));
+	bme68x_emul_reset_stats(emul);
+}
+
+ZTEST(bme68x_iaq, test_init_reads_the_part)
+{
+	struct bme68x_emul_stats stats;
+
+	/* The calibration came from the emulator, or the default sample would not come back */
+	zassert_true(wait_sample(2 * LP_PERIOD_MS));
+	zassert_within(channel(SENSOR_CHAN_AMBIENT_TEMP), 25.0 - TEMP_OFFSET_C, 0.05);
+	zassert_within(channel(SENSOR_CHAN_PRESS), 101325.0, 5.0);
+	zassert_within(channel(SENSOR_CHAN_HUMIDITY), 45.0, 0.1);
+
+	bme68x_emul_get_stats(emul, &stats);
+	zassert_equal(stats.conversions, 1);
+}
+
+ZTEST(bme68x_iaq, test_samples_follow_the_profile)
+{
+	static const struct bme68x_emul_sample profile[] = {
+		{.temperature_mc = 21500, .pressure_pa = 98000, .humidity_mpct = 40000},
+		{.temperature_mc = -5000, .pressure_pa = 101325, .humidity_mpct = 85000},
+		{.temperature_mc = 38250, .pressure_pa = 90000, .humidity_mpct = 10000},
+	};
+
+	zassert_ok(bme68x_emul_set_profile(emul, profile, ARRAY_SIZE(profile), false));
+	for (size_t i = 0; i < ARRAY_SIZE(profile); i++) {
+		zassert_true(wait_sample(2 * LP_PERIOD_MS), "no sample %zu", i);
+		zassert_within(channel(SENSOR_CHAN_AMBIENT_TEMP),
+			       profile[i].temperature_mc / 1000.0 - TEMP_OFFSET_C, 0.05, "%zu", i);
+		zassert_within(channel(SENSOR_CHAN_PRESS), (double)profile[i].pressure_pa, 5.0,
+			       "%zu", i);
+		zassert_within(channel(SENSOR_CHAN_HUMIDITY), profile[i].humidity_mpct / 1000.0,
+			       0.1, "%zu", i);
+	}
+}
+
+ZTEST(bme68x_iaq, test_lp_timing_and_bus_budget)
+{
+	const uint32_t samples = 5;
+	struct bme68x_emul_stats stats;
+	int64_t last_ms = sample_ms;
+
+	for (uint32_t i = 0; i < samples; i++) {
+		zassert_true(wait_sample(2 * LP_PERIOD_MS), "no sample %u", i);
+		zassert_between_inclusive(sample_ms - last_ms, LP_PERIOD_MS,
+					  LP_PERIOD_MS + SAMPLE_SLACK_MS, "sample %u", i);
+		last_ms = sample_ms;
+	}
+
+	bme68x_emul_get_stats(emul, &stats);
+	zassert_equal(stats.conversions, samples);
+	zassert_true(stats.transfers <= samples * SAMPLE_MAX_TRANSFERS, "%u transfers",
+		     stats.transfers);
+	zassert_true(stats.bytes_read <= samples * SAMPLE_MAX_BYTES_READ, "%u bytes read",
+		     stats.bytes_read);
+}
+
+ZTEST(bme68x_iaq, test_ulp_gas_path)
+{
+	static const struct bme68x_emul_sample profile[] = {
+		{.temperature_mc = 25000, .pressure_pa = 101325, .humidity_mpct = 45000,
+		 .gas_ohm = 250000},
+	};
+	struct sensor_value iaq;
+	int64_t first_ms;
+
+	zassert_ok(bme68x_emul_set_profile(emul, profile, ARRAY_SIZE(profile), true));
+
+	/* A new subscription samples everything right away, gas included */
+	set_rate(ULP_RATE_HZ);
+	zassert_true(wait_sample(2 * LP_PERIOD_MS));
+	first_ms = sample_ms;
+
+	/* IAQ of the stub: (505 kOhm - 250 kOhm) / 1 kOhm */
+	zassert_ok(sensor_channel_get(dev, SENSOR_CHAN_IAQ, &iaq));
+	zassert_within(iaq.val1, 255, 1);
+	zassert_within(channel(SENSOR_CHAN_CO2), 3050.0, 10.0);
+	zassert_within(channel(SENSOR_CHAN_VOC), 3.05, 0.01);
+
+	/* Nothing in between, the next sample on the ULP schedule */
+	zassert_false(wait_sample(ULP_PERIOD_MS - SAMPLE_SLACK_MS), "sample before the ULP period");
+	zassert_true(wait_sample(2 * SAMPLE_SLACK_MS), "no ULP sample");
+	zassert_within(sample_ms - first_ms, ULP_PERIOD_MS, SAMPLE_SLACK_MS);
+}
+
+static int state_load(const char *key, size_t len, settings_read_cb read_cb, void *cb_arg,
+		      void *param)
+{
+	uint8_t *state = param;
+
+	ARG_UNUSED(key);
+
+	return read_cb(cb_arg, state, MIN(len, 8)) == 8 ? 0 : -EINVAL;
+}
+
+ZTEST(bme68x_iaq, test_state_save)
+{
+	struct sensor_value val = {0};
+	uint8_t state[8] = {0};
+
+	zassert_ok(sensor_attr_set(dev, SENSOR_CHAN_ALL, SENSOR_ATTR_BSEC_SAVE_STATE, &val));
+	/* The thread saves before its next sample */
+	zassert_true(wait_sample(2 * LP_PERIOD_MS));
+
+	zassert_ok(settings_load_subtree_direct("bsec/state", state_load, state));
+	/* Magic of the stub state */
+	zassert_equal(sys_get_le32(state), 0x42535453);
+}
+
+ZTEST_SUITE(bme68x_iaq, NULL, bme68x_iaq_setup, bme68x_iaq_before, NULL, NULL);
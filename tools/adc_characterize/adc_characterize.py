@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+"""Noise against energy per reading for the gas channel oversampling/decimation settings.
+
+Takes a raw capture (CSV from tools/raw_capture/decode_capture.py, taken with the sensor at a
+steady input) and replays it through every combination of
+
+    CONFIG_APP_GAS_ADC_OVERSAMPLING  SAADC averages 2^n conversions, result rounded to 12 bit
+    CONFIG_APP_GAS_ADC_DECIMATION    software CIC decimation factor R
+    CONFIG_APP_GAS_ADC_CIC_ORDER     CIC order N, burst of N * R samples per reading
+
+and prints the RMS noise of the resulting readings in uV next to a model of the energy one reading
+costs. The capture is taken without oversampling, so consecutive captured codes stand in for the
+back to back conversions of a burst. This holds for white noise; drift and 1/f noise within a
+burst are underestimated when the capture rate is well below the burst rate.
+
+    adc_characterize.py capture.csv -c gas_mv
+    adc_characterize.py capture.csv -c o2_mv --spec-uv 300
+    adc_characterize.py --synthetic-uv 600            # no capture, gaussian noise
+"""
+
+import argparse
+import csv
+import math
+import random
+import sys
+
+LSB_BITS = 12
+FRAC_BITS = 4  # GAS_DSP_CIC_FRAC_BITS
+
+
+def load_codes(path, column, full_scale_mv):
+    lsb_mv = full_scale_mv / (1 << LSB_BITS)
+    codes = []
+    with open(path) as f:
+        for row in csv.DictReader(f):
+            codes.append(round(float(row[column]) / lsb_mv))
+    return codes
+
+
+def synthetic_codes(n, level_mv, noise_uv, full_scale_mv, seed):
+    lsb_mv = full_scale_mv / (1 << LSB_BITS)
+    rng = random.Random(seed)
+    return [min(max(round((level_mv + rng.gauss(0, noise_uv / 1000)) / lsb_mv), 0),
+                (1 << LSB_BITS) - 1) for _ in range(n)]
+
+
+def cic_last(samples, order, decimation):
+    """Last output of the firmware decimator (gas_dsp_cic_push), fractional bits included."""
+    integ = [0] * order
+    comb = [0] * order
+    out = None
+    phase = 0
+    for x in samples:
+        acc = x
+        for i in range(order):
+            integ[i] += acc
+            acc = integ[i]
+        phase += 1
+        if phase < decimation:
+            continue
+        phase = 0
+        for i in range(order):
+            prev = comb[i]
+            comb[i] = acc
+            acc -= prev
+        gain = decimation ** order
+        y = acc << FRAC_BITS
+        out = int((y + (gain // 2 if y >= 0 else -(gain // 2))) / gain)
+    return out
+
+
+def readings(codes, oversampling, order, decimation):
+    """Split the capture into independent readings of one configuration, in codes."""
+    per_hw = 1 << oversampling
+    burst = order * decimation
+    per_reading = per_hw * burst
+    out = []
+    for start in range(0, len(codes) - per_reading + 1, per_reading):
+        chunk = codes[start:start + per_reading]
+        # SAADC oversampling: accumulate and divide, rounded back to 12 bit
+        hw = [round(sum(chunk[i:i + per_hw]) / per_hw) for i in range(0, per_reading, per_hw)]
+        out.append(cic_last(hw, order, decimation) / (1 << FRAC_BITS))
+    return out
+
+
+def energy_uj(oversampling, order, decimation, m):
+    """Energy of one reading from the SAADC conversions, per sample interrupts and the wake up."""
+    conversions = (1 << oversampling) * order * decimation
+    samples = order * decimation
+    t_adc_us = conversions * (m.acq_us + m.conv_us)
+    t_cpu_us = m.wake_us + samples * m.isr_us
+    return m.vdd * (m.i_adc_ua * t_adc_us + m.i_cpu_ua * t_cpu_us) / 1e6, t_adc_us + t_cpu_us
+
+
+def rms(values):
+    if len(values) < 2:
+        return float('nan')
+    mean = sum(values) / len(values)
+    return math.sqrt(sum((v - mean) ** 2 for v in values) / (len(values) - 1))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('input', nargs='?', help='capture CSV from decode_capture.py')
+    ap.add_argument('-c', '--column', default='gas_mv', help='CSV column, default gas_mv')
+    ap.add_argument('--full-scale-mv', type=float, default=3600,
+                    help='input voltage at code 4096, default 3600 (gain 1/6, 0.6 V ref)')
+    ap.add_argument('--synthetic-uv', type=float, help='use gaussian noise of this RMS instead of a capture')
+    ap.add_argument('--synthetic-mv', type=float, default=600, help='synthetic input level')
+    ap.add_argument('--samples', type=int, default=1 << 20, help='synthetic capture length')
+    ap.add_argument('--seed', type=int, default=1)
+    ap.add_argument('--oversampling', default='0-8', help='log2 range, e.g. 0-5')
+    ap.add_argument('--decimation', default='1,2,4,8,16,32,64', help='comma separated list')
+    ap.add_argument('--order', default='1,2,3', help='comma separated list')
+    ap.add_argument('--min-readings', type=int, default=30,
+                    help='skip configurations with fewer independent readings in the capture')
+    ap.add_argument('--spec-uv', type=float, help='mark the cheapest configuration below this noise')
+    ap.add_argument('--all', action='store_true', help='print dominated configurations too')
+    m = ap.add_argument_group('energy model (nRF52832 product specification, DCDC off)')
+    m.add_argument('--vdd', type=float, default=3.0)
+    m.add_argument('--i-adc-ua', type=float, default=700, help='SAADC active, HFCLK included')
+    m.add_argument('--i-cpu-ua', type=float, default=3700, help='CPU running from flash')
+    m.add_argument('--acq-us', type=float, default=40, help='zephyr,acquisition-time')
+    m.add_argument('--conv-us', type=float, default=2)
+    m.add_argument('--isr-us', type=float, default=10, help='driver work per sample of a burst')
+    m.add_argument('--wake-us', type=float, default=150,
+                   help='thread wake up, adc_read set up and SAADC start per reading')
+    args = ap.parse_args()
+
+    if args.synthetic_uv is not None:
+        codes = synthetic_codes(args.samples, args.synthetic_mv, args.synthetic_uv,
+                                args.full_scale_mv, args.seed)
+        source = 'synthetic %.0f uV at %.0f mV' % (args.synthetic_uv, args.synthetic_mv)
+    elif args.input:
+        codes = load_codes(args.input, args.column, args.full_scale_mv)
+        source = '%s:%s' % (args.input, args.column)
+    else:
+        ap.error('pass a capture or --synthetic-uv')
+
+    lo, _, hi = args.oversampling.partition('-')
+    osr = range(int(lo), int(hi or lo) + 1)
+    decs = [int(v) for v in args.decimation.split(',')]
+    orders = [int(v) for v in args.order.split(',')]
+    lsb_uv = args.full_scale_mv * 1000 / (1 << LSB_BITS)
+
+    rows = []
+    for o in osr:
+        for n in orders:
+            for r in decs:
+                if n * math.ceil(math.log2(r)) + 13 > 31:
+                    continue  # rejected by the BUILD_ASSERT in gas.c
+                values = readings(codes, o, n, r)
+                if len(values) < args.min_readings:
+                    continue
+                e_uj, t_us = energy_uj(o, n, r, args)
+                rows.append((o, n, r, len(values), rms(values) * lsb_uv, e_uj, t_us))
+
+    if not rows:
+        sys.exit('capture too short for any configuration, lower --min-readings')
+
+    # Pareto front: no other configuration is both quieter and cheaper
+    rows.sort(key=lambda row: (row[5], row[4]))
+    front = []
+    best = float('inf')
+    for row in rows:
+        if row[4] < best:
+            front.append(row)
+            best = row[4]
+    pick = None
+    if args.spec_uv is not None:
+        pick = next((row for row in front if row[4] <= args.spec_uv), None)
+
+    print('# %s, %d samples, 1 LSB = %.0f uV, quantization floor %.0f uV'
+          % (source, len(codes), lsb_uv, lsb_uv / math.sqrt(12)))
+    print('%4s %5s %3s %8s %10s %10s %9s' % ('osr', 'decim', 'N', 'readings', 'noise_uV', 'energy_uJ', 'time_us'))
+    for row in rows if args.all else front:
+        mark = ' <' if row is pick else (' *' if args.all and row in front else '')
+        print('%4d %5d %3d %8d %10.1f %10.3f %9.0f%s' % (row[0], row[2], row[1], row[3], row[4],
+                                                       row[5], row[6], mark))
+    if args.spec_uv is not None:
+        if pick:
+            print('# CONFIG_APP_GAS_ADC_OVERSAMPLING=%d CONFIG_APP_GAS_ADC_DECIMATION=%d '
+                  'CONFIG_APP_GAS_ADC_CIC_ORDER=%d' % (pick[0], pick[2], pick[1]))
+        else:
+            print('# no configuration meets %.0f uV' % args.spec_uv)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""Build a delta patch for src/delta_dfu.c and report how much smaller than the image it is.
+
+The source is the signed app_update.bin the units run, the target the app_update.bin of the new
+release. The patch is applied again to the source before it is written, and must give the target
+byte for byte:
+
+    delta_patch.py old/app_update.bin build/zephyr/app_update.bin -o update.hdp
+
+Format (src/delta_dfu.h): a header with the sizes and CRC-32 of both images, then ADD operations
+that take source bytes at a seek from the previous ones plus a difference, mostly zero where only
+addresses moved, and INSERT operations with new bytes.
+"""
+
+import argparse
+import re
+import struct
+import sys
+import time
+import zlib
+
+MAGIC = 0x31504448
+OP_ADD = 0x01
+OP_INSERT = 0x02
+
+# Bytes hashed to find match candidates, and the shortest exact match an ADD starts from
+KEY_LEN = 8
+MIN_MATCH = 12
+MAX_CANDIDATES = 16
+# An ADD stops once this many bytes did not improve its match score
+EXTEND_GIVE_UP = 64
+# Shorter zero runs stay in the difference bytes, a token costs as much
+MIN_ZERO_RUN = 3
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7f
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def build_index(src):
+    index = {}
+    for i in range(len(src) - KEY_LEN + 1):
+        key = src[i:i + KEY_LEN]
+        positions = index.get(key)
+        if positions is None:
+            index[key] = [i]
+        elif len(positions) < MAX_CANDIDATES:
+            positions.append(i)
+    return index
+
+
+def exact_len(src, s, tgt, t):
+    limit = min(len(src) - s, len(tgt) - t)
+    n = 0
+    while n + 64 <= limit and src[s + n:s + n + 64] == tgt[t + n:t + n + 64]:
+        n += 64
+    while n < limit and src[s + n] == tgt[t + n]:
+        n += 1
+    return n
+
+
+def extend(src, s, tgt, t, n):
+    """Grow an exact match while at least half of the bytes keep matching, like bsdiff."""
+    limit = min(len(src) - s, len(tgt) - t)
+    score = best_score = 0
+    best = n
+    i = n
+    while i < limit and i - best < EXTEND_GIVE_UP:
+        score += 1 if src[s + i] == tgt[t + i] else -1
+        i += 1
+        if score > best_score:
+            best_score = score
+            best = i
+    return best
+
+
+def diff_tokens(src, s, tgt, t, n):
+    diff = bytes((tgt[t + i] - src[s + i]) & 0xff for i in range(n))
+    out = bytearray()
+    pos = 0
+    for run in re.finditer(b'\x00{%d,}' % MIN_ZERO_RUN, diff):
+        if run.start() > pos:
+            out += varint(((run.start() - pos) << 1) | 1) + diff[pos:run.start()]
+        out += varint((run.end() - run.start()) << 1)
+        pos = run.end()
+    if pos < n:
+        out += varint(((n - pos) << 1) | 1) + diff[pos:]
+    return out
+
+
+def make_patch(src, tgt):
+    index = build_index(src)
+    out = bytearray(struct.pack('<5I', MAGIC, len(src), zlib.crc32(src), len(tgt),
+                                zlib.crc32(tgt)))
+    stats = {'add': 0, 'insert': 0, 'insert_bytes': 0}
+    literal = bytearray()
+    src_pos = 0
+    t = 0
+
+    def flush_literal():
+        if literal:
+            out.append(OP_INSERT)
+            out.extend(varint(len(literal)))
+            out.extend(literal)
+            stats['insert'] += 1
+            stats['insert_bytes'] += len(literal)
+            literal.clear()
+
+    while t < len(tgt):
+        # The previous alignment, after inserted or after replaced bytes, then the index
+        candidates = [src_pos, src_pos + len(literal)]
+        candidates += index.get(tgt[t:t + KEY_LEN], [])
+        best_s, best_n = None, 0
+        for s in candidates:
+            if s < len(src):
+                n = exact_len(src, s, tgt, t)
+                if n > best_n:
+                    best_s, best_n = s, n
+        if best_n < MIN_MATCH:
+            literal.append(tgt[t])
+            t += 1
+            continue
+
+        n = extend(src, best_s, tgt, t, best_n)
+        flush_literal()
+        out.append(OP_ADD)
+        out += varint(n)
+        out += varint(zigzag(best_s - src_pos))
+        out += diff_tokens(src, best_s, tgt, t, n)
+        stats['add'] += 1
+        src_pos = best_s + n
+        t += n
+    flush_literal()
+    return bytes(out), stats
+
+
+def read_varint(patch, pos):
+    value = shift = 0
+    while True:
+        byte = patch[pos]
+        pos += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if not byte & 0x80:
+            return value, pos
+
+
+def apply_patch(src, patch):
+    """The decoder of src/delta_dfu.c, for the self check."""
+    magic, src_size, src_crc, tgt_size, tgt_crc = struct.unpack_from('<5I', patch)
+    if magic != MAGIC or src_size != len(src) or src_crc != zlib.crc32(src):
+        raise ValueError('patch is not for this source')
+    pos = struct.calcsize('<5I')
+    out = bytearray()
+    src_pos = 0
+    while len(out) < tgt_size:
+        op = patch[pos]
+        n, pos = read_varint(patch, pos + 1)
+        if op == OP_INSERT:
+            out += patch[pos:pos + n]
+            pos += n
+            continue
+        if op != OP_ADD:
+            raise ValueError('bad operation 0x%02x at %d' % (op, pos - 1))
+        seek, pos = read_varint(patch, pos)
+        src_pos += (seek >> 1) ^ -(seek & 1)
+        if not 0 <= src_pos < len(src):
+            raise ValueError('seek out of the source at %d' % (pos - 1))
+        end = len(out) + n
+        while len(out) < end:
+            token, pos = read_varint(patch, pos)
+            run = token >> 1
+            if token & 1:
+                out += bytes((src[src_pos + i] + patch[pos + i]) & 0xff for i in range(run))
+                pos += run
+            else:
+                out += src[src_pos:src_pos + run]
+            src_pos += run
+    if pos != len(patch) or zlib.crc32(out) != tgt_crc:
+        raise ValueError('patch does not give the target')
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('source', help='app_update.bin running on the units')
+    parser.add_argument('target', help='app_update.bin of the new release')
+    parser.add_argument('-o', '--output', help='patch file, only the report without it')
+    args = parser.parse_args()
+
+    with open(args.source, 'rb') as f:
+        src = f.read()
+    with open(args.target, 'rb') as f:
+        tgt = f.read()
+
+    start = time.monotonic()
+    patch, stats = make_patch(src, tgt)
+    elapsed = time.monotonic() - start
+    if apply_patch(src, patch) != tgt:
+        sys.exit('self check failed')
+
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(patch)
+
+    print('source  %8d bytes' % len(src))
+    print('target  %8d bytes' % len(tgt))
+    print('patch   %8d bytes, %.1f %% of the target, %.1f:1 (%.1f s)'
+          % (len(patch), 100.0 * len(patch) / len(tgt), len(tgt) / len(patch), elapsed))
+    print('        %d ADD, %d INSERT with %d new bytes'
+          % (stats['add'], stats['insert'], stats['insert_bytes']))
+
+
+if __name__ == '__main__':
+    main()
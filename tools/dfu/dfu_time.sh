@@ -0,0 +1,34 @@
+#!/bin/sh
+# Time a firmware update over BLE with the mcumgr CLI: upload, test, reset, and the first SMP
+# answer of the new image. The unit logs the upload time itself ("upload done in <n> ms").
+#
+#   tools/dfu/dfu_time.sh HHS_G0012 build/zephyr/app_update.bin
+
+set -e
+
+NAME=${1:?usage: dfu_time.sh <advertised name> [app_update.bin]}
+IMAGE=${2:-build/zephyr/app_update.bin}
+CONN="--conntype ble --connstring ctlr_name=hci0,peer_name=$NAME"
+
+size=$(wc -c < "$IMAGE")
+t0=$(date +%s.%N)
+mcumgr $CONN image upload "$IMAGE"
+t1=$(date +%s.%N)
+
+# The hash of the uploaded image, second slot of the list
+hash=$(mcumgr $CONN image list | awk '/hash:/ {h = $2} END {print h}')
+mcumgr $CONN image test "$hash"
+mcumgr $CONN reset
+t2=$(date +%s.%N)
+
+# MCUboot swaps the slots before the new image advertises again
+until mcumgr $CONN echo up > /dev/null 2>&1; do
+	sleep 1
+done
+t3=$(date +%s.%N)
+
+echo "$size bytes" | awk -v up="$t0 $t1" -v sw="$t2 $t3" -v tot="$t0 $t3" '{
+	split(up, u); split(sw, s); split(tot, t)
+	printf "upload %.1f s (%.1f kB/s), swap and boot %.1f s, total %.1f s\n",
+	       u[2] - u[1], $1 / 1024 / (u[2] - u[1]), s[2] - s[1], t[2] - t[1]
+}'
@@ -0,0 +1,417 @@
+/**
+ * @file tools/fuel_sim/fuel_sim.c - battery state of charge estimates on a simulated discharge
+ *
+ * Discharges a simulated cell from full with the loads of the firmware: the board floor current,
+ * advertising or a BLE connection that comes and goes, radio events and BME680 heater pulses. The
+ * cell follows the OCV curve of src/battery.c with an internal resistance, and its voltage
+ * recovers from a load step with a first order time constant. The battery is sampled every minute
+ * like the firmware and three estimates are compared with the true state of charge:
+ *
+ *   before      15 sample moving average of the voltage through the old curve under load
+ *   avg+ocv     the same moving average through the OCV curve, without load correction
+ *   fuel gauge  src/fuel_gauge.c with the tags and the energy model of src/battery.c
+ *
+ * The divider current is added to the discharge, pulsed for 200 ms per sample, and also counted
+ * as if it stayed on like before.
+ *
+ *     fuel_sim                   # cell and model as in the firmware
+ *     fuel_sim -b 40 -r 800      # real floor 40 uA and 800 mOhm, model errors of the gauge
+ *     fuel_sim -l                # BME680 in LP mode (3 s), heater pulses in many samples
+ *     fuel_sim -p                # with the power tiers of src/power_policy.c applied
+ *     fuel_sim -t trace.csv      # every sample as min,true,before,avg_ocv,gauge,tte_min
+ */
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fuel_gauge.h"
+#include "hhs_math.h"
+#include "power_policy.h"
+
+/* Simulation step, ms */
+#define STEP_MS 100
+
+#define SAMPLE_PERIOD_MS 60000
+#define SETTLE_MS        200
+#define FILTER_SIZE      15
+
+/* Divider, output and full resistance of the board devicetree */
+#define DIVIDER_OHM (1500000 + 180000)
+
+/* Heater tag window of src/battery.c */
+#define HEATER_RECOVERY_MS 3000
+
+/* Peak current of a radio event, and its share of time connected and advertising */
+#define RADIO_EVENT_UA   7000
+#define RADIO_EVENT_CONN 0.02
+#define RADIO_EVENT_ADV  0.004
+
+/* Parts of the floor current a power tier can cut: gas measurement at 2 s (gas.c test result),
+ * green idle blink of 50 ms at 2 mA every 10 s, BSEC temperature and pressure sample every 3 s
+ * (estimate)
+ */
+#define GAS_UA_AT_2S  5
+#define LED_IDLE_UA   10
+#define BSEC_TPH_UA   5
+
+/* Advertising current of the model at 250 ~ 500 ms, as src/battery.c */
+#define ADV_UA             25
+#define ADV_UA_INTERVAL_MS 375
+
+/* OCV curve of src/battery.c, also the curve of the simulated cell */
+static const struct level_point ocv_levels[] = {
+	{10000, 4180}, {9000, 4060}, {8000, 3980}, {7000, 3920}, {6000, 3870}, {5000, 3820},
+	{4000, 3790},  {3000, 3770}, {2000, 3740}, {1000, 3690}, {500, 3610},  {0, 3300},
+};
+
+/* Curve under load of the firmware before the fuel gauge */
+static const struct level_point load_levels[] = {
+	{10000, 4000},
+	{625, 3300},
+	{0, 3100},
+};
+
+/* Firmware model, as src/battery.c with the Kconfig defaults and BME680 in ULP */
+static struct fuel_gauge_params model = {
+	.capacity_mah = 300,
+	.resistance_mohm = 400,
+	.base_ua = 30,
+	.adv_ua = 25,
+	.conn_ua = 50,
+	.heater_ua = 90,
+	.heater_peak_ua = 12000,
+	.ocv_gain = 1.0f / 64.0f,
+	.ocv_gain_loaded = 1.0f / 256.0f,
+	.reseed_pptt = 2000,
+};
+
+/* Real cell and board */
+static struct {
+	double capacity_mah;
+	double resistance_mohm;
+	double base_ua;
+	double noise_mv;
+	double tau_ms;
+	uint32_t heater_period_ms;
+} cell = {300, 400, 30, 2.0, 2000, 300000};
+
+struct stats {
+	const char *name;
+	double err_sum2;
+	double err_max;
+	/* reported whole percent going up while discharging, and its largest step */
+	uint32_t rises;
+	uint32_t step_max;
+	uint32_t last_pct;
+	bool started;
+};
+
+struct transition {
+	uint32_t min;
+	uint32_t truth;
+	uint32_t gauge;
+	uint32_t tte_min;
+	enum power_tier tier;
+};
+
+struct sample {
+	uint32_t min;
+	uint32_t truth;
+	uint32_t est[3];
+	uint32_t tte_min;
+};
+
+static uint64_t rng_state = 0x853c49e6748fea9bULL;
+
+static double rnd(void)
+{
+	rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (double)(rng_state >> 11) / (double)(1ULL << 53);
+}
+
+static double gauss(void)
+{
+	double u = rnd() + 1e-12;
+
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * rnd());
+}
+
+/* OCV of the cell at a state of charge, inverse of calculate_level_pptt() */
+static double cell_ocv(double pptt)
+{
+	const struct level_point *p = ocv_levels;
+
+	while (p->lvl_pptt > 0 && pptt < p[1].lvl_pptt) {
+		p++;
+	}
+	if (p->lvl_pptt == 0) {
+		return p->lvl_mV;
+	}
+	return p[1].lvl_mV + (p->lvl_mV - p[1].lvl_mV) * (pptt - p[1].lvl_pptt) /
+				     (double)(p->lvl_pptt - p[1].lvl_pptt);
+}
+
+static void track(struct stats *s, uint32_t pptt, uint32_t truth)
+{
+	double err = ((double)pptt - truth) / 100.0;
+	uint32_t pct = pptt / 100;
+
+	s->err_sum2 += err * err;
+	if (fabs(err) > s->err_max) {
+		s->err_max = fabs(err);
+	}
+	if (s->started && pct > s->last_pct) {
+		s->rises++;
+		if (pct - s->last_pct > s->step_max) {
+			s->step_max = pct - s->last_pct;
+		}
+	}
+	s->last_pct = pct;
+	s->started = true;
+}
+
+/* Floor current left in a tier, cell.base_ua being the floor of POWER_TIER_NORMAL */
+static double tier_floor_ua(const struct power_tier_row *row)
+{
+	double saved = GAS_UA_AT_2S * (1.0 - 2000.0 / row->gas_period_ms);
+
+	if (row->led != POWER_LED_ALL) {
+		saved += LED_IDLE_UA;
+	}
+	if (row->bsec_ulp) {
+		saved += BSEC_TPH_UA;
+	}
+	return cell.base_ua - saved;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-b floor_uA] [-r mOhm] [-c mAh] [-n noise_mV] [-l] [-p] [-s seed] "
+		"[-t trace.csv]\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *trace = NULL;
+	bool policy = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "b:r:c:n:lps:t:h")) != -1) {
+		switch (opt) {
+		case 'b':
+			cell.base_ua = atof(optarg);
+			break;
+		case 'r':
+			cell.resistance_mohm = atof(optarg);
+			break;
+		case 'c':
+			cell.capacity_mah = atof(optarg);
+			break;
+		case 'n':
+			cell.noise_mv = atof(optarg);
+			break;
+		case 'l':
+			cell.heater_period_ms = 3000;
+			model.heater_ua = 900;
+			break;
+		case 'p':
+			policy = true;
+			break;
+		case 's':
+			rng_state ^= strtoull(optarg, NULL, 0);
+			break;
+		case 't':
+			trace = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	/* Heater on time for the model average at 12 mA, in whole steps at the average current */
+	uint32_t heat_ms = (uint32_t)((uint64_t)model.heater_ua * cell.heater_period_ms /
+				      model.heater_peak_ua);
+
+	heat_ms = (heat_ms + STEP_MS / 2) / STEP_MS * STEP_MS;
+	if (heat_ms < STEP_MS) {
+		heat_ms = STEP_MS;
+	}
+
+	double heater_peak_ua = (double)model.heater_ua * cell.heater_period_ms / heat_ms;
+
+	int moving_buffer[FILTER_SIZE] = {0};
+	moving_average_t moving = {.buffer = moving_buffer, .buffer_length = FILTER_SIZE};
+	struct fuel_gauge fg;
+	struct power_policy pp;
+	struct transition transitions[32];
+	size_t transition_count = 0;
+	double floor_ua = cell.base_ua;
+	struct stats st[3] = {{.name = "before"}, {.name = "avg+ocv"}, {.name = "fuel gauge"}};
+
+	fuel_gauge_init(&fg);
+	power_policy_init(&pp);
+
+	size_t cap = 1 << 16, n = 0;
+	struct sample *samples = malloc(cap * sizeof(*samples));
+
+	double left_mah = cell.capacity_mah;
+	double i_filt = 0;
+	double divider_pulsed_mah = 0, divider_on_mah = 0, load_mah = 0;
+	bool connected = false;
+	int64_t last_heater_end = -1;
+	int64_t t;
+
+	for (t = 0; left_mah > 0; t += STEP_MS) {
+		double pptt = left_mah * 10000.0 / cell.capacity_mah;
+		double ocv = cell_ocv(pptt);
+		int64_t in_period = t % SAMPLE_PERIOD_MS;
+		bool divider = in_period < SETTLE_MS;
+		bool heating = (t + 1000) % cell.heater_period_ms < heat_ms;
+
+		/* Connections start every 2 h and last 15 min on average, checked every minute */
+		if (in_period == 0) {
+			connected = connected ? rnd() >= 1.0 / 15 : rnd() < 1.0 / 120;
+		}
+		if (!heating && (t + 1000) % cell.heater_period_ms == heat_ms) {
+			/* BSEC sample done, the listener notes it */
+			last_heater_end = t;
+		}
+
+		double ua = floor_ua + (connected ? model.conn_ua : model.adv_ua) +
+			    (heating ? heater_peak_ua : 0);
+
+		i_filt += (ua - i_filt) * (1.0 - exp(-(double)STEP_MS / cell.tau_ms));
+
+		if (in_period == SETTLE_MS) {
+			/* The firmware sample: tags, then one SAADC conversion */
+			uint32_t loads = connected ? FUEL_GAUGE_LOAD_RADIO : 0;
+
+			if (last_heater_end >= 0 && t - last_heater_end < HEATER_RECOVERY_MS) {
+				loads |= FUEL_GAUGE_LOAD_HEATER;
+			}
+
+			double event = rnd() < (connected ? RADIO_EVENT_CONN : RADIO_EVENT_ADV)
+					       ? RADIO_EVENT_UA
+					       : 0;
+			double v = ocv - (i_filt + event) * cell.resistance_mohm / 1e6 +
+				   cell.noise_mv * gauss();
+			int mv = (int)lround(v);
+			uint32_t truth = (uint32_t)lround(pptt);
+			uint32_t est[3];
+
+			int avg = calculate_moving_average(&moving, mv);
+
+			est[0] = calculate_level_pptt(avg, load_levels);
+			est[1] = calculate_level_pptt(avg, ocv_levels);
+			int32_t ocv_mv = fuel_gauge_ocv_mv(&model, mv, loads);
+			uint32_t ocv_pptt = calculate_level_pptt(ocv_mv, ocv_levels);
+
+			est[2] = fuel_gauge_update(&fg, &model, ocv_pptt, loads, t);
+
+			if (n == cap) {
+				cap *= 2;
+				samples = realloc(samples, cap * sizeof(*samples));
+			}
+			uint32_t tte_min = fuel_gauge_time_to_empty_min(&fg, &model);
+
+			samples[n++] = (struct sample){
+				(uint32_t)(t / 60000), truth, {est[0], est[1], est[2]}, tte_min};
+
+			if (policy && power_policy_update(&pp, est[2], tte_min)) {
+				const struct power_tier_row *row = &power_tiers[pp.tier];
+
+				/* As apply_power_tier() in src/battery.c */
+				model.adv_ua = ADV_UA * ADV_UA_INTERVAL_MS * 2 /
+					       (row->adv_min_ms + row->adv_max_ms);
+				floor_ua = tier_floor_ua(row);
+				if (transition_count < ARRAY_SIZE(transitions)) {
+					transitions[transition_count++] = (struct transition){
+						(uint32_t)(t / 60000), truth, est[2], tte_min,
+						pp.tier};
+				}
+			}
+			for (int i = 0; i < 3; i++) {
+				track(&st[i], est[i], truth);
+			}
+		}
+
+		double step_h = STEP_MS / 3600e3;
+		double divider_ua = ocv / DIVIDER_OHM * 1e3;
+
+		divider_on_mah += divider_ua * step_h / 1e3;
+		if (divider) {
+			divider_pulsed_mah += divider_ua * step_h / 1e3;
+			ua += divider_ua;
+		}
+		load_mah += (ua - (divider ? divider_ua : 0)) * step_h / 1e3;
+		left_mah -= ua * step_h / 1e3;
+	}
+
+	double hours = t / 3600e3;
+	double life_on = cell.capacity_mah / ((load_mah + divider_on_mah) / hours) / 24.0;
+	double life_pulsed = cell.capacity_mah / ((load_mah + divider_pulsed_mah) / hours) / 24.0;
+
+	printf("discharge   %.0f h (%.1f days), load %.1f uA average\n", hours, hours / 24,
+	       load_mah / hours * 1e3);
+	printf("divider     always on %.2f uA, pulsed %.3f uA; life %.1f -> %.1f days (+%.1f%%)\n",
+	       divider_on_mah / hours * 1e3, divider_pulsed_mah / hours * 1e3, life_on, life_pulsed,
+	       (life_pulsed / life_on - 1) * 100);
+	printf("loaded      %u of %u samples tagged\n", fg.loaded_samples, fg.samples);
+	printf("\n%-11s %9s %9s %7s %9s\n", "estimate", "rms err %", "max err %", "rises",
+	       "max rise");
+	for (int i = 0; i < 3; i++) {
+		printf("%-11s %9.2f %9.2f %7u %9u\n", st[i].name, sqrt(st[i].err_sum2 / n),
+		       st[i].err_max, st[i].rises, st[i].step_max);
+	}
+
+	if (policy) {
+		printf("\n%-9s %7s %9s %9s %9s %9s\n", "tier", "day", "true %", "gauge %",
+		       "tte h", "left h");
+		for (size_t i = 0; i < transition_count; i++) {
+			const struct transition *tr = &transitions[i];
+
+			printf("%-9s %7.1f %9.1f %9.1f %9.1f %9.1f\n", power_tiers[tr->tier].name,
+			       tr->min / 1440.0, tr->truth / 100.0, tr->gauge / 100.0,
+			       tr->tte_min / 60.0, (t / 60000 - tr->min) / 60.0);
+		}
+	}
+
+	/* Time to empty against the minutes that were really left */
+	uint32_t end_min = (uint32_t)(t / 60000);
+
+	printf("\n%-11s %9s %9s\n", "true SoC", "tte h", "left h");
+	for (int level = 75; level > 0; level -= 25) {
+		for (size_t i = 0; i < n; i++) {
+			if (samples[i].truth <= (uint32_t)level * 100) {
+				printf("%9d %% %9.1f %9.1f\n", level, samples[i].tte_min / 60.0,
+				       (end_min - samples[i].min) / 60.0);
+				break;
+			}
+		}
+	}
+
+	if (trace) {
+		FILE *f = fopen(trace, "w");
+
+		if (!f) {
+			perror(trace);
+			return 1;
+		}
+		fprintf(f, "min,true,before,avg_ocv,gauge,tte_min\n");
+		for (size_t i = 0; i < n; i++) {
+			fprintf(f, "%u,%u,%u,%u,%u,%u\n", samples[i].min, samples[i].truth,
+				samples[i].est[0], samples[i].est[1], samples[i].est[2],
+				samples[i].tte_min);
+		}
+		fclose(f);
+	}
+
+	free(samples);
+	return 0;
+}
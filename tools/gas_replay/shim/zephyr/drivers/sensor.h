@@ -0,0 +1,36 @@
+/*
+ * Host stand-in for <zephyr/drivers/sensor.h>, only what the replayed sources need.
+ */
+#ifndef __GAS_REPLAY_SHIM_SENSOR_H__
+#define __GAS_REPLAY_SHIM_SENSOR_H__
+
+#include <errno.h>
+#include <stdint.h>
+
+struct sensor_value {
+	/** Integer part of the value. */
+	int32_t val1;
+	/** Fractional part of the value (in one-millionth parts). */
+	int32_t val2;
+};
+
+/* As in Zephyr, used by the bme68x_iaq driver for every channel */
+static inline int sensor_value_from_double(struct sensor_value *val, double inp)
+{
+	if (inp < INT32_MIN || inp > INT32_MAX) {
+		return -ERANGE;
+	}
+
+	double val2 = (inp - (int32_t)inp) * 1000000.0;
+
+	if (val2 < INT32_MIN || val2 > INT32_MAX) {
+		return -ERANGE;
+	}
+
+	val->val1 = (int32_t)inp;
+	val->val2 = (int32_t)val2;
+
+	return 0;
+}
+
+#endif // __GAS_REPLAY_SHIM_SENSOR_H__
@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for <zephyr/kernel.h>, only what the replayed sources need.
+ */
+#ifndef __GAS_REPLAY_SHIM_KERNEL_H__
+#define __GAS_REPLAY_SHIM_KERNEL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#endif
+
+#endif // __GAS_REPLAY_SHIM_KERNEL_H__
@@ -0,0 +1,16 @@
+/*
+ * Host stand-in for <zephyr/logging/log.h>. Errors go to stderr, everything else is dropped.
+ */
+#ifndef __GAS_REPLAY_SHIM_LOG_H__
+#define __GAS_REPLAY_SHIM_LOG_H__
+
+#include <stdio.h>
+
+#define LOG_MODULE_REGISTER(...)
+#define LOG_MODULE_DECLARE(...)
+#define LOG_ERR(fmt, ...) fprintf(stderr, "E: " fmt "\n", ##__VA_ARGS__)
+#define LOG_WRN(...)      do { } while (0)
+#define LOG_INF(...)      do { } while (0)
+#define LOG_DBG(...)      do { } while (0)
+
+#endif // __GAS_REPLAY_SHIM_LOG_H__
@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Decode the binary log ring (src/log_ring.c) drained with "DLOG" over BLE.
+
+Input is a text file with one notification per line, either as text ("D<hex>") or as the hex of
+its bytes, e.g. the log of a BLE client. Other lines are skipped. The records are formatted with
+Zephyr's dictionary log parser and the log_dictionary.json of the same build:
+
+    log_decode.py build/zephyr/log_dictionary.json dlog.txt
+    log_decode.py build/zephyr/log_dictionary.json dlog.txt --save ring.bin
+
+The parser is taken from $ZEPHYR_BASE/scripts/logging/dictionary.
+"""
+
+import argparse
+import os
+import sys
+
+
+def parse_line(line):
+    """Ring bytes of one notification, None for other lines."""
+    line = line.strip()
+    if not line or line.startswith('#'):
+        return None
+    if not line.startswith('D'):
+        # Hex of the notification bytes, back to the text the firmware sent
+        hex_str = line
+        for sep in (' ', ':', '-', ','):
+            hex_str = hex_str.replace(sep, '')
+        if hex_str.lower().startswith('0x'):
+            hex_str = hex_str[2:]
+        try:
+            line = bytes.fromhex(hex_str).decode('ascii').strip()
+        except ValueError:
+            return None
+        if not line.startswith('D'):
+            return None
+    try:
+        return bytes.fromhex(line[1:])
+    except ValueError:
+        return None
+
+
+def load_parser():
+    zephyr_base = os.environ.get('ZEPHYR_BASE')
+    if not zephyr_base:
+        sys.exit('ZEPHYR_BASE is not set')
+    sys.path.insert(0, os.path.join(zephyr_base, 'scripts', 'logging', 'dictionary'))
+    import dictionary_parser
+    from dictionary_parser.log_database import LogDatabase
+    return dictionary_parser, LogDatabase
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('dbfile', help='log_dictionary.json of the build that wrote the log')
+    ap.add_argument('input', nargs='?', default='-')
+    ap.add_argument('--save', help='also write the joined ring bytes to this file')
+    ap.add_argument('--debug', action='store_true', help='dump the records while parsing')
+    args = ap.parse_args()
+
+    src = sys.stdin if args.input == '-' else open(args.input)
+    logdata = bytearray()
+    ended = False
+    for line in src:
+        chunk = parse_line(line)
+        if chunk is None:
+            continue
+        if not chunk:
+            ended = True
+        logdata += chunk
+
+    if args.save:
+        with open(args.save, 'wb') as f:
+            f.write(logdata)
+    sys.stderr.write('%d bytes%s\n' % (len(logdata), '' if ended else ', no end marker'))
+    if not logdata:
+        return
+
+    dictionary_parser, LogDatabase = load_parser()
+    database = LogDatabase.read_json_database(args.dbfile)
+    if database is None:
+        sys.exit('cannot read %s' % args.dbfile)
+    parser = dictionary_parser.get_parser(database)
+    if parser is None:
+        sys.exit('no parser for the database version')
+    if not parser.parse_log_data(bytes(logdata), debug=args.debug):
+        sys.exit('log data is not valid for this build')
+
+
+if __name__ == '__main__':
+    main()
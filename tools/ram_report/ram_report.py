@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""Static RAM per module from the linker map, with run-time stack high-water marks.
+
+Sums every input section placed in the RAM region of build/zephyr/zephyr.map by object file (or
+library with -g lib), lists the thread stacks found in .noinit and, given the report of the
+stack monitor (stack.conf build, FFF4 characteristic or its log line), how much of each stack was
+used. Threads of the application are then proposed for a shared work queue with the RAM it would
+return.
+
+    ram_report.py build/zephyr/zephyr.map
+    ram_report.py build/zephyr/zephyr.map -r stacks.txt -k bt_thread_id
+    ram_report.py build/zephyr/zephyr.map -g lib -n 15
+"""
+
+import argparse
+import collections
+import re
+import sys
+
+# Stacks of K_THREAD_DEFINE(name, ...) are named _k_thread_stack_<name>, threads are named <name>
+THREAD_STACK_PREFIX = '_k_thread_stack_'
+
+# Objects of this archive are the application
+APP_LIBRARY = 'libapp.a'
+
+SECTION_RE = re.compile(r'^ (\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(.+))?$')
+PLACEMENT_RE = re.compile(r'^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(.+)$')
+SYMBOL_RE = re.compile(r'^\s+0x([0-9a-fA-F]+)\s+([A-Za-z_][\w.$]*)$')
+REGION_RE = re.compile(r'^(\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)(?:\s+(\S+))?$')
+RUNTIME_RE = re.compile(r'([\w.\-]+):(\d+)/(\d+)')
+
+Section = collections.namedtuple('Section', 'name addr size obj symbols')
+
+
+def parse_map(lines):
+    """Return the memory regions and the input sections of a GNU ld map."""
+    regions = {}
+    sections = []
+    state = None
+    pending = None
+    current = None
+
+    for line in lines:
+        line = line.rstrip('\n')
+        if line.startswith('Memory Configuration'):
+            state = 'regions'
+            continue
+        if line.startswith('Linker script and memory map'):
+            state = 'map'
+            continue
+
+        if state == 'regions':
+            m = REGION_RE.match(line)
+            if m and m.group(1) not in ('Name', '*default*'):
+                regions[m.group(1)] = (int(m.group(2), 16), int(m.group(3), 16), m.group(4) or '')
+            continue
+        if state != 'map':
+            continue
+
+        if pending is not None:
+            m = PLACEMENT_RE.match(line)
+            if m:
+                current = Section(pending, int(m.group(1), 16), int(m.group(2), 16),
+                                  m.group(3).strip(), [])
+                sections.append(current)
+            pending = None
+            continue
+
+        m = SYMBOL_RE.match(line)
+        if m and current is not None:
+            current.symbols.append((int(m.group(1), 16), m.group(2)))
+            continue
+
+        m = SECTION_RE.match(line)
+        if m:
+            if m.group(2) is None:
+                pending = m.group(1)
+            else:
+                current = Section(m.group(1), int(m.group(2), 16), int(m.group(3), 16),
+                                  m.group(4).strip(), [])
+                sections.append(current)
+            continue
+
+        # Output section headers and anything else end the symbol list of a section
+        if line and not line.startswith(' '):
+            current = None
+
+    return regions, sections
+
+
+def ram_region(regions, name):
+    if name:
+        if name not in regions:
+            sys.exit('region %s not in map, have: %s' % (name, ', '.join(regions)))
+        return regions[name]
+    writable = [r for r in regions.values() if 'w' in r[2] and r[1] < 1 << 31]
+    if not writable:
+        sys.exit('no writable memory region in map, use --region')
+    return max(writable, key=lambda r: r[1])
+
+
+def module_name(obj, group):
+    """'app/libapp.a(gas.c.obj)' -> 'libapp.a(gas.c)' or 'libapp.a'."""
+    m = re.match(r'(?:.*/)?([^/(]+)\(([^)]+)\)$', obj)
+    if not m:
+        return obj.rsplit('/', 1)[-1]
+    lib, member = m.groups()
+    if group == 'lib':
+        return lib
+    return '%s(%s)' % (lib, re.sub(r'\.obj$', '', member))
+
+
+def stack_entries(sections):
+    """Thread stacks: the .noinit input sections, split at the symbols they contain."""
+    stacks = []
+    for s in sections:
+        if not s.name.startswith('.noinit'):
+            continue
+        syms = sorted(s.symbols)
+        if not syms:
+            # Static stack, named after the source file in the section name
+            m = re.search(r'"(?:.*/)?([^"/]+)"', s.name)
+            stacks.append(('%s:static' % (m.group(1) if m else s.name), s.size, s.obj))
+            continue
+        for i, (addr, sym) in enumerate(syms):
+            end = syms[i + 1][0] if i + 1 < len(syms) else s.addr + s.size
+            stacks.append((sym, end - addr, s.obj))
+    return stacks
+
+
+def parse_runtime(path):
+    usage = {}
+    with open(path) as f:
+        for name, used, size in RUNTIME_RE.findall(f.read()):
+            # Later reports of the same thread supersede earlier ones
+            usage[name] = (int(used), int(size))
+    return usage
+
+
+def align(n, a):
+    return (n + a - 1) // a * a
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__,
+                                 formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('map', help='zephyr.map')
+    ap.add_argument('-r', '--runtime', help='stack monitor report, "<thread>:<used>/<size>;..."')
+    ap.add_argument('-g', '--group', choices=('obj', 'lib'), default='obj',
+                    help='sum per object file or per library')
+    ap.add_argument('-n', '--top', type=int, default=25, help='modules listed, 0 for all')
+    ap.add_argument('--region', help='RAM region name, default the largest writable one')
+    ap.add_argument('-k', '--keep', action='append', default=[],
+                    help='thread that keeps its own stack, repeatable')
+    ap.add_argument('--margin', type=int, default=25,
+                    help='headroom of the shared work queue stack in percent')
+    args = ap.parse_args()
+
+    with open(args.map) as f:
+        regions, sections = parse_map(f)
+
+    origin, length, _ = ram_region(regions, args.region)
+    ram = [s for s in sections if s.size and origin <= s.addr < origin + length]
+
+    per_module = collections.Counter()
+    for s in ram:
+        per_module[module_name(s.obj, args.group) if s.name != '*fill*' else '(fill)'] += s.size
+    used = sum(per_module.values())
+
+    print('RAM %d of %d bytes (%.1f %%), %d free' % (used, length, 100.0 * used / length,
+                                                     length - used))
+    print()
+    print('%-48s %8s %6s' % ('module', 'bytes', '%'))
+    top = per_module.most_common(args.top or None)
+    for name, size in top:
+        print('%-48s %8d %6.1f' % (name, size, 100.0 * size / used))
+    if len(top) < len(per_module):
+        rest = used - sum(size for _, size in top)
+        print('%-48s %8d %6.1f' % ('(%d more)' % (len(per_module) - len(top)), rest,
+                                    100.0 * rest / used))
+
+    runtime = parse_runtime(args.runtime) if args.runtime else {}
+    stacks = stack_entries(ram)
+
+    print()
+    print('%-32s %6s %6s %6s  %s' % ('stack', 'size', 'used', 'slack', 'object'))
+    total = 0
+    app_threads = []
+    for sym, size, obj in sorted(stacks, key=lambda st: -st[1]):
+        thread = sym[len(THREAD_STACK_PREFIX):] if sym.startswith(THREAD_STACK_PREFIX) else sym
+        hw = runtime.get(thread)
+        total += size
+        if hw:
+            print('%-32s %6d %6d %6d  %s' % (thread, size, hw[0], hw[1] - hw[0],
+                                             module_name(obj, 'obj')))
+        else:
+            print('%-32s %6d %6s %6s  %s' % (thread, size, '-', '-', module_name(obj, 'obj')))
+        if sym.startswith(THREAD_STACK_PREFIX) and APP_LIBRARY in obj and thread not in args.keep:
+            app_threads.append((thread, size, hw[0] if hw else None))
+    print('%-32s %6d' % ('(all stacks)', total))
+
+    missing = [name for name in runtime if not any(t[0] == name for t in app_threads)]
+    if runtime and missing:
+        print('\nrun-time only (kernel, driver or kept threads): %s' % ', '.join(sorted(missing)))
+
+    if len(app_threads) < 2:
+        return
+
+    # One work queue runs the items one after another, its stack covers the deepest of them
+    known = [t for t in app_threads if t[2] is not None]
+    deepest = max(t[2] for t in known) if known else max(t[1] for t in app_threads)
+    queue_stack = align(deepest * (100 + args.margin) // 100, 8)
+    reclaimed = sum(t[1] for t in app_threads) - queue_stack
+
+    print()
+    print('Shared work queue for %s:' % ', '.join(t[0] for t in app_threads))
+    print('  stack %d bytes (deepest %d + %d %%), returns %d bytes' %
+          (queue_stack, deepest, args.margin, reclaimed))
+    if len(known) < len(app_threads):
+        print('  no high-water mark for %s, sized by their stacks' %
+              ', '.join(t[0] for t in app_threads if t[2] is None))
+    print('  Items must not block for long: a sleeping item delays all others. Keep threads that')
+    print('  wait on hardware or run long computations with -k.')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Decode raw SAADC capture notifications (FFF3) into millivolt CSV.
+
+Input is a text file with one notification value per line as hex, e.g. the log of a BLE client.
+Separators (space, ':', '-') and a leading '0x' are ignored. Frame layout is described in
+src/capture.h.
+
+    decode_capture.py capture.log -r 500 -o capture.csv
+    decode_capture.py capture.log -r 500 --replay replay.csv   # input for tools/gas_replay
+"""
+
+import argparse
+import struct
+import sys
+
+HDR = struct.Struct('<BBHI')
+
+# Channel order is ascending SAADC channel id: vbatt divider (0), O2 (2), GAS (3)
+DEFAULT_NAMES = ['vbatt', 'o2', 'gas']
+DEFAULT_FULL_SCALE_MV = [5600, 3600, 3600, 3600]
+
+
+def parse_hex(line):
+    line = line.strip()
+    if not line or line.startswith('#'):
+        return None
+    for sep in (' ', ':', '-', ','):
+        line = line.replace(sep, '')
+    if line.lower().startswith('0x'):
+        line = line[2:]
+    return bytes.fromhex(line)
+
+
+def parse_info(raw):
+    rate, channels, resolution = struct.unpack_from('<HBB', raw)
+    full_scale = list(struct.unpack_from('<%dH' % channels, raw, 4))
+    return rate, channels, resolution, full_scale
+
+
+def unpack12(payload, count):
+    out = []
+    for i in range(0, len(payload) - 2, 3):
+        b0, b1, b2 = payload[i:i + 3]
+        out.append(b0 | (b1 & 0x0f) << 8)
+        out.append(b1 >> 4 | b2 << 4)
+    return out[:count]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('input', nargs='?', default='-')
+    ap.add_argument('-r', '--rate', type=float, help='scan rate in Hz (taken from --info if given)')
+    ap.add_argument('-i', '--info', help='hex value read from the capture characteristic')
+    ap.add_argument('-o', '--output', help='CSV output, default stdout')
+    ap.add_argument('--replay', help='write time_ms,o2_mv,gas_mv for tools/gas_replay')
+    args = ap.parse_args()
+
+    channels = len(DEFAULT_NAMES)
+    full_scale = DEFAULT_FULL_SCALE_MV
+    resolution = 12
+    rate = args.rate
+    if args.info:
+        info_rate, channels, resolution, full_scale = parse_info(parse_hex(args.info))
+        rate = rate or info_rate
+    if not rate:
+        ap.error('scan rate unknown, pass --rate or --info')
+    names = DEFAULT_NAMES if channels == len(DEFAULT_NAMES) else ['ch%d' % i for i in range(channels)]
+    period_us = 1e6 / rate
+    lsb = [fs / (1 << resolution) for fs in full_scale]
+
+    src = sys.stdin if args.input == '-' else open(args.input)
+    out = sys.stdout if not args.output else open(args.output, 'w')
+    replay = open(args.replay, 'w') if args.replay else None
+
+    out.write('time_s,' + ','.join(n + '_mv' for n in names) + '\n')
+    if replay:
+        replay.write('time_ms,o2_mv,gas_mv\n')
+
+    frames = lost_frames = scans_total = gap_scans = dropped = 0
+    prev_seq = None
+    t_base = None
+    wraps = 0
+    prev_ts = None
+    next_expected_us = None
+
+    for line in src:
+        raw = parse_hex(line)
+        if raw is None or len(raw) < HDR.size:
+            continue
+        seq, scans, dropped, ts = HDR.unpack_from(raw)
+        if prev_seq is not None and seq != (prev_seq + 1) & 0xff:
+            lost_frames += (seq - prev_seq - 1) & 0xff
+        prev_seq = seq
+
+        # unwrap the 32 bit microsecond timestamp
+        if prev_ts is not None and ts < prev_ts:
+            wraps += 1
+        prev_ts = ts
+        t_us = ts + wraps * (1 << 32)
+        if t_base is None:
+            t_base = t_us
+        if next_expected_us is not None:
+            missing = round((t_us - next_expected_us) / period_us)
+            if missing > 0:
+                gap_scans += missing
+        next_expected_us = t_us + scans * period_us
+
+        samples = unpack12(raw[HDR.size:], scans * channels)
+        for s in range(scans):
+            t = (t_us - t_base + s * period_us) / 1e6
+            mv = [samples[s * channels + c] * lsb[c] for c in range(channels)]
+            out.write('%.6f,' % t + ','.join('%.1f' % v for v in mv) + '\n')
+            if replay and 'o2' in names and 'gas' in names:
+                replay.write('%d,%d,%d\n' % (round(t * 1000), round(mv[names.index('o2')]),
+                                             round(mv[names.index('gas')])))
+        frames += 1
+        scans_total += scans
+
+    span = (next_expected_us - t_base) / 1e6 if frames else 0
+    sys.stderr.write('frames: %d (%d lost), scans: %d, dropped on device: %d, gaps: %d scans\n'
+                     % (frames, lost_frames, scans_total, dropped, gap_scans))
+    if span > 0:
+        sys.stderr.write('span: %.2f s, effective rate %.1f Hz of %.1f Hz\n'
+                         % (span, scans_total / span, rate))
+
+
+if __name__ == '__main__':
+    main()
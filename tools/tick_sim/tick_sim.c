@@ -0,0 +1,279 @@
+/**
+ * @file tools/tick_sim/tick_sim.c - wakeup count of the firmware jobs, with and without alignment
+ *
+ * Replays the periodic jobs of the firmware on a microsecond time line: their start after boot,
+ * period and run time. Unaligned, every job sleeps relative to the end of its run (k_sleep(),
+ * relative work delays), so run time makes the phases drift apart. Aligned, every job schedules
+ * through tick_align_next() like the firmware. Overlapping runs share one CPU active window.
+ *
+ *     tick_sim                 # wakeups and active windows per hour, both schedules
+ *     tick_sim -H 24 -g 500    # a day, 500 ms grid
+ *     tick_sim -t trace.csv    # every run of the aligned schedule as start_us,end_us,job
+ */
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tick_align.h"
+
+enum sched {
+	/* next run a period after the end of this one */
+	SCHED_RELATIVE,
+	/* k_timer, fixed period from the first expiry */
+	SCHED_TIMER,
+	/* tick_align_next() */
+	SCHED_ALIGNED,
+	/* own timing, not aligned in either schedule (BSEC) */
+	SCHED_FIXED,
+};
+
+struct job {
+	const char *name;
+	uint32_t start_ms;
+	uint32_t period_ms;
+	uint32_t slack_ms;
+	uint32_t run_us;
+	/* second wakeup this long after the first run, e.g. an off step; 0 for none */
+	uint32_t second_ms;
+	/* schedule of the unaligned build */
+	enum sched before;
+	/* schedule with alignment */
+	enum sched after;
+};
+
+/* Start, period and slack as in the sources; run times are estimates of a 64 MHz nRF52832 */
+static const struct job jobs[] = {
+	{"gas", 4000, 2000, 500, 12000, 0, SCHED_RELATIVE, SCHED_ALIGNED},
+	{"watchdog", 0, 1000, 0, 20, 0, SCHED_TIMER, SCHED_TIMER},
+	{"workq", 0, 10000, 1000, 20, 0, SCHED_RELATIVE, SCHED_ALIGNED},
+	{"battery", 200, 60000, 5000, 1500, 0, SCHED_RELATIVE, SCHED_ALIGNED},
+	{"bt", 2500, 10000, 1000, 3000, 0, SCHED_RELATIVE, SCHED_ALIGNED},
+	{"bsec", 1000, 3000, 0, 9000, 0, SCHED_FIXED, SCHED_FIXED},
+};
+
+#define JOB_COUNT (sizeof(jobs) / sizeof(jobs[0]))
+
+/* Aligned watchdog feeds every 2 s, on the gas measurement */
+#define WATCHDOG_ALIGNED_PERIOD_MS 2000
+
+struct run {
+	int64_t start_us;
+	int64_t end_us;
+	uint8_t job;
+};
+
+struct state {
+	int64_t next_us;
+	/* pending second wakeup of the current period, 0 for none */
+	int64_t second_us;
+	struct tick_align_job tick;
+	uint32_t period_ms;
+	enum sched sched;
+};
+
+static struct run *runs;
+static size_t run_count;
+static size_t run_cap;
+
+static void add_run(int64_t start_us, int64_t end_us, uint8_t job)
+{
+	if (run_count == run_cap) {
+		run_cap = run_cap ? run_cap * 2 : 4096;
+		runs = realloc(runs, run_cap * sizeof(*runs));
+		if (!runs) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	runs[run_count++] = (struct run){start_us, end_us, job};
+}
+
+static int run_cmp(const void *a, const void *b)
+{
+	const struct run *ra = a;
+	const struct run *rb = b;
+
+	return (ra->start_us > rb->start_us) - (ra->start_us < rb->start_us);
+}
+
+/* Next run after one that ended at end_us */
+static int64_t next_wake(struct state *st, int64_t wake_us, int64_t end_us)
+{
+	switch (st->sched) {
+	case SCHED_RELATIVE:
+		return end_us + (int64_t)st->period_ms * 1000;
+	case SCHED_TIMER:
+	case SCHED_FIXED:
+		return wake_us + (int64_t)st->period_ms * 1000;
+	case SCHED_ALIGNED:
+		/* The firmware reads k_uptime_get(), whole milliseconds */
+		return tick_align_next(&st->tick, end_us / 1000) * 1000;
+	}
+	return end_us;
+}
+
+static void simulate(bool aligned, uint32_t grid_ms, int64_t horizon_us)
+{
+	struct state st[JOB_COUNT];
+
+	run_count = 0;
+	for (size_t i = 0; i < JOB_COUNT; i++) {
+		const struct job *j = &jobs[i];
+
+		st[i].sched = aligned ? j->after : j->before;
+		st[i].period_ms = j->period_ms;
+		if (aligned && strcmp(j->name, "watchdog") == 0) {
+			st[i].period_ms = WATCHDOG_ALIGNED_PERIOD_MS;
+		}
+		st[i].tick = (struct tick_align_job)TICK_ALIGN_JOB_INIT(st[i].period_ms,
+									j->slack_ms, grid_ms);
+		st[i].second_us = 0;
+		st[i].next_us = (int64_t)j->start_ms * 1000;
+		if (st[i].sched == SCHED_ALIGNED || st[i].sched == SCHED_TIMER) {
+			/* First run on the schedule, as the firmware does after its start up */
+			st[i].tick.period_ms = st[i].period_ms;
+			st[i].next_us = tick_align_next(&st[i].tick, j->start_ms) * 1000;
+		}
+	}
+
+	for (;;) {
+		size_t k = 0;
+		int64_t t = INT64_MAX;
+		bool second = false;
+
+		for (size_t i = 0; i < JOB_COUNT; i++) {
+			if (st[i].second_us && st[i].second_us < t) {
+				t = st[i].second_us;
+				k = i;
+				second = true;
+			}
+			if (st[i].next_us < t) {
+				t = st[i].next_us;
+				k = i;
+				second = false;
+			}
+		}
+		if (t >= horizon_us) {
+			break;
+		}
+
+		const struct job *j = &jobs[k];
+		int64_t end = t + j->run_us;
+
+		add_run(t, end, k);
+		if (second) {
+			st[k].second_us = 0;
+			st[k].next_us = next_wake(&st[k], st[k].next_us, end);
+			/* relative: the period counts from the first step */
+			if (st[k].sched == SCHED_RELATIVE) {
+				st[k].next_us -= (int64_t)j->second_ms * 1000;
+			}
+		} else if (j->second_ms) {
+			st[k].second_us = end + (int64_t)j->second_ms * 1000;
+			st[k].next_us = INT64_MAX;
+		} else {
+			st[k].next_us = next_wake(&st[k], t, end);
+		}
+	}
+
+	qsort(runs, run_count, sizeof(*runs), run_cmp);
+}
+
+/* CPU active windows: runs that overlap or touch share one */
+static size_t count_windows(void)
+{
+	size_t windows = 0;
+	int64_t end = -1;
+
+	for (size_t i = 0; i < run_count; i++) {
+		if (runs[i].start_us > end) {
+			windows++;
+			end = runs[i].end_us;
+		} else if (runs[i].end_us > end) {
+			end = runs[i].end_us;
+		}
+	}
+	return windows;
+}
+
+static void report(const char *label, double hours)
+{
+	size_t per_job[JOB_COUNT] = {0};
+
+	for (size_t i = 0; i < run_count; i++) {
+		per_job[runs[i].job]++;
+	}
+	printf("%-10s", label);
+	for (size_t i = 0; i < JOB_COUNT; i++) {
+		printf(" %8.0f", per_job[i] / hours);
+	}
+	printf(" %8.0f %8.0f\n", run_count / hours, count_windows() / hours);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-H hours] [-g grid_ms] [-t trace.csv]\n", prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	double hours = 1.0;
+	uint32_t grid_ms = 1000;
+	const char *trace = NULL;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "H:g:t:h")) != -1) {
+		switch (opt) {
+		case 'H':
+			hours = atof(optarg);
+			break;
+		case 'g':
+			grid_ms = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			trace = optarg;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (hours <= 0 || grid_ms == 0) {
+		usage(argv[0]);
+	}
+
+	int64_t horizon = (int64_t)(hours * 3600e6);
+
+	printf("per hour  ");
+	for (size_t i = 0; i < JOB_COUNT; i++) {
+		printf(" %8s", jobs[i].name);
+	}
+	printf(" %8s %8s\n", "wakeups", "windows");
+
+	simulate(false, grid_ms, horizon);
+	report("unaligned", hours);
+
+	simulate(true, grid_ms, horizon);
+	report("aligned", hours);
+
+	if (trace) {
+		FILE *f = fopen(trace, "w");
+
+		if (!f) {
+			perror(trace);
+			return 1;
+		}
+		fprintf(f, "start_us,end_us,job\n");
+		for (size_t i = 0; i < run_count; i++) {
+			fprintf(f, "%lld,%lld,%s\n", (long long)runs[i].start_us,
+				(long long)runs[i].end_us, jobs[runs[i].job].name);
+		}
+		fclose(f);
+	}
+
+	free(runs);
+	return 0;
+}